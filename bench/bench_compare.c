@@ -0,0 +1,333 @@
+/*
+Comparison of the hash map against the reference tables of `ref_tables.c`.
+
+The same traces of keys and lookups are run through the hash map (with SipHash-2-4 and
+with wyhash) and through a linear probing and a chained table hashing with unkeyed FNV-1a.
+Traces:
+
+uniform: lookups of the inserted keys picked uniformly at random.
+zipf: lookups following a Zipfian distribution (s = 0.99) over the inserted keys, so that
+    a few hot keys take most of the lookups.
+collide: `BENCH_COLLIDE_KEYS` keys chosen so that their FNV-1a hashes agree on the low bits
+    used to index the reference tables, as an attacker knowing the hash would do. Lookups
+    are uniform. The hash map picks a random key for its hash at init, so the same keys
+    spread over its slots.
+
+Reports insertion and lookup throughput and the allocated bytes per entry (as requested
+from the allocator, allocator overheads of small allocations excluded). Runs offline with
+fixed seeds. Run by `make bench`, key count of the uniform and Zipfian traces can be given
+as the first argument.
+*/
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "common.h"
+#include "hashmap.h"
+#include "ref_tables.h"
+
+#define BENCH_DEFAULT_KEYS (1U << 18)
+#define BENCH_COLLIDE_KEYS 4096U
+#define BENCH_LOOKUPS_PER_KEY 4U
+#define BENCH_ZIPF_EXPONENT 0.99
+#define BENCH_SEED 0x2545f4914f6cdd1dULL
+
+// Prevents the compiler from dropping the measured work
+static volatile u64 sink;
+
+/*
+Table under comparison, behind a common interface. `init` gets the byte count that all
+memory of the table is accounted to.
+*/
+struct Contender {
+    char const *name;
+    void* (*init)(struct ByteCount *bytes);
+    bool (*insert)(void *table, char const *key, u64 value);
+    bool (*get)(void *table, char const *key, u64 *value);
+    void (*free)(void *table);
+};
+
+struct Trace {
+    char const *name;
+    char *keys;
+    u32 key_count;
+    u32 *lookups;
+    u32 lookup_count;
+};
+
+static f64 now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+}
+
+static u64 rng_next(u64 *state) {
+    // xorshift64*
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545f4914f6cdd1dULL;
+}
+
+static f64 rng_unit(u64 *state) {
+    return (f64)(rng_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void* _counted_alloc(void *ctx, size_t size) {
+    return ref_alloc(ctx, size);
+}
+
+static void _counted_free(void *ctx, void *ptr, size_t size) {
+    ref_free(ctx, ptr, size);
+}
+
+static void* _hashmap_init(struct ByteCount *bytes, enum HashMapHash hash) {
+    struct HashMapConfig const config = {
+        .item_size=sizeof(u64),
+        .hash=hash,
+        .allocator={.alloc_func=_counted_alloc, .free_func=_counted_free, .ctx=bytes},
+    };
+    return hashmap_init_ex(&config);
+}
+
+static void* hashmap_siphash_init(struct ByteCount *bytes) {
+    return _hashmap_init(bytes, HASHMAP_HASH_SIPHASH24);
+}
+
+static void* hashmap_wyhash_init(struct ByteCount *bytes) {
+    return _hashmap_init(bytes, HASHMAP_HASH_WYHASH);
+}
+
+static bool hashmap_insert_value(void *table, char const *key, u64 value) {
+    return hashmap_insert(table, key, &value);
+}
+
+static bool hashmap_get_value(void *table, char const *key, u64 *value) {
+    u64 const *item = hashmap_get(table, key);
+    if (item == NULL) return false;
+
+    *value = *item;
+    return true;
+}
+
+static void hashmap_free_table(void *table) {
+    hashmap_free(table);
+}
+
+static void* linear_init(struct ByteCount *bytes) {
+    return ref_linear_init(bytes);
+}
+
+static bool linear_insert(void *table, char const *key, u64 value) {
+    return ref_linear_insert(table, key, value);
+}
+
+static bool linear_get(void *table, char const *key, u64 *value) {
+    return ref_linear_get(table, key, value);
+}
+
+static void linear_free(void *table) {
+    ref_linear_free(table);
+}
+
+static void* chained_init(struct ByteCount *bytes) {
+    return ref_chained_init(bytes);
+}
+
+static bool chained_insert(void *table, char const *key, u64 value) {
+    return ref_chained_insert(table, key, value);
+}
+
+static bool chained_get(void *table, char const *key, u64 *value) {
+    return ref_chained_get(table, key, value);
+}
+
+static void chained_free(void *table) {
+    ref_chained_free(table);
+}
+
+static struct Contender const contenders[] = {
+    {"robin hood siphash", hashmap_siphash_init, hashmap_insert_value, hashmap_get_value, hashmap_free_table},
+    {"robin hood wyhash", hashmap_wyhash_init, hashmap_insert_value, hashmap_get_value, hashmap_free_table},
+    {"linear fnv1a", linear_init, linear_insert, linear_get, linear_free},
+    {"chained fnv1a", chained_init, chained_insert, chained_get, chained_free},
+};
+
+static inline char const* key_at(struct Trace const *trace, u32 idx) {
+    return trace->keys + (size_t)idx * REF_MAX_KEY_BYTES;
+}
+
+static bool trace_alloc(struct Trace *trace, char const *name, u32 key_count, u32 lookup_count) {
+    trace->name = name;
+    trace->key_count = key_count;
+    trace->lookup_count = lookup_count;
+    trace->keys = malloc((size_t)key_count * REF_MAX_KEY_BYTES);
+    trace->lookups = malloc((size_t)lookup_count * sizeof *trace->lookups);
+
+    return trace->keys != NULL && trace->lookups != NULL;
+}
+
+static void trace_free(struct Trace *trace) {
+    free(trace->keys);
+    free(trace->lookups);
+}
+
+static void fill_plain_keys(struct Trace *trace) {
+    for (u32 i=0; i<trace->key_count; ++i) {
+        snprintf(trace->keys + (size_t)i * REF_MAX_KEY_BYTES, REF_MAX_KEY_BYTES, "key_%u", i);
+    }
+}
+
+static void fill_uniform_lookups(struct Trace *trace, u64 *rng) {
+    for (u32 i=0; i<trace->lookup_count; ++i) {
+        trace->lookups[i] = (u32)(rng_next(rng) % trace->key_count);
+    }
+}
+
+/*
+Lookups drawn from the Zipfian distribution by inverting its cumulative distribution with
+a binary search. Key ranks are shuffled so that hot keys are not inserted first.
+*/
+static bool fill_zipf_lookups(struct Trace *trace, u64 *rng) {
+    u32 const n = trace->key_count;
+    f64 *cdf = malloc((size_t)n * sizeof *cdf);
+    u32 *rank_to_key = malloc((size_t)n * sizeof *rank_to_key);
+    if (cdf == NULL || rank_to_key == NULL) {
+        free(cdf);
+        free(rank_to_key);
+        return false;
+    }
+    f64 sum = 0;
+    for (u32 r=0; r<n; ++r) {
+        sum += 1.0 / pow((f64)(r + 1), BENCH_ZIPF_EXPONENT);
+        cdf[r] = sum;
+    }
+    for (u32 r=0; r<n; ++r) {
+        rank_to_key[r] = r;
+    }
+    for (u32 r=n-1; r>0; --r) {
+        u32 const j = (u32)(rng_next(rng) % (r + 1));
+        u32 const tmp = rank_to_key[r];
+        rank_to_key[r] = rank_to_key[j];
+        rank_to_key[j] = tmp;
+    }
+
+    for (u32 i=0; i<trace->lookup_count; ++i) {
+        f64 const target = rng_unit(rng) * sum;
+        u32 lo = 0, hi = n - 1;
+
+        while (lo < hi) {
+            u32 const mid = lo + (hi - lo) / 2;
+            if (cdf[mid] < target) lo = mid + 1; else hi = mid;
+        }
+        trace->lookups[i] = rank_to_key[lo];
+    }
+    free(rank_to_key);
+    free(cdf);
+
+    return true;
+}
+
+/*
+Keys whose FNV-1a hashes are zero in the low bits covering the final capacity of both
+reference tables, found by brute force. Every key lands in the same bucket of them.
+*/
+static void fill_colliding_keys(struct Trace *trace) {
+    u64 mask = 1;
+    while (mask < (u64)trace->key_count * 4) {
+        mask <<= 1;
+    }
+    mask -= 1;
+
+    char key[REF_MAX_KEY_BYTES];
+    u32 candidate = 0;
+
+    for (u32 i=0; i<trace->key_count; ++candidate) {
+        int const len = snprintf(key, sizeof key, "c_%u", candidate);
+
+        if ((fnv1a(key, (size_t)len) & mask) == 0) {
+            memcpy(trace->keys + (size_t)i * REF_MAX_KEY_BYTES, key, (size_t)len + 1);
+            i += 1;
+        }
+    }
+}
+
+static void run_contender(struct Contender const *contender, struct Trace const *trace) {
+    struct ByteCount bytes = {0};
+    void *table = contender->init(&bytes);
+    if (table == NULL) {
+        fprintf(stderr, "Cannot init %s.\n", contender->name);
+        return;
+    }
+
+    f64 start = now_sec();
+    for (u32 i=0; i<trace->key_count; ++i) {
+        contender->insert(table, key_at(trace, i), i);
+    }
+    f64 const insert_sec = now_sec() - start;
+    f64 const bytes_per_entry = (f64)bytes.current / trace->key_count;
+
+    u64 found = 0, acc = 0;
+    start = now_sec();
+    for (u32 i=0; i<trace->lookup_count; ++i) {
+        u64 value;
+        if (contender->get(table, key_at(trace, trace->lookups[i]), &value)) {
+            found += 1;
+            acc += value;
+        }
+    }
+    f64 const get_sec = now_sec() - start;
+    sink = acc;
+
+    if (found != trace->lookup_count) {
+        fprintf(stderr, "%s found %llu of %u keys.\n",
+            contender->name, (unsigned long long)found, trace->lookup_count);
+    }
+    fprintf(stdout, "%-8s %-20s %9.2f %9.2f %10.1f %10.1f\n", trace->name, contender->name,
+        trace->key_count / insert_sec * 1e-6, trace->lookup_count / get_sec * 1e-6,
+        bytes_per_entry, (f64)bytes.peak / trace->key_count);
+
+    contender->free(table);
+}
+
+static void run_trace(struct Trace const *trace) {
+    for (size_t c=0; c<sizeof(contenders)/sizeof(contenders[0]); ++c) {
+        run_contender(&contenders[c], trace);
+    }
+}
+
+int main(int argc, char **argv) {
+    u32 const key_count = argc > 1 ? (u32)strtoul(argv[1], NULL, 10) : BENCH_DEFAULT_KEYS;
+    if (key_count == 0) {
+        fprintf(stderr, "Key count must be positive.\n");
+        return 1;
+    }
+    u64 rng = BENCH_SEED;
+    struct Trace trace;
+
+    fprintf(stdout, "%-8s %-20s %9s %9s %10s %10s\n",
+        "trace", "table", "ins Mop/s", "get Mop/s", "B/entry", "peak B/e");
+
+    if (!trace_alloc(&trace, "uniform", key_count, key_count * BENCH_LOOKUPS_PER_KEY)) return 1;
+    fill_plain_keys(&trace);
+    fill_uniform_lookups(&trace, &rng);
+    run_trace(&trace);
+
+    // Same keys, Zipfian lookups
+    trace.name = "zipf";
+    if (!fill_zipf_lookups(&trace, &rng)) return 1;
+    run_trace(&trace);
+    trace_free(&trace);
+
+    if (!trace_alloc(&trace, "collide", BENCH_COLLIDE_KEYS, BENCH_COLLIDE_KEYS * BENCH_LOOKUPS_PER_KEY)) return 1;
+    fill_colliding_keys(&trace);
+    fill_uniform_lookups(&trace, &rng);
+    run_trace(&trace);
+    trace_free(&trace);
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+/*
+Benchmark of the hash function choices of `hashmap_init_ex`.
+
+Measures the raw hashing cost per key length and the throughput of insert, get and
+batched get operations on a hash map for every hash choice. Run by `make bench`, element count can
+be given as the first argument.
+*/
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "siphash.h"
+#include "wyhash.h"
+#include "hashmap.h"
+
+#define BENCH_DEFAULT_ELEMS 100000U
+#define BENCH_HASH_ROUNDS 10000000U
+#define BENCH_KEY_BYTES 20
+#define BENCH_HASH_BATCH 16
+#define BENCH_GET_BATCH 256
+
+struct HashChoice {
+    char const *name;
+    enum HashMapHash hash;
+    u64 (*func)(void const *, size_t, u8 const [HASH_RAND_KEY_LEN]);
+};
+
+static struct HashChoice const choices[] = {
+    {"siphash-2-4", HASHMAP_HASH_SIPHASH24, siphash},
+    {"siphash-1-3", HASHMAP_HASH_SIPHASH13, siphash13},
+    {"wyhash", HASHMAP_HASH_WYHASH, wyhash},
+};
+
+static size_t const choice_count = sizeof(choices) / sizeof(choices[0]);
+
+// Prevents the compiler from dropping the measured work
+static volatile u64 sink;
+
+static f64 now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+}
+
+static void bench_raw_hashing() {
+    size_t const lengths[] = {8, 12, 19, 32, 64};
+    u8 const key[HASH_RAND_KEY_LEN] = {0x1, 0x2, 0x3, 0x4};
+    u8 data[64];
+
+    for (size_t i=0; i<sizeof(data); ++i) {
+        data[i] = (u8)(i * 31);
+    }
+    fprintf(stdout, "%-14s", "ns/hash");
+    for (size_t l=0; l<sizeof(lengths)/sizeof(lengths[0]); ++l) {
+        fprintf(stdout, "%8zuB", lengths[l]);
+    }
+    fprintf(stdout, "\n");
+
+    for (size_t c=0; c<choice_count; ++c) {
+        fprintf(stdout, "%-14s", choices[c].name);
+
+        for (size_t l=0; l<sizeof(lengths)/sizeof(lengths[0]); ++l) {
+            u64 acc = 0;
+            f64 const start = now_sec();
+            for (u32 r=0; r<BENCH_HASH_ROUNDS; ++r) {
+                data[0] = (u8)r;
+                acc += choices[c].func(data, lengths[l], key);
+            }
+            f64 const elapsed = now_sec() - start;
+            sink = acc;
+
+            fprintf(stdout, "%9.2f", elapsed * 1e9 / BENCH_HASH_ROUNDS);
+        }
+        fprintf(stdout, "\n");
+    }
+
+    // Batched SipHash-2-4, messages of one batch start at different offsets
+    void const *messages[BENCH_HASH_BATCH];
+    size_t batch_lengths[BENCH_HASH_BATCH];
+    u64 hashes[BENCH_HASH_BATCH];
+
+    fprintf(stdout, "%-14s", "siphash batch");
+    for (size_t l=0; l<sizeof(lengths)/sizeof(lengths[0]); ++l) {
+        u8 batch_data[BENCH_HASH_BATCH + 64];
+        for (size_t i=0; i<sizeof(batch_data); ++i) {
+            batch_data[i] = (u8)(i * 31);
+        }
+        for (u32 i=0; i<BENCH_HASH_BATCH; ++i) {
+            messages[i] = batch_data + i;
+            batch_lengths[i] = lengths[l];
+        }
+        u64 acc = 0;
+        f64 const start = now_sec();
+        for (u32 r=0; r<BENCH_HASH_ROUNDS; r+=BENCH_HASH_BATCH) {
+            batch_data[0] = (u8)r;
+            siphash_batch(messages, batch_lengths, BENCH_HASH_BATCH, key, hashes);
+            acc += hashes[0] + hashes[BENCH_HASH_BATCH - 1];
+        }
+        f64 const elapsed = now_sec() - start;
+        sink = acc;
+
+        fprintf(stdout, "%9.2f", elapsed * 1e9 / BENCH_HASH_ROUNDS);
+    }
+    fprintf(stdout, "\n\n");
+}
+
+static void report(char const *name, char const *op, u32 count, f64 elapsed) {
+    fprintf(stdout, "%-22s %-9s %8.2f Mops/s %8.1f ns/op\n",
+        name, op, count / elapsed * 1e-6, elapsed * 1e9 / count);
+}
+
+static void bench_string_keys(struct HashMapConfig const *config, char const *name, char const *keys, u32 elems) {
+    struct HashMap *hashmap = hashmap_init_ex(config);
+    if (hashmap == NULL) {
+        fprintf(stderr, "Cannot init hash map for %s.\n", name);
+        return;
+    }
+    f64 start = now_sec();
+    for (u32 i=0; i<elems; ++i) {
+        hashmap_insert(hashmap, keys + (size_t)i * BENCH_KEY_BYTES, &i);
+    }
+    report(name, "insert", elems, now_sec() - start);
+
+    u64 found = 0;
+    start = now_sec();
+    for (u32 i=0; i<elems; ++i) {
+        found += hashmap_get(hashmap, keys + (size_t)i * BENCH_KEY_BYTES) != NULL;
+    }
+    report(name, "get", elems, now_sec() - start);
+
+    char const *batch_keys[BENCH_GET_BATCH];
+    void *items[BENCH_GET_BATCH];
+    start = now_sec();
+    for (u32 i=0; i<elems; i+=BENCH_GET_BATCH) {
+        u32 const count = elems - i < BENCH_GET_BATCH ? elems - i : BENCH_GET_BATCH;
+        for (u32 j=0; j<count; ++j) {
+            batch_keys[j] = keys + (size_t)(i + j) * BENCH_KEY_BYTES;
+        }
+        found += hashmap_get_batch(hashmap, batch_keys, count, items);
+    }
+    report(name, "get batch", elems, now_sec() - start);
+    sink = found;
+
+    hashmap_free(hashmap);
+}
+
+static void bench_u64_keys(struct HashMapConfig const *config, char const *name, u32 elems) {
+    struct HashMap *hashmap = hashmap_init_ex(config);
+    if (hashmap == NULL) {
+        fprintf(stderr, "Cannot init hash map for %s.\n", name);
+        return;
+    }
+    f64 start = now_sec();
+    for (u32 i=0; i<elems; ++i) {
+        hashmap_insert_u64(hashmap, (u64)i * 0x9e3779b97f4a7c15ULL, &i);
+    }
+    report(name, "insert", elems, now_sec() - start);
+
+    u64 found = 0;
+    start = now_sec();
+    for (u32 i=0; i<elems; ++i) {
+        found += hashmap_get_u64(hashmap, (u64)i * 0x9e3779b97f4a7c15ULL) != NULL;
+    }
+    report(name, "get", elems, now_sec() - start);
+    sink = found;
+
+    hashmap_free(hashmap);
+}
+
+int main(int argc, char **argv) {
+    u32 const elems = argc > 1 ? (u32)strtoul(argv[1], NULL, 10) : BENCH_DEFAULT_ELEMS;
+
+    char *keys = malloc((size_t)elems * BENCH_KEY_BYTES);
+    if (keys == NULL) {
+        fprintf(stderr, "Cannot allocate keys.\n");
+        return 1;
+    }
+    for (u32 i=0; i<elems; ++i) {
+        snprintf(keys + (size_t)i * BENCH_KEY_BYTES, BENCH_KEY_BYTES, "key_%u", i);
+    }
+
+    bench_raw_hashing();
+
+    fprintf(stdout, "%u string keys\n", elems);
+    for (size_t c=0; c<choice_count; ++c) {
+        struct HashMapConfig const config = {
+            .item_size=sizeof(u32),
+            .init_elems=elems,
+            .hash=choices[c].hash
+        };
+        bench_string_keys(&config, choices[c].name, keys, elems);
+    }
+
+    fprintf(stdout, "\n%u integer keys\n", elems);
+    struct HashMapConfig config = {.item_size=sizeof(u32), .init_elems=elems, .key_type=HASHMAP_KEY_U64};
+    bench_u64_keys(&config, "mixer", elems);
+    for (size_t c=0; c<choice_count; ++c) {
+        config.hash = choices[c].hash;
+        bench_u64_keys(&config, choices[c].name, elems);
+    }
+
+    free(keys);
+    return 0;
+}
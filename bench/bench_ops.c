@@ -0,0 +1,398 @@
+/*
+Microbenchmark of the hot paths of the hash map.
+
+Every operation (insert, hit and miss get, remove, a mixed workload, iteration and resize)
+is run at sizes from 16 keys up to 2^20 keys (or as many as fit the maximal capacity) and
+with data items of 4, 64 and 512 bytes. Small sizes are repeated so that every case runs
+at least `BENCH_MIN_OPS` operations. Reports the mean cost per operation, p50 and p99
+latencies of individually timed sample operations (less the cost of reading the clock)
+and the memory held by the hash map once filled, counted by an allocator of the config
+(as requested from it, allocator overheads excluded). Run by `make bench`.
+
+Usage: hashmap_bench_ops [--csv] [max exponent of the size, 20 by default]
+
+With `--csv` the results are printed as comma separated values with a header line, to be
+collected and compared over time.
+*/
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "map.h"
+
+#define BENCH_MIN_OPS ((u64)1 << 20)
+#define BENCH_LAT_SAMPLES 4096U
+#define BENCH_KEY_BYTES 20
+#define BENCH_MAX_ITEM_BYTES 512U
+#define BENCH_DEFAULT_MAX_EXP 20U
+#define BENCH_MAX_TABLE_BYTES ((size_t)2 << 30)
+#define BENCH_CLOCK_CALIBRATIONS 1000U
+
+static u32 const size_exps[] = {4, 8, 12, 16, 20, 22};
+static u32 const item_sizes[] = {4, 64, BENCH_MAX_ITEM_BYTES};
+
+// Prevents the compiler from dropping the measured work
+static volatile u64 sink;
+static u64 iterated;
+static bool csv_output;
+static u64 clock_overhead_ns;
+
+/*
+Latencies of sample operations, every `stride`th operation of a run is timed on its own.
+*/
+struct Latency {
+    u64 samples[BENCH_LAT_SAMPLES];
+    u32 count;
+    u64 stride;
+    u64 next;
+};
+
+struct BenchCase {
+    u32 elems;
+    u32 item_bytes;
+    u32 rounds;
+    char const *keys;
+    char const *miss_keys;
+    u8 *item;
+    size_t map_bytes;
+};
+
+static u64 now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000U + (u64)ts.tv_nsec;
+}
+
+static int _cmp_u64(void const *a, void const *b) {
+    u64 const x = *(u64 const *)a, y = *(u64 const *)b;
+    return (x > y) - (x < y);
+}
+
+// Median cost of reading the clock twice, subtracted from the timed sample operations
+static u64 calibrate_clock() {
+    u64 costs[BENCH_CLOCK_CALIBRATIONS];
+
+    for (u32 i=0; i<BENCH_CLOCK_CALIBRATIONS; ++i) {
+        u64 const t0 = now_ns();
+        costs[i] = now_ns() - t0;
+    }
+    qsort(costs, BENCH_CLOCK_CALIBRATIONS, sizeof costs[0], _cmp_u64);
+
+    return costs[BENCH_CLOCK_CALIBRATIONS / 2];
+}
+
+static void lat_init(struct Latency *lat, u64 ops) {
+    lat->count = 0;
+    lat->stride = ops / BENCH_LAT_SAMPLES > 0 ? ops / BENCH_LAT_SAMPLES : 1;
+    lat->next = 0;
+}
+
+static inline bool lat_due(struct Latency const *lat, u64 op) {
+    return op == lat->next;
+}
+
+// Sample of `ns` measured over `ops` operations
+static inline void lat_record(struct Latency *lat, u64 ns, u64 ops) {
+    if (lat->count < BENCH_LAT_SAMPLES) {
+        lat->samples[lat->count++] = (ns > clock_overhead_ns ? ns - clock_overhead_ns : 0) / ops;
+    }
+    lat->next += lat->stride;
+}
+
+static u64 lat_percentile(struct Latency *lat, u32 percent) {
+    if (lat->count == 0) return 0;
+
+    qsort(lat->samples, lat->count, sizeof lat->samples[0], _cmp_u64);
+    u32 const idx = (u32)((u64)lat->count * percent / 100);
+
+    return lat->samples[idx < lat->count ? idx : lat->count - 1];
+}
+
+// Allocator of the hash maps, counts the bytes they hold in the `size_t` of `ctx`
+static void* counted_alloc(void *ctx, size_t size) {
+    void *ptr = malloc(size);
+    if (ptr) *(size_t *)ctx += size;
+    return ptr;
+}
+
+static void* counted_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+    void *new_ptr = realloc(ptr, new_size);
+    if (new_ptr) *(size_t *)ctx += new_size - old_size;
+    return new_ptr;
+}
+
+static void counted_free(void *ctx, void *ptr, size_t size) {
+    if (ptr == NULL) return;
+
+    *(size_t *)ctx -= size;
+    free(ptr);
+}
+
+static void report_header() {
+    if (csv_output) {
+        fprintf(stdout, "op,elems,item_bytes,ns_per_op,p50_ns,p99_ns,map_kib\n");
+    } else {
+        fprintf(stdout, "%-10s %8s %6s %9s %9s %9s %10s\n",
+            "op", "elems", "item", "ns/op", "p50 ns", "p99 ns", "map KiB");
+    }
+}
+
+static void report(char const *op, struct BenchCase const *bc, u64 total_ns, u64 ops, struct Latency *lat) {
+    f64 const ns_per_op = ops > 0 ? (f64)total_ns / ops : 0;
+    u64 const p50 = lat_percentile(lat, 50);
+    u64 const p99 = lat_percentile(lat, 99);
+
+    u64 const map_kib = (bc->map_bytes + 1023) / 1024;
+
+    if (csv_output) {
+        fprintf(stdout, "%s,%u,%u,%.2f,%llu,%llu,%llu\n", op, bc->elems, bc->item_bytes,
+            ns_per_op, (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)map_kib);
+    } else {
+        fprintf(stdout, "%-10s %8u %6u %9.2f %9llu %9llu %10llu\n", op, bc->elems, bc->item_bytes,
+            ns_per_op, (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)map_kib);
+    }
+}
+
+static inline char const* key_at(char const *keys, u64 idx) {
+    return keys + idx * BENCH_KEY_BYTES;
+}
+
+static inline void const* item_for(struct BenchCase const *bc, u32 value) {
+    memcpy(bc->item, &value, sizeof value);
+    return bc->item;
+}
+
+static bool count_item(char const *key, void *item) {
+    (void)key;
+    iterated += *(u8 *)item;
+    return true;
+}
+
+static void bench_reads(struct BenchCase const *bc, struct HashMap *hashmap, struct Latency *lat) {
+    u64 const ops = (u64)bc->elems * bc->rounds;
+    char const *const key_sets[] = {bc->keys, bc->miss_keys};
+    char const *const names[] = {"get_hit", "get_miss"};
+
+    for (u32 s=0; s<2; ++s) {
+        u64 found = 0;
+        lat_init(lat, ops);
+
+        u64 const start = now_ns();
+        for (u64 op=0; op<ops; ++op) {
+            char const *key = key_at(key_sets[s], op % bc->elems);
+
+            if (lat_due(lat, op)) {
+                u64 const t0 = now_ns();
+                found += hashmap_get(hashmap, key) != NULL;
+                lat_record(lat, now_ns() - t0, 1);
+            } else {
+                found += hashmap_get(hashmap, key) != NULL;
+            }
+        }
+        report(names[s], bc, now_ns() - start, ops, lat);
+        sink = found;
+    }
+}
+
+/*
+Mixed workload, out of every ten operations eight hit gets, an insertion of an absent key
+and the removal of that key, so the size of the hash map stays put.
+*/
+static void bench_mixed(struct BenchCase const *bc, struct HashMap *hashmap, struct Latency *lat) {
+    u64 const ops = (u64)bc->elems * bc->rounds;
+    u64 found = 0;
+    lat_init(lat, ops);
+
+    u64 const start = now_ns();
+    for (u64 op=0; op<ops; ++op) {
+        u64 const t0 = lat_due(lat, op) ? now_ns() : 0;
+        u64 const kind = op % 10;
+
+        if (kind < 8) {
+            found += hashmap_get(hashmap, key_at(bc->keys, op % bc->elems)) != NULL;
+        } else {
+            char const *key = key_at(bc->miss_keys, (op / 10) % bc->elems);
+            found += kind == 8 ? hashmap_insert(hashmap, key, item_for(bc, (u32)op)) :
+                hashmap_remove_into(hashmap, key, NULL);
+        }
+        if (t0) lat_record(lat, now_ns() - t0, 1);
+    }
+    report("mixed", bc, now_ns() - start, ops, lat);
+    sink = found;
+}
+
+static void bench_iterate(struct BenchCase const *bc, struct HashMap *hashmap, struct Latency *lat) {
+    u64 total = 0;
+    lat_init(lat, bc->rounds);
+
+    for (u32 r=0; r<bc->rounds; ++r) {
+        u64 const t0 = now_ns();
+        hashmap_iter_apply(hashmap, count_item);
+        u64 const elapsed = now_ns() - t0;
+
+        // Latency of visiting one data item
+        if (lat_due(lat, r)) lat_record(lat, elapsed, bc->elems);
+        total += elapsed;
+    }
+    report("iterate", bc, total, (u64)bc->elems * bc->rounds, lat);
+    sink = iterated;
+}
+
+/*
+Resize of a filled hash map to the capacity of twice its size, cost per rehashed data item.
+*/
+static void bench_resize(struct BenchCase const *bc, struct HashMapConfig const *config, struct Latency *lat) {
+    if (hmap_init_capa_for(config, (size_t)bc->elems * 2) > MAP_MAX_EXP_CAPACITY) return;
+
+    u64 total = 0;
+    lat_init(lat, bc->rounds);
+
+    for (u32 r=0; r<bc->rounds; ++r) {
+        struct HashMap *hashmap = hashmap_init_ex(config);
+        if (hashmap == NULL) return;
+
+        for (u32 i=0; i<bc->elems; ++i) {
+            hashmap_insert(hashmap, key_at(bc->keys, i), item_for(bc, i));
+        }
+        u64 const t0 = now_ns();
+        hashmap_reserve(hashmap, (size_t)bc->elems * 2);
+        u64 const elapsed = now_ns() - t0;
+
+        if (lat_due(lat, r)) lat_record(lat, elapsed, bc->elems);
+        total += elapsed;
+        hashmap_free(hashmap);
+    }
+    report("resize", bc, total, (u64)bc->elems * bc->rounds, lat);
+}
+
+/*
+Insertions to an empty hash map (growing it on the way) and removals of all keys, repeated
+for every round. Reads are measured on the filled hash map of the last round before its
+keys are removed.
+*/
+static void bench_case(
+    struct BenchCase *bc,
+    struct Latency *lat_insert,
+    struct Latency *lat_remove,
+    struct Latency *lat)
+{
+    size_t map_bytes = 0;
+    struct HashMapConfig const config = {
+        .item_size=bc->item_bytes,
+        .allocator={
+            .alloc_func=counted_alloc,
+            .realloc_func=counted_realloc,
+            .free_func=counted_free,
+            .ctx=&map_bytes,
+        },
+    };
+    u64 const ops = (u64)bc->elems * bc->rounds;
+    u64 insert_ns = 0, remove_ns = 0;
+    u64 insert_op = 0, remove_op = 0;
+    lat_init(lat_insert, ops);
+    lat_init(lat_remove, ops);
+
+    for (u32 r=0; r<bc->rounds; ++r) {
+        struct HashMap *hashmap = hashmap_init_ex(&config);
+        if (hashmap == NULL) {
+            fprintf(stderr, "Cannot init hash map of %u byte items.\n", bc->item_bytes);
+            return;
+        }
+        u64 start = now_ns();
+        for (u32 i=0; i<bc->elems; ++i, ++insert_op) {
+            u64 const t0 = lat_due(lat_insert, insert_op) ? now_ns() : 0;
+            hashmap_insert(hashmap, key_at(bc->keys, i), item_for(bc, i));
+            if (t0) lat_record(lat_insert, now_ns() - t0, 1);
+        }
+        insert_ns += now_ns() - start;
+
+        if (r == bc->rounds - 1) {
+            bc->map_bytes = map_bytes;
+            report("insert", bc, insert_ns, ops, lat_insert);
+
+            bench_reads(bc, hashmap, lat);
+            bench_mixed(bc, hashmap, lat);
+            bench_iterate(bc, hashmap, lat);
+        }
+
+        start = now_ns();
+        for (u32 i=0; i<bc->elems; ++i, ++remove_op) {
+            u64 const t0 = lat_due(lat_remove, remove_op) ? now_ns() : 0;
+            hashmap_remove_into(hashmap, key_at(bc->keys, i), NULL);
+            if (t0) lat_record(lat_remove, now_ns() - t0, 1);
+        }
+        remove_ns += now_ns() - start;
+        hashmap_free(hashmap);
+    }
+    report("remove", bc, remove_ns, ops, lat_remove);
+    bench_resize(bc, &config, lat);
+}
+
+int main(int argc, char **argv) {
+    u32 max_exp = BENCH_DEFAULT_MAX_EXP;
+
+    for (int a=1; a<argc; ++a) {
+        if (strcmp(argv[a], "--csv") == 0) {
+            csv_output = true;
+        } else {
+            max_exp = (u32)strtoul(argv[a], NULL, 10);
+        }
+    }
+    // Largest size that fits the maximal capacity, one key of the mixed workload on top
+    struct HashMapConfig const default_config = {0};
+    size_t max_elems = MAP_CAPACITY(MAP_MAX_EXP_CAPACITY);
+    while (hmap_init_capa_for(&default_config, max_elems + 1) > MAP_MAX_EXP_CAPACITY) {
+        max_elems -= max_elems / 64;
+    }
+
+    size_t const key_count = 2 * ((size_t)1 << max_exp);
+    char *keys = malloc(key_count * BENCH_KEY_BYTES);
+    u8 *item = calloc(1, BENCH_MAX_ITEM_BYTES);
+    struct Latency *lat_insert = malloc(sizeof *lat_insert);
+    struct Latency *lat_remove = malloc(sizeof *lat_remove);
+    struct Latency *lat = malloc(sizeof *lat);
+
+    if (keys == NULL || item == NULL || lat_insert == NULL || lat_remove == NULL || lat == NULL) {
+        fprintf(stderr, "Cannot allocate keys.\n");
+        return 1;
+    }
+    for (size_t i=0; i<key_count; ++i) {
+        snprintf(keys + i * BENCH_KEY_BYTES, BENCH_KEY_BYTES, "key_%u", (u32)i);
+    }
+
+    clock_overhead_ns = calibrate_clock();
+    report_header();
+    for (size_t e=0; e<sizeof(size_exps)/sizeof(size_exps[0]) && size_exps[e] <= max_exp; ++e) {
+        u32 const elems = (u32)((size_t)1 << size_exps[e] < max_elems ? (size_t)1 << size_exps[e] : max_elems);
+
+        for (size_t s=0; s<sizeof(item_sizes)/sizeof(item_sizes[0]); ++s) {
+            // Slots of the old and new table during a resize to twice the size
+            size_t const table_bytes = 3 * MAP_CAPACITY(hmap_init_capa_for(&default_config, elems)) *
+                ((size_t)item_sizes[s] + 32);
+            if (table_bytes > BENCH_MAX_TABLE_BYTES) {
+                fprintf(stderr, "Skipping %u keys of %u bytes, too much memory.\n", elems, item_sizes[s]);
+                continue;
+            }
+            struct BenchCase bc = {
+                .elems=elems,
+                .item_bytes=item_sizes[s],
+                .rounds=(u32)(BENCH_MIN_OPS / elems > 0 ? BENCH_MIN_OPS / elems : 1),
+                .keys=keys,
+                .miss_keys=keys + (size_t)elems * BENCH_KEY_BYTES,
+                .item=item,
+            };
+            bench_case(&bc, lat_insert, lat_remove, lat);
+        }
+    }
+
+    free(lat);
+    free(lat_remove);
+    free(lat_insert);
+    free(item);
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,100 @@
+/*
+Benchmark of the shrink policies of `hashmap_init_ex`.
+
+A hash map is filled to just below its growth point and then keys are removed and inserted
+back repeatedly, so that its size oscillates around the capacity boundary: removals reach
+the lower load factor of the current capacity and insertions the upper load factor of the
+halved capacity. Reports the throughput and the count of resizes for every policy. Run by
+`make bench`, round count can be given as the first argument.
+*/
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "common.h"
+#include "map.h"
+
+#define BENCH_DEFAULT_ROUNDS 50U
+#define BENCH_EXP_CAPACITY 17
+#define BENCH_KEY_BYTES 20
+
+struct ShrinkChoice {
+    char const *name;
+    enum HashMapShrink shrink;
+};
+
+static struct ShrinkChoice const choices[] = {
+    {"eager", HASHMAP_SHRINK_EAGER},
+    {"hysteresis", HASHMAP_SHRINK_HYSTERESIS},
+    {"never", HASHMAP_SHRINK_NEVER},
+};
+
+static f64 now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+}
+
+static void bench_oscillation(struct ShrinkChoice const *choice, char const *keys, u32 rounds) {
+    struct HashMapConfig const config = {.item_size=sizeof(u32), .shrink=choice->shrink};
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    if (hashmap == NULL) {
+        fprintf(stderr, "Cannot init hash map for %s.\n", choice->name);
+        return;
+    }
+    // Between the upper load factor of the halved capacity and the lower one of the full
+    size_t const capacity = MAP_CAPACITY(BENCH_EXP_CAPACITY);
+    u32 const high = (u32)(capacity * 0.45) + capacity / 64;
+    u32 const low = (u32)(capacity * 0.4) - capacity / 64;
+
+    for (u32 i=0; i<high; ++i) {
+        hmap_insert(hashmap, keys + (size_t)i * BENCH_KEY_BYTES, &i);
+    }
+    u32 resizes = 0;
+    u32 ex_capa = hashmap->ex_capa;
+
+    f64 const start = now_sec();
+    for (u32 round=0; round<rounds; ++round) {
+        for (u32 i=low; i<high; ++i) {
+            hmap_remove_into(hashmap, keys + (size_t)i * BENCH_KEY_BYTES, NULL);
+            resizes += hashmap->ex_capa != ex_capa;
+            ex_capa = hashmap->ex_capa;
+        }
+        for (u32 i=low; i<high; ++i) {
+            hmap_insert(hashmap, keys + (size_t)i * BENCH_KEY_BYTES, &i);
+            resizes += hashmap->ex_capa != ex_capa;
+            ex_capa = hashmap->ex_capa;
+        }
+    }
+    f64 const elapsed = now_sec() - start;
+    u64 const ops = (u64)rounds * 2 * (high - low);
+
+    fprintf(stdout, "%-12s %8.1f ns/op %8u resizes %8zu final capacity\n",
+        choice->name, elapsed * 1e9 / ops, resizes, MAP_CAPACITY(hashmap->ex_capa));
+
+    hmap_free(hashmap);
+}
+
+int main(int argc, char **argv) {
+    u32 const rounds = argc > 1 ? (u32)strtoul(argv[1], NULL, 10) : BENCH_DEFAULT_ROUNDS;
+    size_t const elems = MAP_CAPACITY(BENCH_EXP_CAPACITY);
+
+    char *keys = malloc(elems * BENCH_KEY_BYTES);
+    if (keys == NULL) {
+        fprintf(stderr, "Cannot allocate keys.\n");
+        return 1;
+    }
+    for (size_t i=0; i<elems; ++i) {
+        snprintf(keys + i * BENCH_KEY_BYTES, BENCH_KEY_BYTES, "key_%zu", i);
+    }
+
+    fprintf(stdout, "%u rounds of oscillating removals and insertions\n", rounds);
+    for (size_t c=0; c<sizeof(choices)/sizeof(choices[0]); ++c) {
+        bench_oscillation(&choices[c], keys, rounds);
+    }
+
+    free(keys);
+    return 0;
+}
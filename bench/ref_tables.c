@@ -0,0 +1,237 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ref_tables.h"
+
+#define REF_INIT_CAPA 16
+#define REF_FNV_OFFSET 0xcbf29ce484222325ULL
+#define REF_FNV_PRIME 0x100000001b3ULL
+
+
+void* ref_alloc(struct ByteCount *count, size_t size) {
+    void *ptr = malloc(size);
+    if (ptr) {
+        count->current += size;
+        if (count->current > count->peak) count->peak = count->current;
+    }
+    return ptr;
+}
+
+void ref_free(struct ByteCount *count, void *ptr, size_t size) {
+    if (ptr == NULL) return;
+
+    count->current -= size;
+    free(ptr);
+}
+
+u64 fnv1a(char const *key, size_t len) {
+    u64 hash = REF_FNV_OFFSET;
+
+    for (size_t i=0; i<len; ++i) {
+        hash ^= (u8)key[i];
+        hash *= REF_FNV_PRIME;
+    }
+    return hash;
+}
+
+// Zero marks an empty slot of the linear table
+static inline u64 _nonzero_hash(char const *key, size_t len) {
+    u64 const hash = fnv1a(key, len);
+    return hash ? hash : 1;
+}
+
+static struct RefLinearSlot* _linear_slots(struct ByteCount *bytes, size_t capa) {
+    struct RefLinearSlot *slots = ref_alloc(bytes, capa * sizeof *slots);
+    if (slots) memset(slots, 0, capa * sizeof *slots);
+
+    return slots;
+}
+
+struct RefLinear* ref_linear_init(struct ByteCount *bytes) {
+    struct RefLinear *table = ref_alloc(bytes, sizeof *table);
+    if (table == NULL) return NULL;
+
+    table->slots = _linear_slots(bytes, REF_INIT_CAPA);
+    if (table->slots == NULL) {
+        ref_free(bytes, table, sizeof *table);
+        return NULL;
+    }
+    table->capa = REF_INIT_CAPA;
+    table->len = 0;
+    table->bytes = bytes;
+
+    return table;
+}
+
+static struct RefLinearSlot* _linear_find(struct RefLinearSlot *slots, size_t capa, char const *key, u64 hash) {
+    size_t idx = hash & (capa - 1);
+
+    while (slots[idx].hash != 0) {
+        if (slots[idx].hash == hash && strcmp(slots[idx].key, key) == 0) break;
+        idx = (idx + 1) & (capa - 1);
+    }
+    return &slots[idx];
+}
+
+static bool _linear_grow(struct RefLinear *table) {
+    size_t const new_capa = table->capa * 2;
+    struct RefLinearSlot *new_slots = _linear_slots(table->bytes, new_capa);
+    if (new_slots == NULL) return false;
+
+    for (size_t i=0; i<table->capa; ++i) {
+        struct RefLinearSlot const *slot = &table->slots[i];
+        if (slot->hash != 0) {
+            *_linear_find(new_slots, new_capa, slot->key, slot->hash) = *slot;
+        }
+    }
+    ref_free(table->bytes, table->slots, table->capa * sizeof *table->slots);
+    table->slots = new_slots;
+    table->capa = new_capa;
+
+    return true;
+}
+
+bool ref_linear_insert(struct RefLinear *table, char const *key, u64 value) {
+    size_t const len = strlen(key);
+    if (len >= REF_MAX_KEY_BYTES) return false;
+
+    if ((table->len + 1) * 4 > table->capa * 3 && !_linear_grow(table)) return false;
+
+    u64 const hash = _nonzero_hash(key, len);
+    struct RefLinearSlot *slot = _linear_find(table->slots, table->capa, key, hash);
+    if (slot->hash == 0) {
+        slot->hash = hash;
+        memcpy(slot->key, key, len + 1);
+        table->len += 1;
+    }
+    slot->value = value;
+
+    return true;
+}
+
+bool ref_linear_get(struct RefLinear *table, char const *key, u64 *value) {
+    u64 const hash = _nonzero_hash(key, strlen(key));
+    struct RefLinearSlot const *slot = _linear_find(table->slots, table->capa, key, hash);
+
+    if (slot->hash == 0) return false;
+    *value = slot->value;
+
+    return true;
+}
+
+void ref_linear_free(struct RefLinear *table) {
+    if (table == NULL) return;
+
+    ref_free(table->bytes, table->slots, table->capa * sizeof *table->slots);
+    ref_free(table->bytes, table, sizeof *table);
+}
+
+static struct RefChainedNode** _chained_buckets(struct ByteCount *bytes, size_t capa) {
+    struct RefChainedNode **buckets = ref_alloc(bytes, capa * sizeof *buckets);
+    if (buckets) memset(buckets, 0, capa * sizeof *buckets);
+
+    return buckets;
+}
+
+static inline size_t _node_bytes(struct RefChainedNode const *node) {
+    return sizeof *node + strlen(node->key) + 1;
+}
+
+struct RefChained* ref_chained_init(struct ByteCount *bytes) {
+    struct RefChained *table = ref_alloc(bytes, sizeof *table);
+    if (table == NULL) return NULL;
+
+    table->buckets = _chained_buckets(bytes, REF_INIT_CAPA);
+    if (table->buckets == NULL) {
+        ref_free(bytes, table, sizeof *table);
+        return NULL;
+    }
+    table->capa = REF_INIT_CAPA;
+    table->len = 0;
+    table->bytes = bytes;
+
+    return table;
+}
+
+static bool _chained_grow(struct RefChained *table) {
+    size_t const new_capa = table->capa * 2;
+    struct RefChainedNode **new_buckets = _chained_buckets(table->bytes, new_capa);
+    if (new_buckets == NULL) return false;
+
+    for (size_t i=0; i<table->capa; ++i) {
+        struct RefChainedNode *node = table->buckets[i];
+
+        while (node) {
+            struct RefChainedNode *next = node->next;
+            size_t const idx = node->hash & (new_capa - 1);
+            node->next = new_buckets[idx];
+            new_buckets[idx] = node;
+            node = next;
+        }
+    }
+    ref_free(table->bytes, table->buckets, table->capa * sizeof *table->buckets);
+    table->buckets = new_buckets;
+    table->capa = new_capa;
+
+    return true;
+}
+
+static struct RefChainedNode* _chained_find(struct RefChained const *table, char const *key, u64 hash) {
+    struct RefChainedNode *node = table->buckets[hash & (table->capa - 1)];
+
+    while (node && (node->hash != hash || strcmp(node->key, key) != 0)) {
+        node = node->next;
+    }
+    return node;
+}
+
+bool ref_chained_insert(struct RefChained *table, char const *key, u64 value) {
+    size_t const len = strlen(key);
+    if (len >= REF_MAX_KEY_BYTES) return false;
+
+    u64 const hash = fnv1a(key, len);
+    struct RefChainedNode *node = _chained_find(table, key, hash);
+    if (node) {
+        node->value = value;
+        return true;
+    }
+    if (table->len + 1 > table->capa && !_chained_grow(table)) return false;
+
+    node = ref_alloc(table->bytes, sizeof *node + len + 1);
+    if (node == NULL) return false;
+
+    size_t const idx = hash & (table->capa - 1);
+    node->hash = hash;
+    node->value = value;
+    memcpy(node->key, key, len + 1);
+    node->next = table->buckets[idx];
+    table->buckets[idx] = node;
+    table->len += 1;
+
+    return true;
+}
+
+bool ref_chained_get(struct RefChained *table, char const *key, u64 *value) {
+    struct RefChainedNode const *node = _chained_find(table, key, fnv1a(key, strlen(key)));
+
+    if (node == NULL) return false;
+    *value = node->value;
+
+    return true;
+}
+
+void ref_chained_free(struct RefChained *table) {
+    if (table == NULL) return;
+
+    for (size_t i=0; i<table->capa; ++i) {
+        struct RefChainedNode *node = table->buckets[i];
+
+        while (node) {
+            struct RefChainedNode *next = node->next;
+            ref_free(table->bytes, node, _node_bytes(node));
+            node = next;
+        }
+    }
+    ref_free(table->bytes, table->buckets, table->capa * sizeof *table->buckets);
+    ref_free(table->bytes, table, sizeof *table);
+}
@@ -0,0 +1,75 @@
+#ifndef __REF_TABLES__
+#define __REF_TABLES__
+
+#include "common.h"
+
+/*
+Reference hash tables for `bench_compare.c`, written as the simple tables commonly found
+in C code bases: an unkeyed FNV-1a hash, string keys of up to `REF_MAX_KEY_BYTES` - 1 bytes
+and u64 values. Neither supports removal, the benchmark does not need it.
+
+All memory is allocated through `ref_alloc` and `ref_free`, which account it to a
+ByteCount so that memory per entry can be compared with the hash map.
+*/
+
+#define REF_MAX_KEY_BYTES 20
+
+/*
+Bytes currently allocated and the peak of it.
+*/
+struct ByteCount {
+    size_t current;
+    size_t peak;
+};
+
+void* ref_alloc(struct ByteCount *count, size_t size);
+void ref_free(struct ByteCount *count, void *ptr, size_t size);
+
+u64 fnv1a(char const *key, size_t len);
+
+/*
+Open addressing with linear probing, power of two capacity doubled above 3/4 load. A slot
+holds the full hash (zero marks an empty slot), the key inline and the value.
+*/
+struct RefLinearSlot {
+    u64 hash;
+    char key[REF_MAX_KEY_BYTES];
+    u64 value;
+};
+
+struct RefLinear {
+    struct RefLinearSlot *slots;
+    size_t capa;
+    size_t len;
+    struct ByteCount *bytes;
+};
+
+struct RefLinear* ref_linear_init(struct ByteCount *bytes);
+bool ref_linear_insert(struct RefLinear *table, char const *key, u64 value);
+bool ref_linear_get(struct RefLinear *table, char const *key, u64 *value);
+void ref_linear_free(struct RefLinear *table);
+
+/*
+Separate chaining, power of two bucket count doubled above load 1. Every entry is a node
+allocated on its own, holding the full hash, the value and a copy of the key.
+*/
+struct RefChainedNode {
+    struct RefChainedNode *next;
+    u64 hash;
+    u64 value;
+    char key[];
+};
+
+struct RefChained {
+    struct RefChainedNode **buckets;
+    size_t capa;
+    size_t len;
+    struct ByteCount *bytes;
+};
+
+struct RefChained* ref_chained_init(struct ByteCount *bytes);
+bool ref_chained_insert(struct RefChained *table, char const *key, u64 value);
+bool ref_chained_get(struct RefChained *table, char const *key, u64 *value);
+void ref_chained_free(struct RefChained *table);
+
+#endif // __REF_TABLES__
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdio.h>
 
 struct HashMap;
 
@@ -20,7 +21,8 @@ when initialising the hash map and kept same during usage of the hash map struct
 
 Meta data consumes 4 bytes each, a key 20 bytes and the user data item x bytes. Size of
 one data item is restricted approx below 2^32 bytes. Also the slot count cannot
-exceed the upper bound of 2^20 slots.
+exceed the upper bound of 2^20 slots (2^32 slots when the library is built with
+`WIDE_HASH=1`, in which case meta data consumes 8 bytes).
 
 Params:
     item_size: size of one data item
@@ -40,6 +42,7 @@ Initialise a new hash map struct to a specific size.
 This is convenient (more so than the `hashmap_init`) if the user wants straight from
 the start a specific storage count for the hash map struct. E.g., to insert 10 000 elements
 to the hash map, this initialising option can allocate the needed storage size from the start.
+The capacity accounts for the load factor, so inserting `elems` data items never resizes.
 
 Params:
     item_size: size of one data item
@@ -53,11 +56,192 @@ Returns:
 */
 struct HashMap* hashmap_init_with_size(size_t item_size, size_t elems, void (*clean_func)(void *));
 
+/*
+Memory layout of the slots.
+
+HASHMAP_LAYOUT_INTERLEAVED: meta data, key and data item of a slot are stored next to
+    each other. Default, cheapest when most lookups hit and read the data item.
+HASHMAP_LAYOUT_SPLIT: meta data of all slots form one dense array, followed by separate
+    key and data item arrays. Probing then touches only the meta data array, which
+    favours lookup heavy use with many misses or large data items.
+*/
+enum HashMapLayout {
+    HASHMAP_LAYOUT_INTERLEAVED = 0,
+    HASHMAP_LAYOUT_SPLIT,
+};
+
+/*
+Type of the keys.
+
+HASHMAP_KEY_STRING: string (or binary) keys of at most 19 bytes, unless long keys are enabled.
+    Default, used with `hashmap_insert`, `hashmap_insert_n` and the respective functions.
+HASHMAP_KEY_U64: 64-bit integer keys stored inline in 8 bytes and hashed by a fast mixer.
+    Used with `hashmap_insert_u64` and the respective functions.
+*/
+enum HashMapKeyType {
+    HASHMAP_KEY_STRING = 0,
+    HASHMAP_KEY_U64,
+};
+
+/*
+Hash function of the keys.
+
+Keyed choices are seeded with the random key of the hash map, generated at initialisation.
+
+HASHMAP_HASH_DEFAULT: SipHash-2-4 for string keys, a fast mixer for integer keys (SipHash-2-4
+    if `dos_resistant` is set).
+HASHMAP_HASH_SIPHASH24: SipHash-2-4, resistant to hash flooding.
+HASHMAP_HASH_SIPHASH13: SipHash-1-3, fewer rounds than SipHash-2-4 and thus faster, still a
+    keyed hash that is considered sufficient against hash flooding in hash tables.
+HASHMAP_HASH_WYHASH: wyhash style keyed hash built on 64-bit multiplications. Fastest choice,
+    not a cryptographic hash.
+HASHMAP_HASH_CUSTOM: user supplied `hash_func` of the config.
+*/
+enum HashMapHash {
+    HASHMAP_HASH_DEFAULT = 0,
+    HASHMAP_HASH_SIPHASH24,
+    HASHMAP_HASH_SIPHASH13,
+    HASHMAP_HASH_WYHASH,
+    HASHMAP_HASH_CUSTOM,
+};
+
+/*
+Shrinking of the capacity when data items are removed.
+
+HASHMAP_SHRINK_EAGER: once the load falls to the lower load factor, the capacity is halved as
+    many times as the lower load factor allows. Default, keeps the memory use tight but a
+    hash map whose size oscillates around the shrink point resizes back and forth.
+HASHMAP_SHRINK_HYSTERESIS: the capacity is halved only while the load stays at most half of
+    the upper load factor. Consecutive resizes are then separated by insertions or removals
+    of about a quarter of the capacity, so oscillating sizes do not trigger repeated resizes.
+HASHMAP_SHRINK_NEVER: removals never shrink the capacity, see `hashmap_shrink_to_fit` for
+    shrinking explicitly.
+*/
+enum HashMapShrink {
+    HASHMAP_SHRINK_EAGER = 0,
+    HASHMAP_SHRINK_HYSTERESIS,
+    HASHMAP_SHRINK_NEVER,
+};
+
+/*
+Packing of the slots, i.e. the alignment of the data items and the padding it takes.
+
+HASHMAP_PACKING_NATURAL: data items are aligned to the largest power of two that divides the
+    item size, at most to pointer alignment (8 bytes on 64-bit platforms). As the alignment
+    of a type divides its size, this suffices for any type not aligned beyond pointers, e.g.
+    structs of integers, doubles and pointers. Default.
+HASHMAP_PACKING_ALIGNED: data items are aligned to `max_align_t` (16 bytes on x86-64), e.g.
+    for SIMD vector types or long double, at the cost of more padding.
+HASHMAP_PACKING_PACKED: data items are not aligned, slots are padded only for the meta data.
+    Densest choice, but data items must then be accessed by memcpy.
+*/
+enum HashMapPacking {
+    HASHMAP_PACKING_NATURAL = 0,
+    HASHMAP_PACKING_ALIGNED,
+    HASHMAP_PACKING_PACKED,
+};
+
+/*
+Memory allocator of a hash map, e.g. for allocating from a per-thread arena.
+
+Members:
+    alloc_func: returns `size` bytes of memory aligned for any type, or NULL if out of memory
+    realloc_func: resizes memory of `old_size` bytes from `alloc_func` to `new_size` bytes,
+        or returns NULL leaving it intact. May be NULL, then memory is resized by allocating,
+        copying and freeing.
+    free_func: frees memory of `size` bytes from `alloc_func`
+    ctx: passed as the first argument to the functions
+*/
+struct HashMapAllocator {
+    void* (*alloc_func)(void *ctx, size_t size);
+    void* (*realloc_func)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+    void (*free_func)(void *ctx, void *ptr, size_t size);
+    void *ctx;
+};
+
+/*
+Configuration for `hashmap_init_ex`.
+
+Members left zero-initialised fall back to the defaults used by `hashmap_init`.
+
+Members:
+    item_size: size of one data item
+    init_elems: initial storage count for the hash map, zero for the default capacity.
+        The capacity accounts for `max_load_factor`, inserting this many data items never resizes.
+    clean_func: a function pointer if custom cleaning functionality is needed.
+        If such is not needed, set this to NULL.
+    incremental_resize: if true, resizing does not rehash all slots at once. Instead, the old
+        and new slots live side by side and every insertion and removal moves a bounded
+        number of slots until the old slots are empty. Lookups search both in the meantime.
+        This keeps the latency of a single insertion flat for large hash maps.
+    layout: memory layout of the slots, see HashMapLayout
+    long_keys: if true, keys are not limited to 19 bytes. Keys of at most 19 bytes are still
+        stored inline in the slots, longer keys go to a separate key arena that the slots
+        refer to. Memory of removed long keys is reclaimed in bulk once most of the arena
+        is unused. Not available with integer keys.
+    key_type: type of the keys, see HashMapKeyType
+    dos_resistant: if true, integer keys are hashed with SipHash-2-4 like string keys
+        instead of the fast mixer. Use this when the keys may be chosen by an adversary.
+        Affects only the default hash function.
+    hash: hash function of the keys, see HashMapHash
+    hash_func: hash function for `HASHMAP_HASH_CUSTOM`. It gets the key bytes (for integer
+        keys the 8 bytes of the integer), the key length and the 16 byte random key of the
+        hash map, which it may use as a seed. Must return the same value for equal keys.
+    lock_free_reads: used only by `hashmap_sharded_init`. If true, `hashmap_sharded_get` takes
+        no lock but validates its read against a sequence counter of the shard and retries
+        if a writer modified the shard meanwhile. Suits read-mostly use with many threads.
+        Not available with long keys.
+    allocator: allocator for all memory of the hash map, see HashMapAllocator. Both
+        `alloc_func` and `free_func` must be given, or neither for `malloc` and `free`.
+    max_load_factor: upper load factor in (0, 1), the capacity is doubled when an insertion
+        would exceed it. Zero for the default 0.9.
+    min_load_factor: lower load factor, below half of the upper one. Removals that bring the
+        load down to it shrink the capacity according to `shrink`. Zero for the default,
+        0.4 with the default upper load factor and in the same proportion otherwise.
+    shrink: policy for shrinking the capacity on removals, see HashMapShrink
+    huge_pages: if true, slots taking at least 2 MiB are mapped with mmap and advised to be
+        backed by transparent huge pages (MADV_HUGEPAGE), bypassing `allocator`. This cuts
+        the TLB misses of lookups in large hash maps. Linux only, ignored elsewhere.
+    packing: alignment of the data items in the slots, see HashMapPacking
+*/
+struct HashMapConfig {
+    size_t item_size;
+    size_t init_elems;
+    void (*clean_func)(void *);
+    bool incremental_resize;
+    enum HashMapLayout layout;
+    bool long_keys;
+    enum HashMapKeyType key_type;
+    bool dos_resistant;
+    enum HashMapHash hash;
+    uint64_t (*hash_func)(void const *data, size_t len, uint8_t const key[16]);
+    bool lock_free_reads;
+    struct HashMapAllocator allocator;
+    bool huge_pages;
+    double max_load_factor;
+    double min_load_factor;
+    enum HashMapShrink shrink;
+    enum HashMapPacking packing;
+};
+
+/*
+Initialise a new hash map struct from a configuration.
+
+Params:
+    config: HashMapConfig struct, see its documentation for the options
+
+Returns:
+    struct HashMap*: a pointer to created hash map struct. If the initialisation failed for 
+        some reason (not enough memory available, or too large item size), NULL is returned.
+*/
+struct HashMap* hashmap_init_ex(struct HashMapConfig const *config);
+
 /*
 Insert data item to the hash map.
 
 Size of the key is limited to 19 bytes and the insertion will fail (return false) if the
-used key is too large. It's recommended that the key consists only of characters
+used key is too large, unless the hash map was initialised with `long_keys` enabled
+(see `hashmap_init_ex`). It's recommended that the key consists only of characters
 that consume one byte of memory (ascii characters).
 
 For every insertion, the hash map makes itself a shallow copy of the passed data item and key.
@@ -134,6 +318,218 @@ Returns:
 */
 void* hashmap_remove(struct HashMap *hashmap, char const *key);
 
+/*
+Insert data item to the hash map with a key of explicit length.
+
+Works as `hashmap_insert` but the key is any sequence of `len` bytes, e.g. a packed
+integer ID or a binary UUID, and may contain null bytes. No length scan is done for
+the key. A string key and a binary key with the same bytes map to the same data item.
+
+Key length limits are the same as for `hashmap_insert`. Keys passed to the callback
+of `hashmap_iter_apply` are treated as strings, so binary keys containing null bytes
+are seen there only up to the first null byte.
+
+Params:
+    hashmap: HashMap struct
+    key: pointer to the key bytes
+    len: length of the key in bytes
+    data: data item to be inserted
+
+Returns:
+    bool: true if insertion succeeded, false otherwise
+*/
+bool hashmap_insert_n(struct HashMap *hashmap, void const *key, size_t len, void const *data);
+
+/*
+Get data item from the hash map with a key of explicit length.
+
+See `hashmap_get` and `hashmap_insert_n`.
+
+Params:
+    hashmap: HashMap struct
+    key: pointer to the key bytes
+    len: length of the key in bytes
+
+Returns:
+    pointer to the data item: if the key is found, otherwise NULL
+*/
+void* hashmap_get_n(struct HashMap *hashmap, void const *key, size_t len);
+
+/*
+Remove data item from the hash map with a key of explicit length.
+
+See `hashmap_remove` and `hashmap_insert_n`.
+
+Params:
+    hashmap: HashMap struct
+    key: pointer to the key bytes
+    len: length of the key in bytes
+
+Returns:
+    pointer to the removed data item: this if such a data item is found, otherwise NULL.
+*/
+void* hashmap_remove_n(struct HashMap *hashmap, void const *key, size_t len);
+
+/*
+Remove data item from the hash map and copy it to caller memory.
+
+Unlike `hashmap_remove`, which returns the data item from a temporary location of the
+hash map, the removed data item is copied straight from its slot to `item`. The copy
+stays valid regardless of later operations, which also makes the user responsible for
+cleaning it up, see `hashmap_free`.
+
+Params:
+    hashmap: HashMap struct
+    key: null terminated key
+    item: buffer of at least the data item size, may be NULL to just drop the data item
+
+Returns:
+    bool: true if the key was found and removed, false otherwise (`item` is left untouched)
+*/
+bool hashmap_remove_into(struct HashMap *hashmap, char const *key, void *item);
+
+/*
+Insert data item to a hash map with integer keys.
+
+Hash map must have been initialised by `hashmap_init_ex` with key type `HASHMAP_KEY_U64`,
+otherwise the insertion fails. Apart from the key, works as `hashmap_insert`.
+
+Params:
+    hashmap: HashMap struct
+    key: integer key
+    data: data item to be inserted
+
+Returns:
+    bool: true if insertion succeeded, false otherwise
+*/
+bool hashmap_insert_u64(struct HashMap *hashmap, uint64_t key, void const *data);
+
+/*
+Get data item from a hash map with integer keys.
+
+See `hashmap_get` and `hashmap_insert_u64`.
+
+Params:
+    hashmap: HashMap struct
+    key: integer key
+
+Returns:
+    pointer to the data item: if the key is found, otherwise NULL
+*/
+void* hashmap_get_u64(struct HashMap *hashmap, uint64_t key);
+
+/*
+Remove data item from a hash map with integer keys.
+
+See `hashmap_remove` and `hashmap_insert_u64`.
+
+Params:
+    hashmap: HashMap struct
+    key: integer key
+
+Returns:
+    pointer to the removed data item: this if such a data item is found, otherwise NULL.
+*/
+void* hashmap_remove_u64(struct HashMap *hashmap, uint64_t key);
+
+/*
+Get data items of several keys at once.
+
+Keys are processed in groups: the hashes of a group are computed first and the home
+buckets of the keys prefetched, only then the keys are looked up. This way the cache
+misses of the lookups overlap instead of following one another, which makes a batch
+faster than calling `hashmap_get` for each key once the hash map outgrows the CPU caches.
+
+Returned pointers have the same lifetime as the one returned by `hashmap_get`.
+
+Params:
+    hashmap: HashMap struct
+    keys: array of `count` null terminated keys
+    count: count of the keys
+    items: array of `count` pointers, set to the data items of the keys in the same
+        order (NULL for keys not found)
+
+Returns:
+    size_t: count of the keys found
+*/
+size_t hashmap_get_batch(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    size_t count,
+    void *items[]);
+
+/*
+Insert data items of several keys at once.
+
+Works as `hashmap_insert` for each key in order, with the hashing and prefetching done in
+groups as in `hashmap_get_batch`. A failed insertion does not stop the batch.
+
+Params:
+    hashmap: HashMap struct
+    keys: array of `count` null terminated keys
+    count: count of the keys
+    data: array of `count` pointers to the data items to be inserted
+
+Returns:
+    size_t: count of the succeeded insertions
+*/
+size_t hashmap_insert_batch(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    size_t count,
+    void const *const data[]);
+
+/*
+Remove data items of several keys at once.
+
+Works as `hashmap_remove` for each key in order, with the hashing and prefetching done in
+groups as in `hashmap_get_batch`. As a removed data item lives only until the next
+operation, removed items are copied to the buffer `items` if one is given.
+
+Params:
+    hashmap: HashMap struct
+    keys: array of `count` null terminated keys
+    count: count of the keys
+    items: NULL or a buffer of `count` data items, the removed data item of the i-th key
+        is copied to the i-th position (positions of keys not found are left untouched)
+
+Returns:
+    size_t: count of the removed data items
+*/
+size_t hashmap_remove_batch(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    size_t count,
+    void *items);
+
+/*
+Build the hash map from arrays of keys and data items in one pass.
+
+Meant for loading many data items at once, e.g. at a cold start. All keys are hashed up
+front, the capacity is reserved once for `count` data items, and the keys are sorted by
+their home slot so that they are placed by a single linear sweep over the slots, without
+the probing and displacements of separate insertions. Keys that are NULL or too long are
+skipped, and of duplicate keys the last one's data item is kept as with insertions.
+
+The sweep needs an empty hash map. If the hash map already holds data items, or memory for
+the sort cannot be allocated, the data items are inserted one by one instead with the same
+result. Not available with integer keys.
+
+Params:
+    hashmap: HashMap struct
+    keys: array of `count` null terminated keys
+    items: array of `count` data items, the i-th data item is mapped to by the i-th key
+    count: count of the keys and data items
+
+Returns:
+    size_t: count of data items added to the hash map, duplicate keys counted once
+*/
+size_t hashmap_build(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    void const *items,
+    size_t count);
+
 /*
 Free the memory allocated for the hash map.
 
@@ -180,6 +576,21 @@ Returns:
 */
 bool hashmap_iter_apply(struct HashMap *hashmap, bool (*callback)(char const *, void *));
 
+/*
+Iterate a hash map with integer keys and apply a callback to the keys and data items.
+
+Works as `hashmap_iter_apply`, which in turn fails for hash maps with integer keys.
+
+Params:
+    hashmap: HashMap struct
+    callback: a function pointer that is to be applied for data items. This function
+        must take two arguments for the key and data item and return a boolean value.
+
+Returns:
+    bool: true if the hash map was completely iterated through, false otherwise.
+*/
+bool hashmap_iter_apply_u64(struct HashMap *hashmap, bool (*callback)(uint64_t, void *));
+
 /*
 Get the current length of the hash map.
 
@@ -193,6 +604,99 @@ Returns:
 */
 uint32_t hashmap_len(struct HashMap *hashmap);
 
+/*
+Grow the hash map so that it holds `elems` data items without resizing.
+
+The capacity is increased in a single rehash, after which insertions up to `elems` data
+items in total never resize the hash map. Does nothing if the capacity suffices already,
+the hash map is never shrunk here. An incremental resize in progress is finished first.
+
+Params:
+    hashmap: HashMap struct
+    elems: count of data items to make room for, including the current ones
+
+Returns:
+    bool: true if the hash map holds `elems` data items without resizing, false if
+        the resize failed (e.g. out of memory or over the maximal capacity)
+*/
+bool hashmap_reserve(struct HashMap *hashmap, size_t elems);
+
+/*
+Shrink the capacity of the hash map to the smallest one that holds its data items.
+
+The capacity is left so that the next insertion does not need to grow it. Useful with the
+`HASHMAP_SHRINK_NEVER` policy after a burst of removals, or after hysteresis left the hash
+map sparser than needed. An incremental resize in progress is finished.
+
+Params:
+    hashmap: HashMap struct
+
+Returns:
+    bool: true if the hash map was shrunk or had the fitting capacity already, false if
+        the resize failed (e.g. out of memory) and the capacity was kept
+*/
+bool hashmap_shrink_to_fit(struct HashMap *hashmap);
+
+/*
+Save the hash map to a binary snapshot file.
+
+The slot array is written as it is in memory, together with the key arena, the random key
+and the configuration of the hash map, under a versioned header with checksums. An
+incremental resize in progress is finished first. Data items are stored as raw bytes, so
+pointers in them are meaningless once loaded. Hash maps with a custom hash function cannot
+be saved, as the function cannot be restored.
+
+The snapshot is written to a temporary file next to `path`, synced to disk and renamed over
+`path`. A failed save leaves an existing file intact, and processes that opened it by
+`hashmap_open_mmap` keep reading the old file. The file gets mode 0644 less the umask.
+
+Params:
+    hashmap: HashMap struct
+    path: file to write, replaced if it exists. Its directory must be writable.
+
+Returns:
+    bool: true if the snapshot was written, false otherwise
+*/
+bool hashmap_save(struct HashMap *hashmap, char const *path);
+
+/*
+Load a hash map from a snapshot file written by `hashmap_save`.
+
+Slots are read straight into the slot array and no key is rehashed, as the stored hashes
+and probe sequence lengths stay valid with the stored random key. Loading fails for files
+that are corrupted (checksum mismatch), of another format version, or written by a build
+with another byte order or bucket size (`WIDE_HASH`). The loaded hash map uses the default
+allocator and no cleaning function.
+
+Params:
+    path: snapshot file
+
+Returns:
+    struct HashMap*: the loaded hash map, or NULL if loading failed
+*/
+struct HashMap* hashmap_load(char const *path);
+
+/*
+Open a snapshot file written by `hashmap_save` as a read-only hash map without copying it.
+
+The file is mapped to memory and lookups probe the mapped slot array in place, so opening
+takes constant time regardless of the size of the hash map and pages are read in on demand.
+Processes opening the same file share its pages through the page cache, which suits e.g.
+a large static dictionary used by many worker processes. Insertions, removals and resizes
+are rejected, and data items returned by `hashmap_get` or passed to `hashmap_iter_apply`
+callbacks must not be modified. Only the header of the file is validated, use
+`hashmap_load` to verify the checksums of the slots. References of long keys are checked
+to stay within the key arena before it is read, so corrupted slots cannot make lookups
+read outside the mapping. Release by `hashmap_free`, which unmaps the file.
+
+Params:
+    path: snapshot file, must not be modified while the hash map is open
+
+Returns:
+    struct HashMap*: the mapped hash map, or NULL if opening failed
+*/
+struct HashMap* hashmap_open_mmap(char const *path);
+
 /*
 Traverse slots of the hash map.
 
@@ -215,5 +719,395 @@ Params:
 */
 void hashmap_stats_summary(struct HashMap *hashmap);
 
+#define HASHMAP_STATS_PSL_BUCKETS 32
+
+/*
+Statistics of a hash map, filled by `hashmap_get_stats`.
+
+Operation counters are kept only when the library is built with `STATS=1`, otherwise they
+stay zero. They count operations since initialisation through `hashmap_get`, `hashmap_insert`,
+`hashmap_remove` and the respective `_n`, `_u64`, `_into` and batch functions. Lookups of
+the sharded and shared hash maps, which may run concurrently, are not counted. Counters are
+updated atomically, so `hashmap_get` stays safe to call from several threads on a hash map
+not modified meanwhile, at the cost of an atomic increment per lookup.
+
+Members:
+    capacity: total capacity in slots
+    len: count of the data items
+    gets: count of lookups, `get_hits` + `get_misses`
+    get_hits: count of lookups that found the key
+    get_misses: count of lookups that did not find the key
+    inserts: count of insertions of new keys
+    updates: count of insertions that replaced the data item of an existing key
+    removes: count of removed keys
+    displacements: count of slots displaced by a slot with a longer probe sequence when
+        placing a slot, including the placements of resizing
+    backward_shifts: count of slots shifted back by one slot after a removal
+    resizes_up: count of resizes to a larger capacity
+    resizes_down: count of resizes to a smaller capacity
+    resize_ns: nanoseconds spent on resizing, including the migration steps of incremental
+        resizing
+    max_psl: longest probe sequence length of the data items
+    psl_histogram: count of the data items by their probe sequence length (PSL), i.e. the
+        distance of their slot from the slot their hash points to. The last bucket counts
+        the data items of a PSL of at least `HASHMAP_STATS_PSL_BUCKETS` - 1. Computed from
+        the slots when the statistics are requested, also without `STATS=1`.
+*/
+struct HashMapStats {
+    uint64_t capacity;
+    uint64_t len;
+    uint64_t gets;
+    uint64_t get_hits;
+    uint64_t get_misses;
+    uint64_t inserts;
+    uint64_t updates;
+    uint64_t removes;
+    uint64_t displacements;
+    uint64_t backward_shifts;
+    uint64_t resizes_up;
+    uint64_t resizes_down;
+    uint64_t resize_ns;
+    uint64_t max_psl;
+    uint64_t psl_histogram[HASHMAP_STATS_PSL_BUCKETS];
+};
+
+/*
+Get statistics of the hash map without printing them, e.g. to export them as metrics.
+
+Long probe sequences in the histogram mean clustered slots, e.g. a poor custom hash function.
+Computing the histogram visits every slot, so it takes time linear in the capacity.
+
+Params:
+    hashmap: HashMap struct
+    stats: HashMapStats struct to be filled
+
+Returns:
+    bool: true if the operation counters are kept (library built with `STATS=1`), false if
+        only the capacity, length and probe sequence lengths were filled
+*/
+bool hashmap_get_stats(struct HashMap *hashmap, struct HashMapStats *stats);
+
+#define HASHMAP_STATS_CLUSTER_BUCKETS 32
+
+/*
+Memory layout statistics of a hash map, filled by `hashmap_get_layout_stats`.
+
+A cluster is a maximal run of consecutive occupied slots. Lookups of keys that are missing
+scan to the end of the cluster, so long clusters make lookups slow even if the probe
+sequence lengths stay short.
+
+During an incremental resize, the slots being migrated are included.
+
+Members:
+    capacity: total capacity in slots
+    len: count of the data items
+    max_psl: longest probe sequence length of the data items
+    mean_psl: mean probe sequence length of the data items
+    cluster_count: count of the clusters
+    max_cluster_len: length of the longest cluster in slots
+    mean_cluster_len: mean length of the clusters in slots
+    cluster_histogram: count of the clusters by their length, bucket b counts the clusters
+        of length [2^b, 2^(b + 1)) slots
+    slot_bytes: size of one slot (meta data, key and data item) in bytes
+    table_bytes: bytes of the slots
+    arena_bytes: bytes of the key arena (long keys)
+    allocated_bytes: bytes allocated by the hash map in total, slots of a shared memory
+        region or a mapped file excluded
+    key_padding_bytes: bytes of the slots that pad key fields for data item alignment
+    alignment_bytes: bytes of the slots that pad slots to the alignment of their meta data
+        and data items, see HashMapPacking
+    empty_bytes: bytes of the unoccupied slots
+*/
+struct HashMapLayoutStats {
+    uint64_t capacity;
+    uint64_t len;
+    uint64_t max_psl;
+    double mean_psl;
+    uint64_t cluster_count;
+    uint64_t max_cluster_len;
+    double mean_cluster_len;
+    uint64_t cluster_histogram[HASHMAP_STATS_CLUSTER_BUCKETS];
+    uint64_t slot_bytes;
+    uint64_t table_bytes;
+    uint64_t arena_bytes;
+    uint64_t allocated_bytes;
+    uint64_t key_padding_bytes;
+    uint64_t alignment_bytes;
+    uint64_t empty_bytes;
+};
+
+/*
+Get memory layout statistics of the hash map without printing them.
+
+Visits every slot, so it takes time linear in the capacity.
+
+Params:
+    hashmap: HashMap struct
+    stats: HashMapLayoutStats struct to be filled
+*/
+void hashmap_get_layout_stats(struct HashMap *hashmap, struct HashMapLayoutStats *stats);
+
+/*
+Write the statistics of `hashmap_get_stats` and `hashmap_get_layout_stats` as a single line
+of compact JSON to `stream`, e.g. to analyse hash maps offline. Histograms are written up
+to their last nonzero bucket, and the operation counters only if the library is built with
+`STATS=1`.
+
+Params:
+    hashmap: HashMap struct
+    stream: stream to write to
+
+Returns:
+    bool: true if the JSON was written, false on a write error
+*/
+bool hashmap_stats_dump(struct HashMap *hashmap, FILE *stream);
+
+/*
+Write the JSON of `hashmap_stats_dump` to `buffer` of `size` bytes, null terminated.
+
+Params:
+    hashmap: HashMap struct
+    buffer: buffer to write to, may be NULL if `size` is zero
+    size: size of the buffer in bytes
+
+Returns:
+    size_t: length of the JSON without the null terminator. The JSON was truncated if this
+        is at least `size`, call again with a larger buffer.
+*/
+size_t hashmap_stats_dump_buffer(struct HashMap *hashmap, char *buffer, size_t size);
+
+struct ShardedHashMap;
+
+/*
+Initialise a new sharded hash map, which can be used from several threads at once.
+
+Key space is split by the key hashes over independent hash maps (shards), each of which
+is guarded by a reader-writer lock of its own. Lookups of one shard may run in parallel
+while insertions and removals lock only the shard of the key, so threads operating on
+different keys rarely wait for each other. All shards are configured by `config`, with
+the initial element count divided evenly among them. Only string keys are supported.
+
+Params:
+    config: HashMapConfig struct, see `hashmap_init_ex`
+    shard_count: count of the shards, rounded up to a power of two and at most 256.
+        If zero, 16 shards are used. Using a few times more shards than there are
+        threads keeps the lock contention low.
+
+Returns:
+    struct ShardedHashMap*: a pointer to created sharded hash map struct, NULL if the
+        initialisation failed.
+*/
+struct ShardedHashMap* hashmap_sharded_init(struct HashMapConfig const *config, size_t shard_count);
+
+/*
+Insert data item to a sharded hash map.
+
+Works as `hashmap_insert` and is safe to call concurrently with the other sharded
+hash map functions.
+
+Params:
+    smap: ShardedHashMap struct
+    key: null terminated key
+    data: data item to be inserted
+
+Returns:
+    bool: true if insertion succeeded, false otherwise
+*/
+bool hashmap_sharded_insert(struct ShardedHashMap *smap, char const *key, void const *data);
+
+/*
+Get a copy of a data item from a sharded hash map.
+
+As other threads may modify the hash map at any time, the data item is copied to
+`item` while the shard is locked instead of returning a pointer to it. With
+`lock_free_reads` the copy is made without the lock and validated afterwards, in which
+case `item` may have been written to even if the key was not found.
+
+Params:
+    smap: ShardedHashMap struct
+    key: null terminated key
+    item: buffer for the data item, may be NULL to only check that the key exists
+
+Returns:
+    bool: true if the key is found, false otherwise
+*/
+bool hashmap_sharded_get(struct ShardedHashMap *smap, char const *key, void *item);
+
+/*
+Remove data item from a sharded hash map.
+
+Removed data item is copied to `item` (if not NULL), see `hashmap_sharded_get`.
+
+Params:
+    smap: ShardedHashMap struct
+    key: null terminated key
+    item: buffer for the removed data item, may be NULL
+
+Returns:
+    bool: true if the key was found and removed, false otherwise
+*/
+bool hashmap_sharded_remove(struct ShardedHashMap *smap, char const *key, void *item);
+
+/*
+Iterate a sharded hash map and apply a callback to the keys and data items.
+
+Works as `hashmap_iter_apply`, shards are iterated one by one and each of them is locked
+exclusively while its keys are visited. The callback must not call other functions of
+the same sharded hash map.
+
+Params:
+    smap: ShardedHashMap struct
+    callback: a function pointer that is to be applied for data items
+
+Returns:
+    bool: true if the hash map was completely iterated through, false otherwise.
+*/
+bool hashmap_sharded_iter_apply(struct ShardedHashMap *smap, bool (*callback)(char const *, void *));
+
+/*
+Get the current length of a sharded hash map.
+
+Shards are counted one by one, so with concurrent modifications the result is
+only an estimate.
+
+Params:
+    smap: ShardedHashMap struct
+
+Returns:
+    size_t: count of the keys
+*/
+size_t hashmap_sharded_len(struct ShardedHashMap *smap);
+
+/*
+Free the memory allocated for a sharded hash map.
+
+No other thread may use the hash map any longer. See `hashmap_free`.
+
+Params:
+    smap: ShardedHashMap struct
+*/
+void hashmap_sharded_free(struct ShardedHashMap *smap);
+
+struct SharedHashMap;
+
+/*
+Get the size of a shared memory region that holds `elems` data items, see
+`hashmap_shared_create`.
+
+Params:
+    config: HashMapConfig struct, see `hashmap_shared_create`
+    elems: count of data items the hash map must hold
+
+Returns:
+    size_t: size of the region in bytes, 0 if the configuration cannot be shared
+*/
+size_t hashmap_shared_region_bytes(struct HashMapConfig const *config, size_t elems);
+
+/*
+Create a hash map in a shared memory region, which can be used by several processes at once.
+
+The hash map is laid out entirely inside the region given by the caller (e.g. mapped by
+`mmap` from `shm_open` or anonymously before forking) and refers to its slots only by
+offsets, so every process may map the region to an address of its own. Capacity is fixed
+to the largest one fitting the region, insertions fail once the upper load factor is
+reached. Modifications take a process-shared lock, while lookups take no lock and are
+validated by a sequence counter. The lock is robust on Linux, so a process dying while
+holding it does not block the others. Platforms without robust mutexes (e.g. macOS) cannot
+recover the lock from a dead process. Only string keys without `long_keys` are
+supported, and `incremental_resize`, `clean_func` and custom hash functions are not
+available. Data items are stored as raw bytes, so pointers in them are meaningful only
+to the process that inserted them.
+
+Params:
+    region: shared memory, aligned to 64 bytes, see `hashmap_shared_region_bytes`
+    region_bytes: size of the region in bytes
+    config: HashMapConfig struct, see `hashmap_init_ex`
+
+Returns:
+    struct SharedHashMap*: handle of this process to the hash map, NULL if the creation
+        failed.
+*/
+struct SharedHashMap* hashmap_shared_create(
+    void *region,
+    size_t region_bytes,
+    struct HashMapConfig const *config);
+
+/*
+Attach to a hash map created by `hashmap_shared_create` in another process.
+
+Processes forked after the creation may use the handle of their parent as it is.
+
+Params:
+    region: shared memory region of the hash map, as mapped by this process
+    region_bytes: size of the region in bytes
+
+Returns:
+    struct SharedHashMap*: handle of this process to the hash map, NULL if the region
+        holds no hash map of a compatible build.
+*/
+struct SharedHashMap* hashmap_shared_attach(void *region, size_t region_bytes);
+
+/*
+Insert data item to a shared hash map, see `hashmap_sharded_insert`.
+
+Params:
+    shmap: SharedHashMap struct
+    key: null terminated key
+    data: data item to be inserted
+
+Returns:
+    bool: true if insertion succeeded, false otherwise (e.g. the hash map is full)
+*/
+bool hashmap_shared_insert(struct SharedHashMap *shmap, char const *key, void const *data);
+
+/*
+Get a copy of a data item from a shared hash map, see `hashmap_sharded_get` with
+`lock_free_reads`.
+
+Params:
+    shmap: SharedHashMap struct
+    key: null terminated key
+    item: buffer for the data item, may be NULL to only check that the key exists
+
+Returns:
+    bool: true if the key is found, false otherwise
+*/
+bool hashmap_shared_get(struct SharedHashMap *shmap, char const *key, void *item);
+
+/*
+Remove data item from a shared hash map, see `hashmap_sharded_remove`.
+
+Params:
+    shmap: SharedHashMap struct
+    key: null terminated key
+    item: buffer for the removed data item, may be NULL
+
+Returns:
+    bool: true if the key was found and removed, false otherwise
+*/
+bool hashmap_shared_remove(struct SharedHashMap *shmap, char const *key, void *item);
+
+/*
+Get the current length of a shared hash map.
+
+Params:
+    shmap: SharedHashMap struct
+
+Returns:
+    size_t: count of the keys
+*/
+size_t hashmap_shared_len(struct SharedHashMap *shmap);
+
+/*
+Release the handle of this process to a shared hash map.
+
+The hash map stays in the region for the other processes, the region itself is
+unmapped by the caller.
+
+Params:
+    shmap: SharedHashMap struct
+*/
+void hashmap_shared_detach(struct SharedHashMap *shmap);
+
 
 #endif /* __HASHMAP__ */
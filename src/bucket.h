@@ -0,0 +1,89 @@
+#ifndef __BUCKET__
+#define __BUCKET__
+
+#include "common.h"
+#include "map.h"
+
+#define BUCKET_HASH_ORIG_BITS 64
+
+#ifdef HASHMAP_WIDE_HASH
+
+#if SIZE_MAX <= UINT32_MAX
+#error "HASHMAP_WIDE_HASH requires a 64-bit size_t."
+#endif
+
+#define BUCKET_TOTAL_BITS 64
+#define BUCKET_HASH_BITS 48
+#define BUCKET_PSL_BITS 15
+
+#define BUCKET_TAKEN_OFFSET 0x0u
+#define BUCKET_TAKEN_MASK UINT64_C(0x1)
+#define BUCKET_PSL_OFFSET 0x1u
+#define BUCKET_PSL_MASK UINT64_C(0x000000000000FFFE)
+#define BUCKET_HASH_OFFSET 0x10u
+#define BUCKET_HASH_MASK UINT64_C(0xFFFFFFFFFFFF0000)
+
+typedef u64 bucket_meta_type;
+
+#else
+
+#define BUCKET_TOTAL_BITS 32
+#define BUCKET_HASH_BITS 20
+#define BUCKET_PSL_BITS 11
+
+#define BUCKET_TAKEN_OFFSET 0x0u
+#define BUCKET_TAKEN_MASK 0x1u
+#define BUCKET_PSL_OFFSET 0x1u
+#define BUCKET_PSL_MASK 0x00000FFEu
+#define BUCKET_HASH_OFFSET 0xCu
+#define BUCKET_HASH_MASK 0xFFFFF000u
+
+typedef u32 bucket_meta_type;
+
+#endif // HASHMAP_WIDE_HASH
+
+#define BUCKET_HASH_TRUNC_SIZE ((BUCKET_HASH_ORIG_BITS) - (BUCKET_HASH_BITS))
+
+#define BUCKET_IS_TAKEN(meta_data) \
+    (META_VALUE_GET((meta_data), BUCKET_TAKEN_OFFSET, BUCKET_TAKEN_MASK) & 1U)
+
+#define META_GET_HASH(meta_data) \
+    (META_VALUE_GET((meta_data), BUCKET_HASH_OFFSET, BUCKET_HASH_MASK))
+
+#define META_GET_PSL(meta_data) \
+    (META_VALUE_GET((meta_data), BUCKET_PSL_OFFSET, BUCKET_PSL_MASK))
+
+#define META_SET_HASH(meta_data, value) \
+    (META_VALUE_SET((meta_data), (value), BUCKET_HASH_OFFSET, BUCKET_HASH_MASK))
+
+#define META_SET_PSL(meta_data, value) \
+    (META_VALUE_SET((meta_data), (value), BUCKET_PSL_OFFSET, BUCKET_PSL_MASK))
+
+#define META_SET_TAKEN(meta_data, value) \
+    (META_VALUE_SET((meta_data), (value), BUCKET_TAKEN_OFFSET, BUCKET_TAKEN_MASK))
+
+#define META_ADD_ONE_TO_PSL(meta_data) \
+    (META_SET_PSL((meta_data), META_GET_PSL((meta_data)) + 1U))
+
+#define META_SUBTRACT_ONE_FROM_PSL(meta_data) \
+    (META_SET_PSL((meta_data), META_GET_PSL((meta_data)) - 1U))
+
+/*
+`BUCKET_TOTAL_BITS`, which is the total bit count of struct `Bucket`
+must be compatible with the `bucket_meta_type` type (u32 by default, u64
+when compiled with `HASHMAP_WIDE_HASH`).
+
+LSB bit is the "taken" value, 0 if bucket is free and 1 if taken.
+Following `BUCKET_PSL_BITS` bits are reserved for the probe sequence length value.
+Last `BUCKET_HASH_BITS` bits are reserved for the (truncated) hash value.
+
+In the wide mode the truncated hash has enough bits to address every slot up to
+2^`MAP_MAX_EXP_CAPACITY`, so resizing can re-index entries without rehashing keys.
+*/
+struct Bucket {
+    bucket_meta_type meta_data;
+};
+
+static u32 const MAX_PSL = (1U << BUCKET_PSL_BITS) - 1;
+
+#endif // __BUCKET__
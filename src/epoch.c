@@ -0,0 +1,156 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "epoch.h"
+
+// Epoch zero marks a reader slot that is not inside a read section
+static _Atomic u64 global_epoch = 1;
+static struct EpochReader readers[EPOCH_MAX_READERS];
+
+static _Thread_local struct EpochReader *local_reader = NULL;
+static pthread_key_t reader_key;
+static pthread_once_t reader_key_once = PTHREAD_ONCE_INIT;
+
+
+static void _release_reader(void *reader) {
+    struct EpochReader *slot = reader;
+
+    atomic_store_explicit(&slot->active, 0, memory_order_release);
+    atomic_store_explicit(&slot->taken, false, memory_order_release);
+}
+
+static void _create_reader_key(void) {
+    pthread_key_create(&reader_key, _release_reader);
+}
+
+static struct EpochReader* _claim_reader(void) {
+    pthread_once(&reader_key_once, _create_reader_key);
+
+    for (size_t j=0; j<EPOCH_MAX_READERS; ++j) {
+        bool expected = false;
+
+        if (!atomic_load_explicit(&readers[j].taken, memory_order_relaxed) &&
+            atomic_compare_exchange_strong(&readers[j].taken, &expected, true))
+        {
+            if (pthread_setspecific(reader_key, &readers[j]) != 0) {
+                atomic_store(&readers[j].taken, false);
+                return NULL;
+            }
+            return &readers[j];
+        }
+    }
+    return NULL;
+}
+
+bool epoch_enter(void) {
+    if (local_reader == NULL) {
+        local_reader = _claim_reader();
+        if (local_reader == NULL) return false;
+    }
+    // Sequentially consistent store, memory unlinked after this gets retired with a later epoch
+    atomic_store(&local_reader->active, atomic_load(&global_epoch));
+
+    return true;
+}
+
+void epoch_exit(void) {
+    atomic_store_explicit(&local_reader->active, 0, memory_order_release);
+}
+
+u64 epoch_advance(void) {
+    return atomic_fetch_add(&global_epoch, 1);
+}
+
+u64 epoch_min_active(void) {
+    u64 min_epoch = UINT64_MAX;
+
+    for (size_t j=0; j<EPOCH_MAX_READERS; ++j) {
+        u64 const active = atomic_load(&readers[j].active);
+
+        if (active != 0 && active < min_epoch) {
+            min_epoch = active;
+        }
+    }
+    return min_epoch;
+}
+
+bool retire_reserve(struct RetireList *list, size_t count) {
+    if (list->capa - list->len >= count) return true;
+
+    size_t new_capa = list->capa ? list->capa : 8;
+    while (new_capa - list->len < count) {
+        new_capa *= 2;
+    }
+    struct Retired *items = realloc(list->items, new_capa * sizeof(struct Retired));
+    if (items == NULL) return false;
+
+    list->items = items;
+    list->capa = new_capa;
+
+    return true;
+}
+
+void retire_push(struct RetireList *list, void *ptr) {
+    retire_push_with(list, ptr, NULL, NULL, 0);
+}
+
+void retire_push_with(
+    struct RetireList *list,
+    void *ptr,
+    void (*free_func)(void *, void *, size_t),
+    void *ctx,
+    size_t size)
+{
+    // Space must have been reserved, memory cannot be freed here as readers may still use it
+    list->items[list->len++] = (struct Retired){
+        .ptr=ptr, .epoch=EPOCH_PENDING, .free_func=free_func, .ctx=ctx, .size=size
+    };
+    list->pending += 1;
+}
+
+static void _retired_free(struct Retired const *retired) {
+    if (retired->free_func) {
+        retired->free_func(retired->ctx, retired->ptr, retired->size);
+    } else {
+        free(retired->ptr);
+    }
+}
+
+void retire_tag_pending(struct RetireList *list, u64 epoch) {
+    for (size_t j=0; j<list->len; ++j) {
+        if (list->items[j].epoch == EPOCH_PENDING) {
+            list->items[j].epoch = epoch;
+        }
+    }
+    list->pending = 0;
+}
+
+void retire_reclaim(struct RetireList *list) {
+    if (list->len == 0) return;
+
+    // Readers that entered after the retire epoch cannot hold the retired memory
+    u64 const min_epoch = epoch_min_active();
+    size_t kept = 0;
+
+    for (size_t j=0; j<list->len; ++j) {
+        if (list->items[j].epoch < min_epoch) {
+            _retired_free(&list->items[j]);
+        } else {
+            list->items[kept++] = list->items[j];
+        }
+    }
+    list->len = kept;
+}
+
+void retire_free_all(struct RetireList *list) {
+    for (size_t j=0; j<list->len; ++j) {
+        _retired_free(&list->items[j]);
+    }
+    free(list->items);
+    list->items = NULL;
+    list->len = 0;
+    list->capa = 0;
+    list->pending = 0;
+}
@@ -0,0 +1,73 @@
+#ifndef __EPOCH__
+#define __EPOCH__
+
+#include <stdatomic.h>
+
+#include "common.h"
+
+#define EPOCH_MAX_READERS 256
+#define EPOCH_CACHE_LINE_BYTES 64
+
+/*
+Epoch based reclamation of memory read without locks.
+
+A reader announces the global epoch it started in, and memory unlinked by a writer is
+retired with the epoch of the unlink. Retired memory is freed once every reader active
+at the moment of the unlink has finished. Readers write only their own cache line.
+
+Reader slots are shared by the whole process and claimed per thread on the first
+`epoch_enter`, a slot is released when its thread exits. If all `EPOCH_MAX_READERS`
+slots are taken, `epoch_enter` fails and the caller must fall back to locking.
+*/
+struct EpochReader {
+    _Alignas(EPOCH_CACHE_LINE_BYTES) _Atomic u64 active;
+    atomic_bool taken;
+};
+
+/*
+Memory waiting to be freed.
+
+ptr: address to be freed.
+epoch: epoch of the unlink, `EPOCH_PENDING` until the memory is unlinked from all readers.
+free_func: if not NULL, called with `ctx`, `ptr` and `size` to free the memory instead of `free`.
+*/
+struct Retired {
+    void *ptr;
+    u64 epoch;
+    void (*free_func)(void *ctx, void *ptr, size_t size);
+    void *ctx;
+    size_t size;
+};
+
+#define EPOCH_PENDING UINT64_MAX
+
+/*
+List of retired memory. Not thread-safe, owner of the list must serialize its use.
+
+pending: count of the items still waiting for their retire epoch.
+*/
+struct RetireList {
+    struct Retired *items;
+    size_t len;
+    size_t capa;
+    size_t pending;
+};
+
+bool epoch_enter(void);
+void epoch_exit(void);
+u64 epoch_advance(void);
+u64 epoch_min_active(void);
+
+bool retire_reserve(struct RetireList *list, size_t count);
+void retire_push(struct RetireList *list, void *ptr);
+void retire_push_with(
+    struct RetireList *list,
+    void *ptr,
+    void (*free_func)(void *, void *, size_t),
+    void *ctx,
+    size_t size);
+void retire_tag_pending(struct RetireList *list, u64 epoch);
+void retire_reclaim(struct RetireList *list);
+void retire_free_all(struct RetireList *list);
+
+#endif // __EPOCH__
@@ -1,31 +1,33 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "common.h"
 #include "map.h"
+#include "sharded.h"
+#include "shared.h"
+#include "snapshot.h"
+#include "stats.h"
 
 struct HashMap* hashmap_init(size_t item_size, void (*clean_func)(void *)) {
     return hmap_init(item_size, MAP_INIT_EXP_CAPACITY, clean_func);
 }
 
-static u32 _get_init_capa(size_t elems) {
-    u32 exp = MAP_INIT_EXP_CAPACITY;
-
-    do {
-        if (elems <= (1U << exp)) break;
-        exp += 1;
-    } while (exp <= MAP_MAX_EXP_CAPACITY);
-
-    return exp;
-}
-
 struct HashMap* hashmap_init_with_size(
     size_t item_size,
     size_t elems,
     void (*clean_func)(void *))
 {
-    u32 init_capa = _get_init_capa(elems);
+    struct HashMapConfig const config = {.item_size=item_size};
+    u32 init_capa = hmap_init_capa_for(&config, elems);
 
     return hmap_init(item_size, init_capa, clean_func);
 }
 
+struct HashMap* hashmap_init_ex(struct HashMapConfig const *config) {
+    u32 init_capa = hmap_init_capa_for(config, config->init_elems);
+
+    return hmap_init_ex(config, init_capa);
+}
+
 bool hashmap_insert(
     struct HashMap *hashmap,
     char const *key,
@@ -42,6 +44,75 @@ void* hashmap_remove(struct HashMap *hashmap, char const *key) {
     return hmap_remove(hashmap, key);
 }
 
+bool hashmap_remove_into(struct HashMap *hashmap, char const *key, void *item) {
+    return hmap_remove_into(hashmap, key, item);
+}
+
+bool hashmap_insert_n(
+    struct HashMap *hashmap,
+    void const *key,
+    size_t len,
+    void const *data)
+{
+    return hmap_insert_n(hashmap, key, len, data);
+}
+
+void* hashmap_get_n(struct HashMap *hashmap, void const *key, size_t len) {
+    return hmap_get_n(hashmap, key, len);
+}
+
+void* hashmap_remove_n(struct HashMap *hashmap, void const *key, size_t len) {
+    return hmap_remove_n(hashmap, key, len);
+}
+
+bool hashmap_insert_u64(struct HashMap *hashmap, uint64_t key, void const *data) {
+    return hmap_insert_u64(hashmap, key, data);
+}
+
+void* hashmap_get_u64(struct HashMap *hashmap, uint64_t key) {
+    return hmap_get_u64(hashmap, key);
+}
+
+void* hashmap_remove_u64(struct HashMap *hashmap, uint64_t key) {
+    return hmap_remove_u64(hashmap, key);
+}
+
+size_t hashmap_get_batch(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    size_t count,
+    void *items[])
+{
+    return hmap_get_batch(hashmap, keys, count, items);
+}
+
+size_t hashmap_insert_batch(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    size_t count,
+    void const *const data[])
+{
+    return hmap_insert_batch(hashmap, keys, count, data);
+}
+
+size_t hashmap_remove_batch(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    size_t count,
+    void *items)
+{
+    return hmap_remove_batch(hashmap, keys, count, items);
+}
+
+size_t hashmap_build(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    void const *items,
+    size_t count)
+{
+    return hmap_build(hashmap, keys, items, count);
+}
+
 void hashmap_free(struct HashMap *hashmap) {
     hmap_free(hashmap);
 }
@@ -53,10 +124,37 @@ bool hashmap_iter_apply(
     return hmap_iter_apply(hashmap, callback);
 }
 
+bool hashmap_iter_apply_u64(
+    struct HashMap *hashmap,
+    bool (*callback)(uint64_t, void *))
+{
+    return hmap_iter_apply_u64(hashmap, callback);
+}
+
 uint32_t hashmap_len(struct HashMap *hashmap) {
     return hmap_len(hashmap);
 }
 
+bool hashmap_reserve(struct HashMap *hashmap, size_t elems) {
+    return hmap_reserve(hashmap, elems);
+}
+
+bool hashmap_shrink_to_fit(struct HashMap *hashmap) {
+    return hmap_shrink_to_fit(hashmap);
+}
+
+bool hashmap_save(struct HashMap *hashmap, char const *path) {
+    return snapshot_save(hashmap, path);
+}
+
+struct HashMap* hashmap_load(char const *path) {
+    return snapshot_load(path);
+}
+
+struct HashMap* hashmap_open_mmap(char const *path) {
+    return snapshot_open_mapped(path);
+}
+
 void hashmap_stats_traverse(struct HashMap *hashmap) {
     traverse_hashmap_slots(hashmap);
 }
@@ -64,3 +162,91 @@ void hashmap_stats_traverse(struct HashMap *hashmap) {
 void hashmap_stats_summary(struct HashMap *hashmap) {
     hmap_show_stats(hashmap);
 }
+
+bool hashmap_get_stats(struct HashMap *hashmap, struct HashMapStats *stats) {
+    return hmap_get_stats(hashmap, stats);
+}
+
+void hashmap_get_layout_stats(struct HashMap *hashmap, struct HashMapLayoutStats *stats) {
+    hmap_get_layout_stats(hashmap, stats);
+}
+
+bool hashmap_stats_dump(struct HashMap *hashmap, FILE *stream) {
+    return stats_dump(hashmap, stream);
+}
+
+size_t hashmap_stats_dump_buffer(struct HashMap *hashmap, char *buffer, size_t size) {
+    return stats_dump_buffer(hashmap, buffer, size);
+}
+
+struct ShardedHashMap* hashmap_sharded_init(struct HashMapConfig const *config, size_t shard_count) {
+    // Divided among the shards actually created, not the requested count
+    size_t const shards = smap_shard_count(shard_count);
+    size_t const shard_elems = (config->init_elems + shards - 1) / shards;
+    u32 init_capa = hmap_init_capa_for(config, shard_elems);
+
+    return smap_init(config, shard_count, init_capa);
+}
+
+bool hashmap_sharded_insert(struct ShardedHashMap *smap, char const *key, void const *data) {
+    return smap_insert(smap, key, data);
+}
+
+bool hashmap_sharded_get(struct ShardedHashMap *smap, char const *key, void *item) {
+    return smap_get(smap, key, item);
+}
+
+bool hashmap_sharded_remove(struct ShardedHashMap *smap, char const *key, void *item) {
+    return smap_remove(smap, key, item);
+}
+
+bool hashmap_sharded_iter_apply(
+    struct ShardedHashMap *smap,
+    bool (*callback)(char const *, void *))
+{
+    return smap_iter_apply(smap, callback);
+}
+
+size_t hashmap_sharded_len(struct ShardedHashMap *smap) {
+    return smap_len(smap);
+}
+
+void hashmap_sharded_free(struct ShardedHashMap *smap) {
+    smap_free(smap);
+}
+
+size_t hashmap_shared_region_bytes(struct HashMapConfig const *config, size_t elems) {
+    return shmap_region_bytes(config, elems);
+}
+
+struct SharedHashMap* hashmap_shared_create(
+    void *region,
+    size_t region_bytes,
+    struct HashMapConfig const *config)
+{
+    return shmap_create(region, region_bytes, config);
+}
+
+struct SharedHashMap* hashmap_shared_attach(void *region, size_t region_bytes) {
+    return shmap_attach(region, region_bytes);
+}
+
+bool hashmap_shared_insert(struct SharedHashMap *shmap, char const *key, void const *data) {
+    return shmap_insert(shmap, key, data);
+}
+
+bool hashmap_shared_get(struct SharedHashMap *shmap, char const *key, void *item) {
+    return shmap_get(shmap, key, item);
+}
+
+bool hashmap_shared_remove(struct SharedHashMap *shmap, char const *key, void *item) {
+    return shmap_remove(shmap, key, item);
+}
+
+size_t hashmap_shared_len(struct SharedHashMap *shmap) {
+    return shmap_len(shmap);
+}
+
+void hashmap_shared_detach(struct SharedHashMap *shmap) {
+    shmap_detach(shmap);
+}
@@ -1,71 +1,65 @@
+#define _DEFAULT_SOURCE
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include <time.h>
 
 #ifdef __linux__
 #include <sys/random.h>
+#include <sys/mman.h>
 #elif __APPLE__
 #include <sys/random.h>
+#include <sys/mman.h>
 #endif
 
 #include "map.h"
+#include "bucket.h"
+#include "wyhash.h"
 
 #define MAP_LOAD_FACTOR_LOWER 0.4
 #define MAP_LOAD_FACTOR_UPPER 0.9
 #define MAP_MAX_KEY_BYTES 20
-#define MAP_TEMP_SLOTS 2
-
-#define BUCKET_HASH_ORIG_BITS 64
-#define BUCKET_TOTAL_BITS 32
-#define BUCKET_HASH_BITS 20
-#define BUCKET_PSL_BITS 11
-#define BUCKET_HASH_TRUNC_SIZE ((BUCKET_HASH_ORIG_BITS) - (BUCKET_HASH_BITS))
-
-#define BUCKET_TAKEN_OFFSET 0x0u
-#define BUCKET_TAKEN_MASK 0x1u
-#define BUCKET_PSL_OFFSET 0x1u
-#define BUCKET_PSL_MASK 0x00000FFEu
-#define BUCKET_HASH_OFFSET 0xCu
-#define BUCKET_HASH_MASK 0xFFFFF000u
-
-#define BUCKET_IS_TAKEN(meta_data) \
-    (META_VALUE_GET((meta_data), BUCKET_TAKEN_OFFSET, BUCKET_TAKEN_MASK) & 1U)
-
-#define META_GET_HASH(meta_data) \
-    (META_VALUE_GET((meta_data), BUCKET_HASH_OFFSET, BUCKET_HASH_MASK))
-
-#define META_GET_PSL(meta_data) \
-    (META_VALUE_GET((meta_data), BUCKET_PSL_OFFSET, BUCKET_PSL_MASK))
-
-#define META_SET_HASH(meta_data, value) \
-    (META_VALUE_SET((meta_data), (value), BUCKET_HASH_OFFSET, BUCKET_HASH_MASK))
-
-#define META_SET_PSL(meta_data, value) \
-    (META_VALUE_SET((meta_data), (value), BUCKET_PSL_OFFSET, BUCKET_PSL_MASK))
-
-#define META_SET_TAKEN(meta_data, value) \
-    (META_VALUE_SET((meta_data), (value), BUCKET_TAKEN_OFFSET, BUCKET_TAKEN_MASK))
-
-#define META_ADD_ONE_TO_PSL(meta_data) \
-    (META_SET_PSL((meta_data), META_GET_PSL((meta_data)) + 1U))
+#define MAP_TEMP_SLOTS 3
+#define MAP_MIGRATE_STEPS 32
+#define MAP_ARENA_INIT_BYTES 256
+#define MAP_ARENA_COMPACT_MIN_BYTES 4096
+#define MAP_BATCH_KEYS 16
+#define MAP_STACK_SLOT_BYTES 256
+#define MAP_HUGE_PAGE_BYTES ((size_t)2 << 20)
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+#define MAP_USE_HUGE_PAGES
+#endif
 
-#define META_SUBTRACT_ONE_FROM_PSL(meta_data) \
-    (META_SET_PSL((meta_data), META_GET_PSL((meta_data)) - 1U))
+#if defined(__linux__) || defined(__APPLE__)
+#define MAP_USE_FILE_MAPPING
+#endif
 
 /*
-`BUCKET_TOTAL_BITS`, which is the total bit count of struct `Bucket`
-must be compatible with the u32 type.
-
-LSB bit is the "taken" value, 0 if bucket is free and 1 if taken.
-Following `BUCKET_PSL_BITS` bits are reserved for the probe sequence length value.
-Last `BUCKET_HASH_BITS` bits are reserved for the (truncated) hash value.
+Key field layout. The last byte of the first `MAP_MAX_KEY_BYTES` bytes holds the key length
+for inline keys. With long keys enabled, keys longer than `MAP_INLINE_KEY_BYTES` are stored
+to the key arena and the field holds the arena offset (u64), the key length (u32) and the
+first `MAP_KEY_PREFIX_BYTES` bytes of the key, with `MAP_KEY_OUT_OF_LINE` as the length byte.
 */
-struct Bucket {
-    u32 meta_data;
-};
-
-static u32 const MAX_PSL = (1U << BUCKET_PSL_BITS) - 1;
+#define MAP_INLINE_KEY_BYTES ((MAP_MAX_KEY_BYTES) - 1)
+#define MAP_KEY_LEN_IDX MAP_INLINE_KEY_BYTES
+#define MAP_KEY_OUT_OF_LINE 0xFFu
+#define MAP_KEY_REF_LEN_IDX 8
+#define MAP_KEY_PREFIX_IDX 12
+#define MAP_KEY_PREFIX_BYTES ((MAP_KEY_LEN_IDX) - (MAP_KEY_PREFIX_IDX))
+#define MAP_MAX_LONG_KEY_BYTES (UINT32_MAX - 1)
+
+// Operation counters compile to nothing without `HASHMAP_STATS`
+#ifdef HASHMAP_STATS
+#define MAP_STATS_ADD(hashmap, counter, count) \
+    ((void)atomic_fetch_add_explicit(&(hashmap)->stats.counter, (count), memory_order_relaxed))
+#define MAP_STATS_GET(hashmap, counter) \
+    atomic_load_explicit(&(hashmap)->stats.counter, memory_order_relaxed)
+#else
+#define MAP_STATS_ADD(hashmap, counter, count) ((void)0)
+#endif
 
 
 static bool _init_random_key(u8 *buf, size_t buflen) {
@@ -116,65 +110,556 @@ static bool _init_random_key(u8 *buf, size_t buflen) {
     return init_success;
 }
 
-static u32 get_truncated_hash(char const *key, u8 const randkey[HASH_RAND_KEY_LEN]) {
-    u64 hash = siphash(key, strlen(key), randkey);
+/*
+Finalizer of MurmurHash3 applied to the key mixed with a part of the random key.
+*/
+static inline u64 _mix_u64(u64 key, u8 const randkey[HASH_RAND_KEY_LEN]) {
+    u64 seed;
+    memcpy(&seed, randkey, sizeof seed);
+
+    key ^= seed;
+    key ^= key >> 33;
+    key *= UINT64_C(0xff51afd7ed558ccd);
+    key ^= key >> 33;
+    key *= UINT64_C(0xc4ceb9fe1a85ec53);
+    key ^= key >> 33;
+
+    return key;
+}
+
+static inline bucket_meta_type _truncate_hash(u64 hash) {
     return hash << BUCKET_HASH_TRUNC_SIZE >> BUCKET_HASH_TRUNC_SIZE;
 }
 
-static void _update_bucket_meta(struct Bucket *bucket, u32 psl, u32 hash) {
+static inline u64 _hash_key(struct HashMap const *hashmap, char const *key, size_t len) {
+    if (hashmap->hash_func) {
+        return hashmap->hash_func(key, len, hashmap->rand_key);
+    }
+    // Integer keys with the default hash, mixer is cheap enough to be inlined
+    u64 int_key;
+    memcpy(&int_key, key, sizeof int_key);
+
+    return _mix_u64(int_key, hashmap->rand_key);
+}
+
+static bucket_meta_type get_truncated_hash(
+    struct HashMap const *hashmap,
+    char const *key,
+    size_t len)
+{
+    return _truncate_hash(_hash_key(hashmap, key, len));
+}
+
+static void _update_bucket_meta(struct Bucket *bucket, u32 psl, bucket_meta_type hash) {
     bucket->meta_data = META_SET_TAKEN(bucket->meta_data, 1U);
     bucket->meta_data = META_SET_PSL(bucket->meta_data, psl);
     bucket->meta_data = META_SET_HASH(bucket->meta_data, hash);
 }
 
-static bool _keys_are_equal(char const *left, char const *right) {
-    return strncmp(left, right, MAP_MAX_KEY_BYTES) == 0;
+static inline bool _key_is_out_of_line(char const *field) {
+    return (u8)field[MAP_KEY_LEN_IDX] == MAP_KEY_OUT_OF_LINE;
+}
+
+static void _get_key_ref(char const *field, u64 *offset, u32 *len) {
+    memcpy(offset, field, sizeof *offset);
+    memcpy(len, field + MAP_KEY_REF_LEN_IDX, sizeof *len);
+}
+
+static void _set_key_ref(char *field, u64 offset, u32 len) {
+    memcpy(field, &offset, sizeof offset);
+    memcpy(field + MAP_KEY_REF_LEN_IDX, &len, sizeof len);
+}
+
+static bool _key_len_is_valid(struct HashMap const *hashmap, size_t len) {
+    if (hashmap->key_type != HASHMAP_KEY_STRING) {
+        return false;
+    }
+    return len <= MAP_INLINE_KEY_BYTES || (hashmap->long_keys && len <= MAP_MAX_LONG_KEY_BYTES);
+}
+
+/*
+Whether an out of line key of `len` bytes at `offset` lies within the key arena. Slots of
+a mapped snapshot are not checksummed, so their references are checked before the arena
+is read. References of other hash maps were written by the hash map itself.
+*/
+static bool _key_ref_is_valid(struct HashMap const *hashmap, u64 offset, u32 len) {
+    return hashmap->mapping == NULL || (offset < hashmap->arena.len &&
+        len < hashmap->arena.len - offset && hashmap->arena.data[offset + len] == '\0');
+}
+
+/*
+Compare `key` of length `len` to the key stored in `field`. Lengths are compared first,
+out of line keys compare also the inline prefix before touching the arena.
+*/
+static bool _key_matches(
+    struct HashMap const *hashmap,
+    char const *field,
+    char const *key,
+    size_t len)
+{
+    if (hashmap->key_type == HASHMAP_KEY_U64) {
+        return memcmp(field, key, sizeof(u64)) == 0;
+    }
+    // Without long keys the field is never out of line, even if read while being written
+    if (!hashmap->long_keys || !_key_is_out_of_line(field)) {
+        return (u8)field[MAP_KEY_LEN_IDX] == len && memcmp(field, key, len) == 0;
+    }
+    u64 offset;
+    u32 stored_len;
+    _get_key_ref(field, &offset, &stored_len);
+
+    return stored_len == len &&
+        memcmp(field + MAP_KEY_PREFIX_IDX, key, MAP_KEY_PREFIX_BYTES) == 0 &&
+        _key_ref_is_valid(hashmap, offset, stored_len) &&
+        memcmp(hashmap->arena.data + offset, key, len) == 0;
+}
+
+/*
+Memory of the hash map comes from the allocator of the config, or the C library if none was given.
+*/
+static void* _mem_alloc(struct HashMapAllocator const *allocator, size_t size) {
+    return allocator->alloc_func ? allocator->alloc_func(allocator->ctx, size) : malloc(size);
+}
+
+static void* _mem_calloc(struct HashMapAllocator const *allocator, size_t count, size_t size) {
+    if (allocator->alloc_func == NULL) {
+        return calloc(count, size);
+    }
+    if (size != 0 && count > SIZE_MAX / size) return NULL;
+
+    void *ptr = allocator->alloc_func(allocator->ctx, count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+static void* _mem_realloc(
+    struct HashMapAllocator const *allocator,
+    void *ptr,
+    size_t old_size,
+    size_t new_size)
+{
+    if (allocator->alloc_func == NULL) {
+        return realloc(ptr, new_size);
+    }
+    if (allocator->realloc_func) {
+        return allocator->realloc_func(allocator->ctx, ptr, old_size, new_size);
+    }
+    void *new_ptr = allocator->alloc_func(allocator->ctx, new_size);
+    if (new_ptr && ptr) {
+        memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+        allocator->free_func(allocator->ctx, ptr, old_size);
+    }
+    return new_ptr;
+}
+
+static void _mem_free(struct HashMapAllocator const *allocator, void *ptr, size_t size) {
+    if (ptr == NULL) return;
+
+    if (allocator->alloc_func) {
+        allocator->free_func(allocator->ctx, ptr, size);
+    } else {
+        free(ptr);
+    }
+}
+
+/*
+Make room for `needed` more bytes in the key arena.
+*/
+static bool _arena_reserve(
+    struct HashMapAllocator const *allocator,
+    struct KeyArena *arena,
+    size_t needed)
+{
+    if (arena->capa - arena->len < needed) {
+        size_t new_capa = arena->capa ? arena->capa : MAP_ARENA_INIT_BYTES;
+
+        while (new_capa - arena->len < needed) {
+            if (new_capa > SIZE_MAX / 2) return false;
+            new_capa *= 2;
+        }
+        char *data = _mem_realloc(allocator, arena->data, arena->capa, new_capa);
+        if (data == NULL) return false;
+
+        arena->data = data;
+        arena->capa = new_capa;
+    }
+    return true;
+}
+
+static bool _arena_push(
+    struct HashMapAllocator const *allocator,
+    struct KeyArena *arena,
+    char const *key,
+    size_t len,
+    u64 *offset)
+{
+    // Keys are null terminated in the arena, iteration hands them out as strings
+    size_t const needed = len + 1;
+
+    if (!_arena_reserve(allocator, arena, needed)) return false;
+
+    memcpy(arena->data + arena->len, key, len);
+    arena->data[arena->len + len] = '\0';
+
+    *offset = arena->len;
+    arena->len += needed;
+
+    return true;
+}
+
+/*
+Store key to the key field `field`, either inline or to the key arena.
+*/
+static bool _store_key(struct HashMap *hashmap, char *field, char const *key, size_t len) {
+    memset(field, 0, hashmap->sz_key);
+
+    if (hashmap->key_type == HASHMAP_KEY_U64) {
+        memcpy(field, key, sizeof(u64));
+        return true;
+    }
+    if (len <= MAP_INLINE_KEY_BYTES) {
+        memcpy(field, key, len);
+        field[MAP_KEY_LEN_IDX] = (char)len;
+        return true;
+    }
+    u64 offset;
+    if (!_arena_push(&hashmap->allocator, &hashmap->arena, key, len, &offset)) {
+        fprintf(stderr, "Cannot allocate memory for the key arena.\n");
+        return false;
+    }
+    _set_key_ref(field, offset, (u32)len);
+    memcpy(field + MAP_KEY_PREFIX_IDX, key, MAP_KEY_PREFIX_BYTES);
+    field[MAP_KEY_LEN_IDX] = (char)MAP_KEY_OUT_OF_LINE;
+
+    return true;
+}
+
+/*
+Mark arena storage of the key in `field` unused. Reclaimed later by arena compaction.
+*/
+static void _release_key(struct HashMap *hashmap, char const *field) {
+    if (hashmap->long_keys && _key_is_out_of_line(field)) {
+        u64 offset;
+        u32 len;
+        _get_key_ref(field, &offset, &len);
+        hashmap->arena.dead += (size_t)len + 1;
+    }
+}
+
+/*
+Key in `field` as a null terminated string, `buffer` is used for inline keys. Invalid
+references of a mapped snapshot give an empty key.
+*/
+static char const* _key_str(
+    struct HashMap const *hashmap,
+    char const *field,
+    char buffer[MAP_MAX_KEY_BYTES])
+{
+    if (hashmap->long_keys && _key_is_out_of_line(field)) {
+        u64 offset;
+        u32 len;
+        _get_key_ref(field, &offset, &len);
+        if (_key_ref_is_valid(hashmap, offset, len)) {
+            return hashmap->arena.data + offset;
+        }
+        buffer[0] = '\0';
+        return buffer;
+    }
+    memcpy(buffer, field, MAP_INLINE_KEY_BYTES);
+    buffer[MAP_INLINE_KEY_BYTES] = '\0';
+    return buffer;
+}
+
+/*
+View to the slots of one table.
+
+Meta data, key and data item of slot i are located at `metas + i * meta_stride`,
+`keys + i * key_stride` and `items + i * item_stride`. With the interleaved layout
+every stride equals the slot size, whereas with the split layout meta data, keys and
+data items are stored in separate dense arrays (in this order) of the same allocation.
+*/
+struct Table {
+    u8 *metas;
+    u8 *keys;
+    u8 *items;
+    size_t meta_stride;
+    size_t key_stride;
+    size_t item_stride;
+    size_t mask;
+};
+
+/*
+Alignment of the data items for `packing`, natural alignment being the largest power of
+two dividing the item size, at most that of a pointer.
+*/
+static u32 _item_alignment(enum HashMapPacking packing, u32 item_size) {
+    if (packing == HASHMAP_PACKING_PACKED) return 1;
+    if (packing == HASHMAP_PACKING_ALIGNED) return _Alignof(max_align_t);
+    if (item_size == 0) return 1;
+
+    u32 const align = item_size & (~item_size + 1);
+    return align < sizeof(void *) ? align : sizeof(void *);
+}
+
+static inline u32 _align_up(u32 size, u32 align) {
+    return (size + align - 1) & ~(align - 1);
+}
+
+static inline size_t _item_stride(struct HashMap const *hashmap) {
+    return _align_up(hashmap->sz_item, hashmap->item_align);
+}
+
+static struct Table _table(struct HashMap const *hashmap, void *slots, u32 ex_capa) {
+    size_t const capacity = MAP_CAPACITY(ex_capa);
+    struct Table table = {.metas=slots, .mask=capacity - 1};
+
+    if (hashmap->layout == HASHMAP_LAYOUT_SPLIT) {
+        table.keys = table.metas + capacity * hashmap->sz_bucket;
+        table.items = table.keys + capacity * hashmap->sz_key;
+        table.meta_stride = hashmap->sz_bucket;
+        table.key_stride = hashmap->sz_key;
+        table.item_stride = _item_stride(hashmap);
+    } else {
+        table.keys = table.metas + hashmap->sz_bucket;
+        table.items = table.keys + hashmap->sz_key;
+        table.meta_stride = hashmap->sz_slot;
+        table.key_stride = hashmap->sz_slot;
+        table.item_stride = hashmap->sz_slot;
+    }
+    return table;
+}
+
+/*
+View to a single slot at `slot`, stored with the interleaved layout.
+*/
+static struct Table _slot_table(struct HashMap const *hashmap, u8 *slot) {
+    struct Table const table = {
+        .metas=slot,
+        .keys=slot + hashmap->sz_bucket,
+        .items=slot + hashmap->sz_bucket + hashmap->sz_key,
+        .meta_stride=hashmap->sz_slot,
+        .key_stride=hashmap->sz_slot,
+        .item_stride=hashmap->sz_slot,
+        .mask=0
+    };
+    return table;
+}
+
+/*
+View to one of the `MAP_TEMP_SLOTS` temporary slots.
+*/
+static struct Table _temp_table(struct HashMap const *hashmap, u32 temp_idx) {
+    return _slot_table(hashmap, (u8 *)hashmap->_temp + hashmap->sz_slot * temp_idx);
+}
+
+/*
+Storage for the two slots in flight while placing a slot, one being placed and the other
+receiving a displaced slot. Slots of at most `MAP_STACK_SLOT_BYTES` bytes are kept on the
+stack of the operation, larger slots use the temporary slots 1 and 2 of the hash map.
+*/
+struct InFlight {
+    _Alignas(max_align_t) u8 slots[2][MAP_STACK_SLOT_BYTES];
+};
+
+static void _in_flight_tables(
+    struct HashMap const *hashmap,
+    struct InFlight *in_flight,
+    struct Table *entry,
+    struct Table *spare)
+{
+    if (hashmap->sz_slot <= MAP_STACK_SLOT_BYTES) {
+        *entry = _slot_table(hashmap, in_flight->slots[0]);
+        *spare = _slot_table(hashmap, in_flight->slots[1]);
+    } else {
+        *entry = _temp_table(hashmap, 1);
+        *spare = _temp_table(hashmap, 2);
+    }
+}
+
+static inline struct Bucket* _bucket_at(struct Table const *table, size_t idx) {
+    return (struct Bucket *)(table->metas + table->meta_stride * idx);
+}
+
+static inline char* _key_at(struct Table const *table, size_t idx) {
+    return (char *)(table->keys + table->key_stride * idx);
+}
+
+static inline void* _item_at(struct Table const *table, size_t idx) {
+    return table->items + table->item_stride * idx;
+}
+
+static void _copy_slot(
+    struct HashMap const *hashmap,
+    struct Table const *dst,
+    size_t dst_idx,
+    struct Table const *src,
+    size_t src_idx)
+{
+    if (hashmap->layout == HASHMAP_LAYOUT_INTERLEAVED) {
+        memcpy(_bucket_at(dst, dst_idx), _bucket_at(src, src_idx), hashmap->sz_slot);
+        return;
+    }
+    memcpy(_bucket_at(dst, dst_idx), _bucket_at(src, src_idx), hashmap->sz_bucket);
+    memcpy(_key_at(dst, dst_idx), _key_at(src, src_idx), hashmap->sz_key);
+    memcpy(_item_at(dst, dst_idx), _item_at(src, src_idx), hashmap->sz_item);
 }
 
 static void _hmap_init_set_size_members(struct HashMap *hashmap, u32 item_size, u32 ex_capa) {
+    u32 const key_bytes = hashmap->key_type == HASHMAP_KEY_U64 ? sizeof(u64) : MAP_MAX_KEY_BYTES;
+    u32 const item_align = _item_alignment(hashmap->packing, item_size);
+    u32 const slot_align = item_align > _Alignof(struct Bucket) ? item_align : _Alignof(struct Bucket);
+
     hashmap->sz_bucket = sizeof(struct Bucket);
-    hashmap->sz_key = MAP_MAX_KEY_BYTES;
+    // Key field is padded if needed so that data items start at their alignment
+    hashmap->sz_key = _align_up(hashmap->sz_bucket + key_bytes, item_align) - hashmap->sz_bucket;
     hashmap->sz_item = item_size;
-
-    u32 slot_size = hashmap->sz_bucket + hashmap->sz_key + hashmap->sz_item;
-    slot_size += (slot_size % sizeof(void *));
-    hashmap->sz_slot = slot_size;
+    hashmap->item_align = item_align;
+    // Slots are padded so that the next meta data unit and data item stay aligned
+    hashmap->sz_slot = _align_up(hashmap->sz_bucket + hashmap->sz_key + item_size, slot_align);
 
     hashmap->ex_capa = ex_capa;
 }
 
-static struct HashMap* _hmap_init_common(u32 item_size, u32 ex_capa) {
-    struct HashMap *hashmap = calloc(1, sizeof *hashmap);
+static size_t _slot_bytes(struct HashMap const *hashmap) {
+    // Split layout needs no padding but for the data items: for capacities of at least
+    // 2^`MAP_INIT_EXP_CAPACITY` slots the key and data item arrays start at `max_align_t`
+    return hashmap->layout == HASHMAP_LAYOUT_SPLIT ?
+        (size_t)hashmap->sz_bucket + hashmap->sz_key + _item_stride(hashmap) :
+        hashmap->sz_slot;
+}
+
+/*
+Slots are mapped to huge pages if requested and the table covers at least one huge page.
+*/
+static bool _slots_on_huge_pages(struct HashMap const *hashmap, u32 ex_capa) {
+#ifdef MAP_USE_HUGE_PAGES
+    size_t const slot_bytes = _slot_bytes(hashmap);
+
+    return hashmap->huge_pages && MAP_CAPACITY(ex_capa) <= SIZE_MAX / slot_bytes &&
+        MAP_CAPACITY(ex_capa) * slot_bytes >= MAP_HUGE_PAGE_BYTES;
+#else
+    (void)hashmap;
+    (void)ex_capa;
+    return false;
+#endif
+}
+
+#ifdef MAP_USE_HUGE_PAGES
+static size_t _huge_mapping_bytes(size_t bytes) {
+    return (bytes + MAP_HUGE_PAGE_BYTES - 1) & ~(MAP_HUGE_PAGE_BYTES - 1);
+}
+
+static void* _map_huge_slots(size_t bytes) {
+    size_t const len = _huge_mapping_bytes(bytes);
+
+    // One extra huge page, so that the mapping can be trimmed to start at a huge page boundary
+    u8 *raw = mmap(
+        NULL, len + MAP_HUGE_PAGE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    if (raw == MAP_FAILED) return NULL;
+
+    size_t const head = (MAP_HUGE_PAGE_BYTES - (uintptr_t)raw % MAP_HUGE_PAGE_BYTES) %
+        MAP_HUGE_PAGE_BYTES;
+    if (head > 0) {
+        munmap(raw, head);
+    }
+    if (head < MAP_HUGE_PAGE_BYTES) {
+        munmap(raw + head + len, MAP_HUGE_PAGE_BYTES - head);
+    }
+    // Only advice, without transparent huge pages the slots stay on regular pages
+    madvise(raw + head, len, MADV_HUGEPAGE);
+
+    return raw + head;
+}
+#endif
+
+static void* _alloc_slots(struct HashMap const *hashmap, u32 ex_capa) {
+#ifdef MAP_USE_HUGE_PAGES
+    if (_slots_on_huge_pages(hashmap, ex_capa)) {
+        // Anonymous mappings are zero filled
+        return _map_huge_slots(MAP_CAPACITY(ex_capa) * _slot_bytes(hashmap));
+    }
+#endif
+    return _mem_calloc(&hashmap->allocator, MAP_CAPACITY(ex_capa), _slot_bytes(hashmap));
+}
+
+static void _free_slots(struct HashMap const *hashmap, void *slots, u32 ex_capa) {
+    size_t const bytes = MAP_CAPACITY(ex_capa) * _slot_bytes(hashmap);
+
+#ifdef MAP_USE_HUGE_PAGES
+    if (_slots_on_huge_pages(hashmap, ex_capa)) {
+        munmap(slots, _huge_mapping_bytes(bytes));
+        return;
+    }
+#endif
+    _mem_free(&hashmap->allocator, slots, bytes);
+}
+
+static struct HashMap* _hmap_init_common(struct HashMapConfig const *config, u32 ex_capa) {
+    struct HashMapAllocator const *allocator = &config->allocator;
+    struct HashMap *hashmap = _mem_calloc(allocator, 1, sizeof *hashmap);
 
     if (hashmap == NULL) {
         return NULL;
     }
 
-    _hmap_init_set_size_members(hashmap, item_size, ex_capa);
-    size_t const init_slot_count = 1U << hashmap->ex_capa;
+    hashmap->allocator = *allocator;
+    hashmap->huge_pages = config->huge_pages;
+    hashmap->max_load = config->max_load_factor ? config->max_load_factor : MAP_LOAD_FACTOR_UPPER;
+    hashmap->min_load = config->min_load_factor;
+    if (hashmap->min_load == 0) {
+        // Unset lower load factor keeps the default ratio to the upper one
+        hashmap->min_load = config->max_load_factor ?
+            hashmap->max_load * (MAP_LOAD_FACTOR_LOWER / MAP_LOAD_FACTOR_UPPER) : MAP_LOAD_FACTOR_LOWER;
+    }
+    hashmap->shrink = config->shrink;
+    hashmap->layout = config->layout;
+    hashmap->key_type = config->key_type;
+    hashmap->packing = config->packing;
+    _hmap_init_set_size_members(hashmap, config->item_size, ex_capa);
 
-    hashmap->slots = calloc(init_slot_count, hashmap->sz_slot);
+    hashmap->slots = _alloc_slots(hashmap, hashmap->ex_capa);
 
     if (hashmap->slots == NULL) {
-        free(hashmap);
+        _mem_free(allocator, hashmap, sizeof *hashmap);
         return NULL;
     }
 
-    hashmap->_temp = calloc(MAP_TEMP_SLOTS, hashmap->sz_slot);
+    hashmap->_temp = _mem_calloc(allocator, MAP_TEMP_SLOTS, hashmap->sz_slot);
 
     if (hashmap->_temp == NULL) {
-        free(hashmap->slots);
-        free(hashmap);
+        _free_slots(hashmap, hashmap->slots, hashmap->ex_capa);
+        _mem_free(allocator, hashmap, sizeof *hashmap);
         return NULL;
     }
 
     return hashmap;
 }
 
+static hash_func_type _select_hash_func(struct HashMapConfig const *config) {
+    switch (config->hash) {
+    case HASHMAP_HASH_SIPHASH13:
+        return siphash13;
+    case HASHMAP_HASH_WYHASH:
+        return wyhash;
+    case HASHMAP_HASH_CUSTOM:
+        return config->hash_func;
+    case HASHMAP_HASH_DEFAULT:
+        if (config->key_type == HASHMAP_KEY_U64 && !config->dos_resistant) {
+            return NULL;
+        }
+        return siphash;
+    case HASHMAP_HASH_SIPHASH24:
+    default:
+        return siphash;
+    }
+}
+
 static struct HashMap* _hmap_init(
-    u32 item_size,
+    struct HashMapConfig const *config,
     u32 init_capa,
-    void (*clean_func)(void *),
     bool use_random_key)
 {
     u8 rand_key[HASH_RAND_KEY_LEN] = {0};
@@ -184,275 +669,680 @@ static struct HashMap* _hmap_init(
         return NULL;
     }
 
-    struct HashMap *hashmap = _hmap_init_common(item_size, init_capa);
+    struct HashMap *hashmap = _hmap_init_common(config, init_capa);
     if (hashmap == NULL) return NULL;
 
     hashmap->occ_slots = 0;
-    hashmap->clean_func = clean_func;
+    hashmap->clean_func = config->clean_func;
+    hashmap->incremental = config->incremental_resize;
+    hashmap->long_keys = config->long_keys;
+    hashmap->hash_func = _select_hash_func(config);
+    probe_select(PROBE_IMPL_AUTO, &hashmap->probe);
 
     memcpy(hashmap->rand_key, rand_key, sizeof(rand_key));
 
     return hashmap;
 }
 
-static struct HashMap* _hmap_init_resized(u32 item_size, u32 ex_capa) {
-    return _hmap_init_common(item_size, ex_capa);
-}
-
-static void _clean_hashmap_slots(struct HashMap *hashmap) {
+static void _clean_table_slots(struct HashMap *hashmap, void *slots, u32 ex_capa) {
     clean_func_type clean_data_func = hashmap->clean_func ? hashmap->clean_func : NULL;
 
     if (clean_data_func) {
-        u32 const total_capacity = 1U << hashmap->ex_capa;
-
-        for (u32 j=0; j<total_capacity; ++j) {
-            struct Bucket *bucket = (struct Bucket *)
-                ((char *)hashmap->slots + hashmap->sz_slot * j);
+        struct Table const table = _table(hashmap, slots, ex_capa);
 
-            if(BUCKET_IS_TAKEN(bucket->meta_data)) {
-                clean_data_func((char *)bucket + hashmap->sz_bucket + hashmap->sz_key);
+        for (size_t j=0; j<=table.mask; ++j) {
+            if(BUCKET_IS_TAKEN(_bucket_at(&table, j)->meta_data)) {
+                clean_data_func(_item_at(&table, j));
             }
         }
     }
 
-    free(hashmap->slots);
+    _free_slots(hashmap, slots, ex_capa);
 }
 
-static void _hmap_free(struct HashMap *hashmap) {
-    _clean_hashmap_slots(hashmap);
-    free(hashmap->_temp);
-    free(hashmap);
+/*
+Free slots that are no longer used by the hash map. With a retire function set, lock-free
+readers may still be reading them and freeing is left to that function.
+*/
+static void _hmap_release_slots(struct HashMap *hashmap, void *slots, u32 ex_capa) {
+    if (hashmap->retire_func) {
+        hashmap->retire_func(hashmap->retire_ctx, slots, ex_capa);
+    } else {
+        _free_slots(hashmap, slots, ex_capa);
+    }
 }
 
-static bool _hmap_resize(struct HashMap *hashmap, u32 new_ex_capa) {
-    struct HashMap *new_hashmap = _hmap_init_resized(hashmap->sz_item, new_ex_capa);
-    if (new_hashmap == NULL) {
-        return false;
+static void _hmap_free(struct HashMap *hashmap) {
+    // Copy of the allocator, it is freed along with the struct
+    struct HashMapAllocator const allocator = hashmap->allocator;
+
+    if (hashmap->mapping) {
+        // Slots and key arena belong to the file mapping
+#ifdef MAP_USE_FILE_MAPPING
+        munmap(hashmap->mapping, hashmap->mapping_bytes);
+#endif
+    } else if (hashmap->fixed_slots) {
+        // Slots belong to the caller, only the key arena is ours
+        _mem_free(&allocator, hashmap->arena.data, hashmap->arena.capa);
+    } else {
+        _clean_table_slots(hashmap, hashmap->slots, hashmap->ex_capa);
+        if (hashmap->old_slots) {
+            _clean_table_slots(hashmap, hashmap->old_slots, hashmap->old_ex_capa);
+        }
+        _mem_free(&allocator, hashmap->arena.data, hashmap->arena.capa);
     }
+    _mem_free(&allocator, hashmap->_temp, (size_t)MAP_TEMP_SLOTS * hashmap->sz_slot);
+    _mem_free(&allocator, hashmap, sizeof *hashmap);
+}
 
-    u32 const current_capacity = 1U << hashmap->ex_capa;
-    u32 const new_mask = (1U << new_hashmap->ex_capa) - 1;
+void hmap_free_slots(struct HashMap const *hashmap, void *slots, u32 ex_capa) {
+    _free_slots(hashmap, slots, ex_capa);
+}
 
-    for (u32 j=0; j<current_capacity; ++j) {
-        struct Bucket *bucket = (struct Bucket *)
-            ((char *)hashmap->slots + hashmap->sz_slot * j);
+size_t hmap_slots_bytes(struct HashMap const *hashmap, u32 ex_capa) {
+    return MAP_CAPACITY(ex_capa) * _slot_bytes(hashmap);
+}
 
-        if (!BUCKET_IS_TAKEN(bucket->meta_data)) continue;
+bool hmap_reserve_key_arena(struct HashMap *hashmap, size_t bytes) {
+    return _arena_reserve(&hashmap->allocator, &hashmap->arena, bytes);
+}
 
-        u32 idx = META_GET_HASH(bucket->meta_data) & new_mask;
-        bucket->meta_data = META_SET_PSL(bucket->meta_data, 0U);
+void hmap_attach_slots(struct HashMap *hashmap, void *slots, u32 ex_capa) {
+    _free_slots(hashmap, hashmap->slots, hashmap->ex_capa);
 
-        while (true) {
-            struct Bucket *new_bucket = (struct Bucket *)
-                ((char *)new_hashmap->slots + new_hashmap->sz_slot * idx);
+    hashmap->slots = slots;
+    hashmap->ex_capa = ex_capa;
+    hashmap->fixed_slots = true;
+}
 
-            if (!BUCKET_IS_TAKEN(new_bucket->meta_data)) {
-                memcpy(new_bucket, bucket, hashmap->sz_slot);
-                break;
-            }
-            if (META_GET_PSL(bucket->meta_data) > META_GET_PSL(new_bucket->meta_data)) {
-                // Occupied slot but the key in this slot is "richer", so make a swap
-                memcpy(
-                    (char *)new_hashmap->_temp + new_hashmap->sz_slot,
-                    new_bucket,
-                    new_hashmap->sz_slot
-                );
-                memcpy(new_bucket, bucket, hashmap->sz_slot);
-                memcpy(
-                    bucket,
-                    (char *)new_hashmap->_temp + new_hashmap->sz_slot,
-                    new_hashmap->sz_slot
-                );
-            }
-            if (META_GET_PSL(bucket->meta_data) >= MAX_PSL) {
-                // Maximal probe sequence length reached, unable to resize
-                free(new_hashmap->slots);
-                free(new_hashmap->_temp);
-                free(new_hashmap);
-                return false;
-            }
-            bucket->meta_data = META_ADD_ONE_TO_PSL(bucket->meta_data);
-            idx = (idx + 1) & new_mask;
-        }
+void hmap_attach_mapping(
+    struct HashMap *hashmap,
+    void *mapping,
+    size_t mapping_bytes,
+    void *slots,
+    u32 ex_capa,
+    char *arena,
+    size_t arena_bytes)
+{
+    hmap_attach_slots(hashmap, slots, ex_capa);
+    _mem_free(&hashmap->allocator, hashmap->arena.data, hashmap->arena.capa);
+
+    hashmap->mapping = mapping;
+    hashmap->mapping_bytes = mapping_bytes;
+    // Zero capacity, the arena is never grown or freed
+    hashmap->arena = (struct KeyArena){.data=arena, .len=arena_bytes};
+}
+
+/*
+Returns true (and prints an error) if the hash map cannot be modified, i.e. its slots are
+mapped read-only from a file.
+*/
+static bool _rejects_mutation(struct HashMap const *hashmap) {
+    if (hashmap->mapping) {
+        fprintf(stderr, "Cannot modify a hash map mapped from a file.\n");
+        return true;
     }
-    // Clean memory from old hashmap but do not follow possible pointers as
-    // new_hashmap->slots points then also to those same locations.
-    // There is no need to touch hashmap->_temp and also hmap_remove needs that memory.
-    free(hashmap->slots);
-    hashmap->slots = new_hashmap->slots;
-    hashmap->ex_capa = new_hashmap->ex_capa;
+    return false;
+}
+
+static inline u64 _stats_now_ns() {
+#ifdef HASHMAP_STATS
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000u + (u64)ts.tv_nsec;
+#else
+    return 0;
+#endif
+}
 
-    free(new_hashmap->_temp);
-    free(new_hashmap);
+static inline void _stats_resize_time(struct HashMap *hashmap, u64 start_ns) {
+    MAP_STATS_ADD(hashmap, resize_ns, _stats_now_ns() - start_ns);
+    (void)hashmap;
+    (void)start_ns;
+}
 
-    return true;
+/*
+Count a resize to capacity exponent `new_ex_capa`, started at `start_ns`. Must be called
+before `ex_capa` is updated.
+*/
+static inline void _stats_resized(struct HashMap *hashmap, u32 new_ex_capa, u64 start_ns) {
+    MAP_STATS_ADD(hashmap, resizes_up, new_ex_capa > hashmap->ex_capa);
+    MAP_STATS_ADD(hashmap, resizes_down, new_ex_capa < hashmap->ex_capa);
+    _stats_resize_time(hashmap, start_ns);
+    (void)new_ex_capa;
 }
 
-static void* _hmap_get(struct HashMap *hashmap, char const *key) {
-    u32 const hash_trunc = get_truncated_hash(key, hashmap->rand_key);
-    u32 const mask = (1U << hashmap->ex_capa) - 1;
-    u32 idx = hash_trunc & mask, psl = 0;
+/*
+Place the slot of `entry` to `table` starting from index `idx`, PSL of `entry` must match
+this index. Key of the slot must not be in the table already. When a richer slot gets
+displaced, it is copied to `spare` and the views `entry` and `spare` trade places, so
+`entry` always refers to the slot in flight.
+
+Returns false if the maximal probe sequence length is reached, in which case `entry`
+holds the slot that could not be placed.
+*/
+static bool _place_slot_at(
+    struct HashMap *hashmap,
+    struct Table const *table,
+    size_t idx,
+    struct Table *entry,
+    struct Table *spare)
+{
+    struct Bucket *entry_bucket = _bucket_at(entry, 0);
 
     while (true) {
-        struct Bucket *bucket = (struct Bucket *)
-            ((char *)hashmap->slots + hashmap->sz_slot * idx);
+        struct Bucket *bucket = _bucket_at(table, idx);
 
-        if (!BUCKET_IS_TAKEN(bucket->meta_data) || META_GET_PSL(bucket->meta_data) < psl) {
-            return NULL;
+        if (!BUCKET_IS_TAKEN(bucket->meta_data)) {
+            _copy_slot(hashmap, table, idx, entry, 0);
+            return true;
         }
-        if (META_GET_HASH(bucket->meta_data) == hash_trunc &&
-            _keys_are_equal(key, (char *)bucket + hashmap->sz_bucket))
-        {
-            return (char *)bucket + hashmap->sz_bucket + hashmap->sz_key;
+        if (META_GET_PSL(entry_bucket->meta_data) > META_GET_PSL(bucket->meta_data)) {
+            // Occupied slot but the key in this slot is "richer", displaced slot goes in flight
+            _copy_slot(hashmap, spare, 0, table, idx);
+            _copy_slot(hashmap, table, idx, entry, 0);
+            MAP_STATS_ADD(hashmap, displacements, 1);
+
+            struct Table const placed = *entry;
+            *entry = *spare;
+            *spare = placed;
+            entry_bucket = _bucket_at(entry, 0);
         }
-        psl++;
-        idx = (idx + 1) & mask;
+        if (META_GET_PSL(entry_bucket->meta_data) >= MAX_PSL) {
+            return false;
+        }
+        entry_bucket->meta_data = META_ADD_ONE_TO_PSL(entry_bucket->meta_data);
+        idx = (idx + 1) & table->mask;
     }
 }
 
-static bool _hmap_insert(struct HashMap *hashmap, char const *key, void const *data) {
-    u32 hash_trunc = get_truncated_hash(key, hashmap->rand_key);
-    u32 const mask = (1U << hashmap->ex_capa) - 1;
-    u32 idx = hash_trunc & mask, psl = 0;
+static bool _place_slot(
+    struct HashMap *hashmap,
+    struct Table const *table,
+    struct Table *entry,
+    struct Table *spare)
+{
+    struct Bucket *entry_bucket = _bucket_at(entry, 0);
+    entry_bucket->meta_data = META_SET_PSL(entry_bucket->meta_data, 0U);
 
-    char key_buffer[MAP_MAX_KEY_BYTES] = {0};
-    strncpy(key_buffer, key, MAP_MAX_KEY_BYTES - 1);
-    memcpy((char *)hashmap->_temp + hashmap->sz_bucket, key_buffer, hashmap->sz_key);
+    size_t const idx = META_GET_HASH(entry_bucket->meta_data) & table->mask;
+    return _place_slot_at(hashmap, table, idx, entry, spare);
+}
 
-    memcpy(
-        (char *)hashmap->_temp + hashmap->sz_bucket + hashmap->sz_key,
-        data,
-        hashmap->sz_item
-    );
+static bool _table_find(
+    struct HashMap *hashmap,
+    struct Table const *table,
+    char const *key,
+    size_t len,
+    bucket_meta_type hash_trunc,
+    size_t *found_idx)
+{
+    u32 const width = hashmap->probe.width;
+    size_t idx = hash_trunc & table->mask;
+    u32 psl = 0;
 
     while (true) {
-        struct Bucket *bucket = (struct Bucket *)
-            ((char *)hashmap->slots + hashmap->sz_slot * idx);
+        // Scan meta data of a group of buckets at once, keys are compared only for hash matches
+        struct ProbeResult const group = hashmap->probe.scan(
+            table->metas, table->meta_stride, idx, table->mask, psl, hash_trunc
+        );
+        u32 matches = group.match_mask;
 
-        if (!BUCKET_IS_TAKEN(bucket->meta_data)) {
-            _update_bucket_meta(bucket, psl, hash_trunc);
-            memcpy(
-                (char *)bucket + hashmap->sz_bucket,
-                (char *)hashmap->_temp + hashmap->sz_bucket,
-                hashmap->sz_key + hashmap->sz_item
-            );
-            hashmap->occ_slots += 1;
-            return true;
+        while (matches) {
+            size_t const match_idx = (idx + (u32)__builtin_ctz(matches)) & table->mask;
+
+            if (_key_matches(hashmap, _key_at(table, match_idx), key, len)) {
+                *found_idx = match_idx;
+                return true;
+            }
+            matches &= matches - 1;
         }
-        if (META_GET_HASH(bucket->meta_data) == hash_trunc &&
-            _keys_are_equal(
-                (char *)hashmap->_temp + hashmap->sz_bucket,
-                (char *)bucket + hashmap->sz_bucket
-            ))
-        {
-            // Keys have the same hash, replace data
-            bucket->meta_data = META_SET_PSL(bucket->meta_data, psl);
-            memcpy(
-                (char *)bucket + hashmap->sz_bucket + hashmap->sz_key,
-                (char *)hashmap->_temp + hashmap->sz_bucket + hashmap->sz_key,
-                hashmap->sz_item
-            );
-            return true;
+        if (group.stop < width) {
+            return false;
         }
-        if (psl > META_GET_PSL(bucket->meta_data)) {
-            // Occupied slot but the key in this slot is "richer", so make a swap
-            memcpy((char *)hashmap->_temp + hashmap->sz_slot, (char *)bucket, hashmap->sz_slot);
+        psl += width;
+        idx = (idx + width) & table->mask;
+    }
+}
 
-            _update_bucket_meta(bucket, psl, hash_trunc);
-            memcpy(
-                (char *)bucket + hashmap->sz_bucket,
-                (char *)hashmap->_temp + hashmap->sz_bucket,
-                hashmap->sz_key + hashmap->sz_item
-            );
-            memcpy(
-                hashmap->_temp,
-                (char *)hashmap->_temp + hashmap->sz_slot,
-                hashmap->sz_slot
-            );
+static void _table_remove_at(struct HashMap *hashmap, struct Table const *table, size_t idx) {
+    size_t prev_idx = idx;
 
-            hash_trunc = META_GET_HASH(((struct Bucket *)(hashmap->_temp))->meta_data);
-            psl = META_GET_PSL(((struct Bucket *)(hashmap->_temp))->meta_data);
+    // Start backward shifting
+    while (true) {
+        idx = (idx + 1) & table->mask;
+        struct Bucket *bucket = _bucket_at(table, idx);
+
+        if (!BUCKET_IS_TAKEN(bucket->meta_data) || META_GET_PSL(bucket->meta_data) == 0) {
+            // Nothing to shift anymore
+            struct Bucket *prev_bucket = _bucket_at(table, prev_idx);
+            prev_bucket->meta_data = META_SET_TAKEN(prev_bucket->meta_data, 0U);
+            break;
         }
-        if (psl >= MAX_PSL) {
+        _copy_slot(hashmap, table, prev_idx, table, idx);
+        struct Bucket *prev_bucket = _bucket_at(table, prev_idx);
+        prev_bucket->meta_data = META_SUBTRACT_ONE_FROM_PSL(prev_bucket->meta_data);
+        MAP_STATS_ADD(hashmap, backward_shifts, 1);
+        prev_idx = idx;
+    }
+}
+
+static bool _hmap_resize(struct HashMap *hashmap, u32 new_ex_capa) {
+    u64 const start_ns = _stats_now_ns();
+    void *new_slots = _alloc_slots(hashmap, new_ex_capa);
+    if (new_slots == NULL) {
+        return false;
+    }
+
+    struct Table const table = _table(hashmap, hashmap->slots, hashmap->ex_capa);
+    struct Table const new_table = _table(hashmap, new_slots, new_ex_capa);
+    struct InFlight in_flight;
+    struct Table entry, spare;
+    _in_flight_tables(hashmap, &in_flight, &entry, &spare);
+
+    for (size_t j=0; j<=table.mask; ++j) {
+        if (!BUCKET_IS_TAKEN(_bucket_at(&table, j)->meta_data)) continue;
+
+        _copy_slot(hashmap, &entry, 0, &table, j);
+
+        if (!_place_slot(hashmap, &new_table, &entry, &spare)) {
+            // Maximal probe sequence length reached, unable to resize
+            _free_slots(hashmap, new_slots, new_ex_capa);
+            return false;
+        }
+    }
+    // Clean memory from old slots but do not follow possible pointers as
+    // new_slots points then also to those same locations.
+    _hmap_release_slots(hashmap, hashmap->slots, hashmap->ex_capa);
+    _stats_resized(hashmap, new_ex_capa, start_ns);
+    hashmap->slots = new_slots;
+    hashmap->ex_capa = new_ex_capa;
+
+    return true;
+}
+
+/*
+Move at most `steps` buckets from the old table to the current one.
+
+Buckets are visited in index order. A migrated slot is deleted from the old
+table by backward shifting so that the old table remains a valid Robin Hood
+table and every key lives in exactly one of the two tables.
+*/
+static void _hmap_migrate(struct HashMap *hashmap, size_t steps) {
+    if (hashmap->old_slots == NULL) return;
+
+    u64 const start_ns = _stats_now_ns();
+    struct Table const table = _table(hashmap, hashmap->slots, hashmap->ex_capa);
+    struct Table const old_table = _table(hashmap, hashmap->old_slots, hashmap->old_ex_capa);
+    struct InFlight in_flight;
+    struct Table entry, spare;
+    _in_flight_tables(hashmap, &in_flight, &entry, &spare);
+
+    while (hashmap->old_occ_slots > 0 && steps > 0) {
+        steps -= 1;
+
+        if (!BUCKET_IS_TAKEN(_bucket_at(&old_table, hashmap->migrate_idx)->meta_data)) {
+            hashmap->migrate_idx = (hashmap->migrate_idx + 1) & old_table.mask;
+            continue;
+        }
+        _copy_slot(hashmap, &entry, 0, &old_table, hashmap->migrate_idx);
+        bool const placed = _place_slot(hashmap, &table, &entry, &spare);
+
+        _table_remove_at(hashmap, &old_table, hashmap->migrate_idx);
+
+        if (!placed) {
+            // Keep the slot that could not be placed in the old table, it has room for it
+            _place_slot(hashmap, &old_table, &entry, &spare);
             fprintf(
                 stderr,
-                "Max probe sequence length %u reached, cannot insert key %s.\n",
-                MAX_PSL,
-                key
+                "Max probe sequence length %u reached, cannot migrate slots.\n",
+                MAX_PSL
             );
-            return false;
+            break;
+        }
+        hashmap->old_occ_slots -= 1;
+    }
+    _stats_resize_time(hashmap, start_ns);
+
+    if (hashmap->old_occ_slots == 0) {
+        _hmap_release_slots(hashmap, hashmap->old_slots, hashmap->old_ex_capa);
+        hashmap->old_slots = NULL;
+        hashmap->old_ex_capa = 0;
+        hashmap->migrate_idx = 0;
+    }
+}
+
+static bool _hmap_resize_incremental(struct HashMap *hashmap, u32 new_ex_capa) {
+    if (hashmap->old_slots) {
+        // Previous migration must be completed before starting a new one
+        _hmap_migrate(hashmap, SIZE_MAX);
+        if (hashmap->old_slots) return false;
+    }
+
+    u64 const start_ns = _stats_now_ns();
+    void *new_slots = _alloc_slots(hashmap, new_ex_capa);
+    if (new_slots == NULL) {
+        return false;
+    }
+
+    hashmap->old_slots = hashmap->slots;
+    hashmap->old_ex_capa = hashmap->ex_capa;
+    hashmap->old_occ_slots = hashmap->occ_slots;
+    hashmap->migrate_idx = 0;
+
+    // Migration steps count their own time
+    _stats_resized(hashmap, new_ex_capa, start_ns);
+    hashmap->slots = new_slots;
+    hashmap->ex_capa = new_ex_capa;
+
+    _hmap_migrate(hashmap, MAP_MIGRATE_STEPS);
+
+    return true;
+}
+
+static bool _hmap_resize_to(struct HashMap *hashmap, u32 new_ex_capa) {
+    // Slots of the caller cannot be replaced
+    if (hashmap->fixed_slots) return false;
+
+    return hashmap->incremental ? _hmap_resize_incremental(hashmap, new_ex_capa) :
+        _hmap_resize(hashmap, new_ex_capa);
+}
+
+void hmap_view(struct HashMap const *hashmap, struct MapView *view) {
+    view->slots = hashmap->slots;
+    view->ex_capa = hashmap->ex_capa;
+    view->old_slots = hashmap->old_slots;
+    view->old_ex_capa = hashmap->old_ex_capa;
+}
+
+static void* _view_get(
+    struct HashMap *hashmap,
+    struct MapView const *view,
+    char const *key,
+    size_t len,
+    bucket_meta_type hash_trunc)
+{
+    struct Table const table = _table(hashmap, view->slots, view->ex_capa);
+    size_t idx;
+
+    if (_table_find(hashmap, &table, key, len, hash_trunc, &idx)) {
+        return _item_at(&table, idx);
+    }
+    if (view->old_slots) {
+        struct Table const old_table = _table(hashmap, view->old_slots, view->old_ex_capa);
+
+        if (_table_find(hashmap, &old_table, key, len, hash_trunc, &idx)) {
+            return _item_at(&old_table, idx);
         }
-        psl++;
-        idx = (idx + 1) & mask;
     }
+    return NULL;
 }
 
-static void* _hmap_remove(struct HashMap *hashmap, char const *key) {
-    u32 const hash_trunc = get_truncated_hash(key, hashmap->rand_key);
-    u32 const mask = (1U << hashmap->ex_capa) - 1;
-    u32 idx = hash_trunc & mask, psl = 0;
+static void* _hmap_get(
+    struct HashMap *hashmap,
+    char const *key,
+    size_t len,
+    bucket_meta_type hash_trunc)
+{
+    struct MapView view;
+    hmap_view(hashmap, &view);
 
-    struct Bucket *prev_bucket;
+    return _view_get(hashmap, &view, key, len, hash_trunc);
+}
 
+/*
+Lookup counted in the operation counters. Lookups that may run concurrently with each other
+(`hmap_get_hashed` and `hmap_get_view`) use `_hmap_get` directly.
+*/
+static void* _hmap_get_counted(
+    struct HashMap *hashmap,
+    char const *key,
+    size_t len,
+    bucket_meta_type hash_trunc)
+{
+    void *item = _hmap_get(hashmap, key, len, hash_trunc);
+
+    MAP_STATS_ADD(hashmap, get_hits, item != NULL);
+    MAP_STATS_ADD(hashmap, get_misses, item == NULL);
+
+    return item;
+}
+
+static bool _hmap_insert(
+    struct HashMap *hashmap,
+    char const *key,
+    size_t len,
+    bucket_meta_type hash_trunc,
+    void const *data)
+{
+    struct Table const table = _table(hashmap, hashmap->slots, hashmap->ex_capa);
+    size_t idx;
+
+    if (hashmap->old_slots) {
+        struct Table const old_table = _table(hashmap, hashmap->old_slots, hashmap->old_ex_capa);
+
+        if (_table_find(hashmap, &old_table, key, len, hash_trunc, &idx)) {
+            // Key not yet migrated, replace data in the old table
+            memcpy(_item_at(&old_table, idx), data, hashmap->sz_item);
+            MAP_STATS_ADD(hashmap, updates, 1);
+            return true;
+        }
+    }
+    idx = hash_trunc & table.mask;
+    u32 psl = 0;
+
+    // Find either the key or the slot where the key would be placed
     while (true) {
-        struct Bucket *bucket = (struct Bucket *)
-            ((char *)hashmap->slots + hashmap->sz_slot * idx);
+        struct Bucket *bucket = _bucket_at(&table, idx);
 
-        if (!BUCKET_IS_TAKEN(bucket->meta_data) || META_GET_PSL(bucket->meta_data) < psl) {
-            // Targeted key not in the hash map, nothing to remove
-            return NULL;
+        if (!BUCKET_IS_TAKEN(bucket->meta_data)) {
+            break;
         }
         if (META_GET_HASH(bucket->meta_data) == hash_trunc &&
-            _keys_are_equal(key, (char *)bucket + hashmap->sz_bucket))
+            _key_matches(hashmap, _key_at(&table, idx), key, len))
         {
-            // Target key found, copy slot contents to temp location
-            memcpy(hashmap->_temp, bucket, hashmap->sz_slot);
-            prev_bucket = bucket;
+            // Keys have the same hash, replace data
+            memcpy(_item_at(&table, idx), data, hashmap->sz_item);
+            MAP_STATS_ADD(hashmap, updates, 1);
+            return true;
+        }
+        if (psl > META_GET_PSL(bucket->meta_data)) {
+            // Occupied slot but the key in this slot is "richer", new key goes here
             break;
         }
+        if (psl >= MAX_PSL) {
+            fprintf(
+                stderr,
+                "Max probe sequence length %u reached, cannot insert key of %zu bytes.\n",
+                MAX_PSL,
+                len
+            );
+            return false;
+        }
         psl++;
-        idx = (idx + 1) & mask;
+        idx = (idx + 1) & table.mask;
     }
-    hashmap->occ_slots -= 1;
+    // New key, the key is stored only now as it might go to the key arena
+    struct InFlight in_flight;
+    struct Table entry, spare;
+    _in_flight_tables(hashmap, &in_flight, &entry, &spare);
 
-    // Start backward shifting
-    while (true) {
-        idx = (idx + 1) & mask;
-        struct Bucket *bucket = (struct Bucket *)
-            ((char *)hashmap->slots + hashmap->sz_slot * idx);
+    if (!_store_key(hashmap, _key_at(&entry, 0), key, len)) {
+        return false;
+    }
+    struct Bucket *entry_bucket = _bucket_at(&entry, 0);
+    entry_bucket->meta_data = 0;
+    _update_bucket_meta(entry_bucket, psl, hash_trunc);
+    memcpy(_item_at(&entry, 0), data, hashmap->sz_item);
+
+    if (!_place_slot_at(hashmap, &table, idx, &entry, &spare)) {
+        // Slot left in entry gets dropped
+        _release_key(hashmap, _key_at(&entry, 0));
+        fprintf(
+            stderr,
+            "Max probe sequence length %u reached, cannot insert key of %zu bytes.\n",
+            MAX_PSL,
+            len
+        );
+        return false;
+    }
+    hashmap->occ_slots += 1;
+    MAP_STATS_ADD(hashmap, inserts, 1);
 
-        if (!BUCKET_IS_TAKEN(bucket->meta_data) || META_GET_PSL(bucket->meta_data) == 0) {
-            // Nothing to shift anymore
-            prev_bucket->meta_data = META_SET_TAKEN(prev_bucket->meta_data, 0U);
-            break;
+    return true;
+}
+
+static void _table_compact_keys(
+    struct HashMap *hashmap,
+    void *slots,
+    u32 ex_capa,
+    char *data,
+    size_t *len)
+{
+    struct Table const table = _table(hashmap, slots, ex_capa);
+
+    for (size_t j=0; j<=table.mask; ++j) {
+        char *field = _key_at(&table, j);
+
+        if (BUCKET_IS_TAKEN(_bucket_at(&table, j)->meta_data) && _key_is_out_of_line(field)) {
+            u64 offset;
+            u32 key_len;
+            _get_key_ref(field, &offset, &key_len);
+
+            memcpy(data + *len, hashmap->arena.data + offset, (size_t)key_len + 1);
+            _set_key_ref(field, *len, key_len);
+            *len += (size_t)key_len + 1;
         }
-        memcpy(prev_bucket, bucket, hashmap->sz_slot);
-        prev_bucket->meta_data = META_SUBTRACT_ONE_FROM_PSL(prev_bucket->meta_data);
-        prev_bucket = bucket;
     }
+}
+
+/*
+Move keys still in use to a new key arena once most of the arena is unused.
+*/
+static void _hmap_compact_key_arena(struct HashMap *hashmap) {
+    struct KeyArena *arena = &hashmap->arena;
+
+    if (arena->dead < MAP_ARENA_COMPACT_MIN_BYTES || arena->dead <= arena->len / 2) {
+        return;
+    }
+    size_t const live = arena->len - arena->dead;
+    size_t const capa = live > MAP_ARENA_INIT_BYTES ? live : MAP_ARENA_INIT_BYTES;
+
+    char *data = _mem_alloc(&hashmap->allocator, capa);
+    if (data == NULL) return;
+
+    size_t len = 0;
+    _table_compact_keys(hashmap, hashmap->slots, hashmap->ex_capa, data, &len);
+    if (hashmap->old_slots) {
+        _table_compact_keys(hashmap, hashmap->old_slots, hashmap->old_ex_capa, data, &len);
+    }
+    _mem_free(&hashmap->allocator, arena->data, arena->capa);
+    arena->data = data;
+    arena->len = len;
+    arena->capa = capa;
+    arena->dead = 0;
+}
+
+/*
+Smallest capacity exponent, down from the current one, at which the load would still be at
+most `max_load`.
+
+With `max_load` twice the lower load factor this shrinks as far as the lower load factor
+allows (eager shrinking). With half of the upper load factor, the load after a resize in
+either direction is about half of the upper load factor, and a quarter of the capacity worth
+of insertions or removals separates consecutive resizes (hysteresis).
+*/
+static u32 _shrunk_ex_capa(struct HashMap const *hashmap, f64 max_load) {
+    u32 new_ex_capa = hashmap->ex_capa;
 
-    if (hashmap->ex_capa > MAP_INIT_EXP_CAPACITY &&
-        hashmap->occ_slots <= (1U << hashmap->ex_capa) * MAP_LOAD_FACTOR_LOWER)
+    while (
+        new_ex_capa > MAP_INIT_EXP_CAPACITY &&
+        hashmap->occ_slots <= MAP_CAPACITY(new_ex_capa - 1) * max_load)
     {
-        // Hash map too sparse, resize down as much as possible
-        u32 new_ex_capa = hashmap->ex_capa - 1;
-        while (
-            new_ex_capa > MAP_INIT_EXP_CAPACITY &&
-            hashmap->occ_slots <= (1U << new_ex_capa) * MAP_LOAD_FACTOR_LOWER)
-        {
-            new_ex_capa -= 1;
+        new_ex_capa -= 1;
+    }
+    return new_ex_capa;
+}
+
+/*
+Remove the key and copy its data item to `item` unless it is NULL.
+
+Returns false if the key is not in the hash map.
+*/
+static bool _hmap_remove(
+    struct HashMap *hashmap,
+    char const *key,
+    size_t len,
+    bucket_meta_type hash_trunc,
+    void *item)
+{
+    if (_rejects_mutation(hashmap)) return false;
+
+    struct Table const table = _table(hashmap, hashmap->slots, hashmap->ex_capa);
+    size_t idx;
+
+    if (_table_find(hashmap, &table, key, len, hash_trunc, &idx)) {
+        // Target key found, data item is copied out before backward shifting overwrites it
+        if (item) memcpy(item, _item_at(&table, idx), hashmap->sz_item);
+        _release_key(hashmap, _key_at(&table, idx));
+        _table_remove_at(hashmap, &table, idx);
+    } else if (hashmap->old_slots) {
+        struct Table const old_table = _table(hashmap, hashmap->old_slots, hashmap->old_ex_capa);
+
+        if (!_table_find(hashmap, &old_table, key, len, hash_trunc, &idx)) {
+            return false;
         }
-        _hmap_resize(hashmap, new_ex_capa);
+        if (item) memcpy(item, _item_at(&old_table, idx), hashmap->sz_item);
+        _release_key(hashmap, _key_at(&old_table, idx));
+        _table_remove_at(hashmap, &old_table, idx);
+        hashmap->old_occ_slots -= 1;
+        // Releases the old table if this was its last slot
+        _hmap_migrate(hashmap, 0);
+    } else {
+        // Targeted key not in the hash map, nothing to remove
+        return false;
     }
+    hashmap->occ_slots -= 1;
+    MAP_STATS_ADD(hashmap, removes, 1);
 
-    return (char *)hashmap->_temp + hashmap->sz_bucket + hashmap->sz_key;
+    if (hashmap->shrink != HASHMAP_SHRINK_NEVER &&
+        hashmap->occ_slots <= MAP_CAPACITY(hashmap->ex_capa) * hashmap->min_load)
+    {
+        // Hash map too sparse
+        u32 const new_ex_capa = _shrunk_ex_capa(hashmap, hashmap->shrink == HASHMAP_SHRINK_EAGER ?
+            2 * hashmap->min_load : hashmap->max_load / 2);
+
+        if (new_ex_capa < hashmap->ex_capa) {
+            _hmap_resize_to(hashmap, new_ex_capa);
+        }
+    }
+    if (hashmap->long_keys) {
+        _hmap_compact_key_arena(hashmap);
+    }
+
+    return true;
+}
+
+static bool _item_size_is_valid(size_t item_size) {
+    // Leaves room for the meta data, key field and padding of any packing
+    size_t const sz_meta_chunk = sizeof(struct Bucket) + MAP_MAX_KEY_BYTES + 2 * _Alignof(max_align_t);
+
+    return item_size < UINT32_MAX - sz_meta_chunk;
+}
+
+static bool _load_factors_are_valid(struct HashMapConfig const *config) {
+    f64 const upper = config->max_load_factor ? config->max_load_factor : MAP_LOAD_FACTOR_UPPER;
+    f64 const lower = config->min_load_factor;
+
+    // Eager shrinking may leave the load at twice the lower load factor, it must not grow back
+    return upper > 0 && upper < 1 && lower >= 0 && lower < upper / 2;
 }
 
 bool get_random_key(u8 *buffer, size_t buffer_len) {
     return _init_random_key(buffer, buffer_len);
 }
 
-struct HashMap* hmap_init(size_t item_size, u32 init_capa, void (*clean_func)(void *)) {
+struct HashMap* hmap_init_ex(struct HashMapConfig const *config, u32 init_capa) {
     if (init_capa < MAP_INIT_EXP_CAPACITY) {
         init_capa = MAP_INIT_EXP_CAPACITY;
     } else if (init_capa > MAP_MAX_EXP_CAPACITY) {
@@ -463,29 +1353,61 @@ struct HashMap* hmap_init(size_t item_size, u32 init_capa, void (*clean_func)(vo
         );
         return NULL;
     }
+    if (config->layout != HASHMAP_LAYOUT_INTERLEAVED && config->layout != HASHMAP_LAYOUT_SPLIT) {
+        fprintf(stderr, "Unknown slot layout %d.\n", (int)config->layout);
+        return NULL;
+    }
+    if (config->key_type != HASHMAP_KEY_STRING && config->key_type != HASHMAP_KEY_U64) {
+        fprintf(stderr, "Unknown key type %d.\n", (int)config->key_type);
+        return NULL;
+    }
+    if (config->key_type == HASHMAP_KEY_U64 && config->long_keys) {
+        fprintf(stderr, "Long keys are not available with integer keys.\n");
+        return NULL;
+    }
+    if ((u32)config->hash > HASHMAP_HASH_CUSTOM) {
+        fprintf(stderr, "Unknown hash function %d.\n", (int)config->hash);
+        return NULL;
+    }
+    if (config->hash == HASHMAP_HASH_CUSTOM && config->hash_func == NULL) {
+        fprintf(stderr, "Custom hash function selected but not given.\n");
+        return NULL;
+    }
+    if (!_load_factors_are_valid(config)) {
+        fprintf(stderr, "Load factors must satisfy 0 < lower < upper / 2 and upper < 1.\n");
+        return NULL;
+    }
+    if ((u32)config->shrink > HASHMAP_SHRINK_NEVER) {
+        fprintf(stderr, "Unknown shrink policy %d.\n", (int)config->shrink);
+        return NULL;
+    }
+    if ((u32)config->packing > HASHMAP_PACKING_PACKED) {
+        fprintf(stderr, "Unknown slot packing %d.\n", (int)config->packing);
+        return NULL;
+    }
+    if ((config->allocator.alloc_func == NULL) != (config->allocator.free_func == NULL)) {
+        fprintf(stderr, "Allocator needs both alloc and free functions.\n");
+        return NULL;
+    }
 
-    size_t const sz_meta_chunk = sizeof(struct Bucket) + MAP_MAX_KEY_BYTES;
-
-    if (item_size < UINT32_MAX - sz_meta_chunk) {
-        u32 const sz_slot_raw = item_size + sz_meta_chunk;
-
-        if (sz_slot_raw < UINT32_MAX - sz_slot_raw % sizeof(void *)) {
-            return _hmap_init(item_size, init_capa, clean_func, true);
-        }
+    if (_item_size_is_valid(config->item_size)) {
+        return _hmap_init(config, init_capa, true);
     }
     return NULL;
 }
 
-struct HashMap* hmap_init_with_key(size_t item_size, void (*clean_func)(void *)) {
-    size_t const sz_meta_chunk = sizeof(struct Bucket) + MAP_MAX_KEY_BYTES;
+struct HashMap* hmap_init(size_t item_size, u32 init_capa, void (*clean_func)(void *)) {
+    struct HashMapConfig const config = {.item_size=item_size, .clean_func=clean_func};
+
+    return hmap_init_ex(&config, init_capa);
+}
 
-    if (item_size < UINT32_MAX - sz_meta_chunk) {
-        u32 const sz_slot_raw = item_size + sz_meta_chunk;
+struct HashMap* hmap_init_with_key(size_t item_size, void (*clean_func)(void *)) {
+    struct HashMapConfig const config = {.item_size=item_size, .clean_func=clean_func};
 
-        if (sz_slot_raw < UINT32_MAX - sz_slot_raw % sizeof(void *)) {
-            // Init with a deterministic key, use only for testing
-            return _hmap_init(item_size, MAP_INIT_EXP_CAPACITY, clean_func, false);
-        }
+    if (_item_size_is_valid(item_size)) {
+        // Init with a deterministic key, use only for testing
+        return _hmap_init(&config, MAP_INIT_EXP_CAPACITY, false);
     }
     return NULL;
 }
@@ -496,16 +1418,31 @@ void hmap_free(struct HashMap *hashmap) {
     }
 }
 
+void* hmap_get_n(struct HashMap *hashmap, void const *key, size_t len) {
+    return (key == NULL || !_key_len_is_valid(hashmap, len)) ? NULL :
+        _hmap_get_counted(hashmap, key, len, get_truncated_hash(hashmap, key, len));
+}
+
 void* hmap_get(struct HashMap *hashmap, char const *key) {
-    return (key == NULL || strlen(key) > MAP_MAX_KEY_BYTES - 1) ? NULL :
-        _hmap_get(hashmap, key);
+    return key == NULL ? NULL : hmap_get_n(hashmap, key, strlen(key));
 }
 
-bool hmap_insert(struct HashMap *hashmap, char const *key, void const *data) {
-    if (key == NULL || strlen(key) > MAP_MAX_KEY_BYTES - 1 || data == NULL) {
-        return false;
-    }
-    if (hashmap->occ_slots >= (1U << hashmap->ex_capa) * MAP_LOAD_FACTOR_UPPER) {
+static bool _hmap_grow_and_insert(
+    struct HashMap *hashmap,
+    char const *key,
+    size_t len,
+    bucket_meta_type hash_trunc,
+    void const *data)
+{
+    if (_rejects_mutation(hashmap)) return false;
+
+    _hmap_migrate(hashmap, MAP_MIGRATE_STEPS);
+
+    if (hashmap->occ_slots >= MAP_CAPACITY(hashmap->ex_capa) * hashmap->max_load) {
+        if (hashmap->fixed_slots) {
+            fprintf(stderr, "Hash map of fixed capacity is full.\n");
+            return false;
+        }
         if (hashmap->ex_capa == MAP_MAX_EXP_CAPACITY) {
             fprintf(
                 stderr,
@@ -514,31 +1451,552 @@ bool hmap_insert(struct HashMap *hashmap, char const *key, void const *data) {
             );
             return false;
         }
-        if (!_hmap_resize(hashmap, hashmap->ex_capa + 1)) {
+        if (!_hmap_resize_to(hashmap, hashmap->ex_capa + 1)) {
             return false;
         }
     }
-    return _hmap_insert(hashmap, key, data);
+    return _hmap_insert(hashmap, key, len, hash_trunc, data);
+}
+
+bool hmap_insert_n(struct HashMap *hashmap, void const *key, size_t len, void const *data) {
+    if (key == NULL || !_key_len_is_valid(hashmap, len) || data == NULL) {
+        return false;
+    }
+    return _hmap_grow_and_insert(hashmap, key, len, get_truncated_hash(hashmap, key, len), data);
+}
+
+bool hmap_insert(struct HashMap *hashmap, char const *key, void const *data) {
+    return key == NULL ? false : hmap_insert_n(hashmap, key, strlen(key), data);
+}
+
+/*
+Remove the key and return its data item from the first temporary slot, where it stays
+until the next removal.
+*/
+static void* _hmap_remove_to_temp(
+    struct HashMap *hashmap,
+    char const *key,
+    size_t len,
+    bucket_meta_type hash_trunc)
+{
+    struct Table const removed = _temp_table(hashmap, 0);
+    void *item = _item_at(&removed, 0);
+
+    return _hmap_remove(hashmap, key, len, hash_trunc, item) ? item : NULL;
+}
+
+void* hmap_remove_n(struct HashMap *hashmap, void const *key, size_t len) {
+    if (key == NULL || !_key_len_is_valid(hashmap, len)) {
+        return NULL;
+    }
+    _hmap_migrate(hashmap, MAP_MIGRATE_STEPS);
+
+    return _hmap_remove_to_temp(hashmap, key, len, get_truncated_hash(hashmap, key, len));
 }
 
 void* hmap_remove(struct HashMap *hashmap, char const *key) {
-    return (key == NULL || strlen(key) > MAP_MAX_KEY_BYTES - 1) ? NULL :
-        _hmap_remove(hashmap, key);
+    return key == NULL ? NULL : hmap_remove_n(hashmap, key, strlen(key));
+}
+
+bool hmap_remove_into_n(struct HashMap *hashmap, void const *key, size_t len, void *item) {
+    if (key == NULL || !_key_len_is_valid(hashmap, len)) {
+        return false;
+    }
+    _hmap_migrate(hashmap, MAP_MIGRATE_STEPS);
+
+    return _hmap_remove(hashmap, key, len, get_truncated_hash(hashmap, key, len), item);
+}
+
+bool hmap_remove_into(struct HashMap *hashmap, char const *key, void *item) {
+    return key == NULL ? false : hmap_remove_into_n(hashmap, key, strlen(key), item);
+}
+
+void* hmap_get_u64(struct HashMap *hashmap, u64 key) {
+    if (hashmap->key_type != HASHMAP_KEY_U64) {
+        return NULL;
+    }
+    char const *key_bytes = (char const *)&key;
+
+    return _hmap_get_counted(
+        hashmap, key_bytes, sizeof key, get_truncated_hash(hashmap, key_bytes, sizeof key)
+    );
+}
+
+bool hmap_insert_u64(struct HashMap *hashmap, u64 key, void const *data) {
+    if (hashmap->key_type != HASHMAP_KEY_U64 || data == NULL) {
+        return false;
+    }
+    char const *key_bytes = (char const *)&key;
+
+    return _hmap_grow_and_insert(
+        hashmap, key_bytes, sizeof key, get_truncated_hash(hashmap, key_bytes, sizeof key), data
+    );
+}
+
+void* hmap_remove_u64(struct HashMap *hashmap, u64 key) {
+    if (hashmap->key_type != HASHMAP_KEY_U64) {
+        return NULL;
+    }
+    _hmap_migrate(hashmap, MAP_MIGRATE_STEPS);
+
+    char const *key_bytes = (char const *)&key;
+
+    return _hmap_remove_to_temp(
+        hashmap, key_bytes, sizeof key, get_truncated_hash(hashmap, key_bytes, sizeof key)
+    );
+}
+
+void* hmap_get_view(
+    struct HashMap *hashmap,
+    struct MapView const *view,
+    void const *key,
+    size_t len,
+    u64 hash)
+{
+    return (key == NULL || !_key_len_is_valid(hashmap, len)) ? NULL :
+        _view_get(hashmap, view, key, len, _truncate_hash(hash));
+}
+
+u64 hmap_hash(struct HashMap const *hashmap, void const *key, size_t len) {
+    return _hash_key(hashmap, key, len);
+}
+
+void* hmap_get_hashed(struct HashMap *hashmap, void const *key, size_t len, u64 hash) {
+    return (key == NULL || !_key_len_is_valid(hashmap, len)) ? NULL :
+        _hmap_get(hashmap, key, len, _truncate_hash(hash));
+}
+
+bool hmap_insert_hashed(
+    struct HashMap *hashmap,
+    void const *key,
+    size_t len,
+    u64 hash,
+    void const *data)
+{
+    if (key == NULL || !_key_len_is_valid(hashmap, len) || data == NULL) {
+        return false;
+    }
+    return _hmap_grow_and_insert(hashmap, key, len, _truncate_hash(hash), data);
+}
+
+bool hmap_remove_hashed(struct HashMap *hashmap, void const *key, size_t len, u64 hash, void *item) {
+    if (key == NULL || !_key_len_is_valid(hashmap, len)) {
+        return false;
+    }
+    _hmap_migrate(hashmap, MAP_MIGRATE_STEPS);
+
+    return _hmap_remove(hashmap, key, len, _truncate_hash(hash), item);
+}
+
+/*
+String keys of a batch operation, at most `MAP_BATCH_KEYS` at a time.
+
+Keys that are NULL or of invalid length are marked invalid and skipped by the operations.
+*/
+struct KeyBatch {
+    size_t count;
+    char const *keys[MAP_BATCH_KEYS];
+    size_t lens[MAP_BATCH_KEYS];
+    bool valid[MAP_BATCH_KEYS];
+    bucket_meta_type hashes[MAP_BATCH_KEYS];
+};
+
+/*
+Hash the keys of a batch. Default SipHash-2-4 hashes several keys in parallel, other hash
+functions are called key by key.
+*/
+static void _batch_hash(
+    struct HashMap const *hashmap,
+    char const *const keys[],
+    size_t count,
+    struct KeyBatch *batch)
+{
+    void const *messages[MAP_BATCH_KEYS];
+    size_t lens[MAP_BATCH_KEYS];
+    u64 hashes[MAP_BATCH_KEYS];
+    size_t valid_count = 0;
+
+    batch->count = count;
+    for (size_t i=0; i<count; ++i) {
+        batch->keys[i] = keys[i];
+        batch->lens[i] = keys[i] == NULL ? 0 : strlen(keys[i]);
+        batch->valid[i] = keys[i] != NULL && _key_len_is_valid(hashmap, batch->lens[i]);
+
+        if (batch->valid[i]) {
+            messages[valid_count] = keys[i];
+            lens[valid_count] = batch->lens[i];
+            valid_count += 1;
+        }
+    }
+
+    if (hashmap->hash_func == siphash) {
+        siphash_batch(messages, lens, valid_count, hashmap->rand_key, hashes);
+    } else {
+        for (size_t j=0; j<valid_count; ++j) {
+            hashes[j] = hashmap->hash_func(messages[j], lens[j], hashmap->rand_key);
+        }
+    }
+
+    size_t j = 0;
+    for (size_t i=0; i<count; ++i) {
+        if (batch->valid[i]) {
+            batch->hashes[i] = _truncate_hash(hashes[j++]);
+        }
+    }
+}
+
+/*
+Hash the keys of a batch and prefetch their home buckets.
+
+The home buckets are prefetched only after all the hashes are known so that the cache
+misses of the batch overlap. During an incremental resize only the current table is
+prefetched, keys not yet migrated get found from the old table as usual.
+*/
+static void _batch_prepare(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    size_t count,
+    struct KeyBatch *batch)
+{
+    _batch_hash(hashmap, keys, count, batch);
+
+    struct Table const table = _table(hashmap, hashmap->slots, hashmap->ex_capa);
+
+    for (size_t i=0; i<count; ++i) {
+        if (!batch->valid[i]) continue;
+
+        size_t const idx = batch->hashes[i] & table.mask;
+
+        __builtin_prefetch(_bucket_at(&table, idx));
+        if (hashmap->layout == HASHMAP_LAYOUT_SPLIT) {
+            __builtin_prefetch(_key_at(&table, idx));
+        }
+    }
+}
+
+size_t hmap_get_batch(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    size_t count,
+    void *items[])
+{
+    struct KeyBatch batch;
+    size_t found = 0;
+
+    for (size_t start=0; start<count; start+=MAP_BATCH_KEYS) {
+        size_t const group = count - start < MAP_BATCH_KEYS ? count - start : MAP_BATCH_KEYS;
+        _batch_prepare(hashmap, keys + start, group, &batch);
+
+        for (size_t i=0; i<group; ++i) {
+            items[start + i] = !batch.valid[i] ? NULL :
+                _hmap_get_counted(hashmap, batch.keys[i], batch.lens[i], batch.hashes[i]);
+            found += items[start + i] != NULL;
+        }
+    }
+    return found;
+}
+
+size_t hmap_insert_batch(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    size_t count,
+    void const *const data[])
+{
+    struct KeyBatch batch;
+    size_t inserted = 0;
+
+    for (size_t start=0; start<count; start+=MAP_BATCH_KEYS) {
+        size_t const group = count - start < MAP_BATCH_KEYS ? count - start : MAP_BATCH_KEYS;
+        _batch_prepare(hashmap, keys + start, group, &batch);
+
+        for (size_t i=0; i<group; ++i) {
+            if (!batch.valid[i] || data[start + i] == NULL) continue;
+
+            // A resize on the way makes the rest of the prefetches useless but not wrong
+            inserted += _hmap_grow_and_insert(
+                hashmap, batch.keys[i], batch.lens[i], batch.hashes[i], data[start + i]
+            );
+        }
+    }
+    return inserted;
+}
+
+size_t hmap_remove_batch(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    size_t count,
+    void *items)
+{
+    struct KeyBatch batch;
+    size_t removed = 0;
+
+    for (size_t start=0; start<count; start+=MAP_BATCH_KEYS) {
+        size_t const group = count - start < MAP_BATCH_KEYS ? count - start : MAP_BATCH_KEYS;
+        _batch_prepare(hashmap, keys + start, group, &batch);
+
+        for (size_t i=0; i<group; ++i) {
+            if (!batch.valid[i]) continue;
+
+            _hmap_migrate(hashmap, MAP_MIGRATE_STEPS);
+            void *item = items == NULL ? NULL : (char *)items + (start + i) * hashmap->sz_item;
+
+            removed += _hmap_remove(hashmap, batch.keys[i], batch.lens[i], batch.hashes[i], item);
+        }
+    }
+    return removed;
+}
+
+/*
+Key of a bulk build. `src` indexes the input keys and data items, `SIZE_MAX` marks a key
+dropped as a duplicate.
+*/
+struct BuildEntry {
+    bucket_meta_type hash;
+    size_t src;
+    size_t len;
+};
+
+static size_t _build_by_insertion(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    void const *items,
+    size_t count)
+{
+    u32 const occ_before = hashmap->occ_slots;
+
+    for (size_t i=0; i<count; ++i) {
+        hmap_insert(hashmap, keys[i], (u8 const *)items + i * hashmap->sz_item);
+    }
+    return hashmap->occ_slots - occ_before;
+}
+
+/*
+Drop duplicate keys from `sorted`, a later duplicate replaces the data item of the earlier
+one as with insertions. Duplicates share the home bucket and thus a group of the sorted
+keys, and groups are tiny. Returns the count of entries kept.
+*/
+static size_t _build_dedup(
+    struct BuildEntry *sorted,
+    size_t count,
+    size_t mask,
+    char const *const keys[])
+{
+    size_t kept = 0;
+
+    for (size_t start=0; start<count;) {
+        size_t const home = sorted[start].hash & mask;
+        size_t const group_start = kept;
+
+        for (; start<count && (sorted[start].hash & mask) == home; ++start) {
+            struct BuildEntry const entry = sorted[start];
+            bool duplicate = false;
+
+            for (size_t j=group_start; j<kept && !duplicate; ++j) {
+                if (sorted[j].hash == entry.hash && sorted[j].len == entry.len &&
+                    memcmp(keys[sorted[j].src], keys[entry.src], entry.len) == 0)
+                {
+                    sorted[j].src = entry.src;
+                    duplicate = true;
+                }
+            }
+            if (!duplicate) {
+                sorted[kept++] = entry;
+            }
+        }
+    }
+    return kept;
+}
+
+/*
+Count of slots that wrap around the end of the table when the keys sorted by their home
+bucket are placed by a linear sweep, starting from slot `carry`. Wrapped slots go in
+front of the slots of the first home buckets, so the sweep is consistent once the wrapped
+count equals the `carry` it started from. Sets `max_psl` to the longest probe sequence.
+*/
+static size_t _build_sweep_wrap(
+    struct BuildEntry const *sorted,
+    size_t count,
+    size_t mask,
+    size_t carry,
+    size_t *max_psl)
+{
+    size_t next = carry;
+    *max_psl = 0;
+
+    for (size_t i=0; i<count; ++i) {
+        size_t const home = sorted[i].hash & mask;
+        size_t const pos = home > next ? home : next;
+
+        if (pos - home > *max_psl) *max_psl = pos - home;
+        next = pos + 1;
+    }
+    return next > mask + 1 ? next - (mask + 1) : 0;
+}
+
+/*
+Place all keys into the empty table by a linear sweep.
+
+Keys are hashed in batches and sorted by their home bucket with a counting sort. Placing
+them in that order gives each key the first free slot at or after its home bucket, which
+is exactly the Robin Hood placement: no slot gets displaced and the slots are written in
+order. Falls back to plain insertions if memory for the sort cannot be allocated or a probe
+sequence would get too long.
+*/
+static size_t _build_sorted(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    void const *items,
+    size_t count)
+{
+    struct HashMapAllocator const *allocator = &hashmap->allocator;
+    struct Table const table = _table(hashmap, hashmap->slots, hashmap->ex_capa);
+    size_t const capacity = table.mask + 1;
+
+    struct BuildEntry *entries = _mem_alloc(allocator, count * sizeof *entries);
+    struct BuildEntry *sorted = _mem_alloc(allocator, count * sizeof *sorted);
+    size_t *offsets = _mem_calloc(allocator, capacity + 1, sizeof *offsets);
+
+    bool swept = entries != NULL && sorted != NULL && offsets != NULL;
+    size_t valid = 0, arena_bytes = 0;
+
+    for (size_t start=0; swept && start<count; start+=MAP_BATCH_KEYS) {
+        size_t const group = count - start < MAP_BATCH_KEYS ? count - start : MAP_BATCH_KEYS;
+        struct KeyBatch batch;
+        _batch_hash(hashmap, keys + start, group, &batch);
+
+        for (size_t i=0; i<group; ++i) {
+            if (!batch.valid[i]) continue;
+
+            entries[valid++] = (struct BuildEntry){
+                .hash=batch.hashes[i], .src=start + i, .len=batch.lens[i]
+            };
+            offsets[(batch.hashes[i] & table.mask) + 1] += 1;
+            if (batch.lens[i] > MAP_INLINE_KEY_BYTES) {
+                arena_bytes += batch.lens[i] + 1;
+            }
+        }
+    }
+
+    size_t kept = 0, carry = 0, max_psl = 0;
+    if (swept) {
+        for (size_t j=0; j<capacity; ++j) {
+            offsets[j + 1] += offsets[j];
+        }
+        // Stable, the input order decides between duplicates
+        for (size_t i=0; i<valid; ++i) {
+            sorted[offsets[entries[i].hash & table.mask]++] = entries[i];
+        }
+        kept = _build_dedup(sorted, valid, table.mask, keys);
+
+        // Wrapped count only grows with the carry and is bounded by the key count
+        size_t wrapped;
+        while ((wrapped = _build_sweep_wrap(sorted, kept, table.mask, carry, &max_psl)) != carry) {
+            carry = wrapped;
+        }
+        // Long keys are stored in the sweep, which then cannot fail midway
+        swept = max_psl <= MAX_PSL && (!hashmap->long_keys ||
+            _arena_reserve(allocator, &hashmap->arena, arena_bytes));
+    }
+
+    if (swept) {
+        size_t next = carry;
+
+        for (size_t i=0; i<kept; ++i) {
+            struct BuildEntry const *entry = &sorted[i];
+            size_t const home = entry->hash & table.mask;
+            size_t const pos = home > next ? home : next;
+            size_t const idx = pos & table.mask;
+
+            struct Bucket *bucket = _bucket_at(&table, idx);
+            bucket->meta_data = 0;
+            _update_bucket_meta(bucket, (u32)(pos - home), entry->hash);
+            _store_key(hashmap, _key_at(&table, idx), keys[entry->src], entry->len);
+            memcpy(
+                _item_at(&table, idx),
+                (u8 const *)items + entry->src * hashmap->sz_item,
+                hashmap->sz_item
+            );
+            next = pos + 1;
+        }
+        hashmap->occ_slots = (u32)kept;
+        MAP_STATS_ADD(hashmap, inserts, kept);
+    }
+
+    _mem_free(allocator, offsets, (capacity + 1) * sizeof *offsets);
+    _mem_free(allocator, sorted, count * sizeof *sorted);
+    _mem_free(allocator, entries, count * sizeof *entries);
+
+    return swept ? kept : _build_by_insertion(hashmap, keys, items, count);
+}
+
+size_t hmap_build(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    void const *items,
+    size_t count)
+{
+    if (hashmap->key_type != HASHMAP_KEY_STRING) {
+        fprintf(stderr, "Cannot build a hash map of integer keys from string keys.\n");
+        return 0;
+    }
+    if (keys == NULL || items == NULL || count == 0 || _rejects_mutation(hashmap)) return 0;
+
+    // Linear sweep needs an empty table, otherwise the keys are inserted one by one
+    if (hashmap->occ_slots > 0 || count > SIZE_MAX / sizeof(struct BuildEntry) ||
+        !hmap_reserve(hashmap, count))
+    {
+        return _build_by_insertion(hashmap, keys, items, count);
+    }
+    return _build_sorted(hashmap, keys, items, count);
+}
+
+static bool _table_iter_apply(
+    struct HashMap *hashmap,
+    void *slots,
+    u32 ex_capa,
+    bool (*callback)(char const *, void *))
+{
+    struct Table const table = _table(hashmap, slots, ex_capa);
+
+    for (size_t j=0; j<=table.mask; ++j) {
+        if (BUCKET_IS_TAKEN(_bucket_at(&table, j)->meta_data)) {
+            char key_buffer[MAP_MAX_KEY_BYTES];
+            char const *key = _key_str(hashmap, _key_at(&table, j), key_buffer);
+
+            if (!callback(key, _item_at(&table, j))) {
+                return false;
+            }
+        }
+    }
+    return true;
 }
 
 bool hmap_iter_apply(struct HashMap *hashmap, bool (*callback)(char const *, void *)) {
-    u32 const total_capacity = 1U << hashmap->ex_capa;
-    u32 const data_offset = hashmap->sz_bucket + hashmap->sz_key;
+    if (hashmap->key_type != HASHMAP_KEY_STRING) {
+        fprintf(stderr, "Cannot iterate integer keys as strings.\n");
+        return false;
+    }
+    if (!_table_iter_apply(hashmap, hashmap->slots, hashmap->ex_capa, callback)) {
+        return false;
+    }
+    return hashmap->old_slots == NULL ||
+        _table_iter_apply(hashmap, hashmap->old_slots, hashmap->old_ex_capa, callback);
+}
 
-    for (u32 j=0; j<total_capacity; ++j) {
-        struct Bucket *bucket = (struct Bucket *)
-            ((char *)hashmap->slots + hashmap->sz_slot * j);
+static bool _table_iter_apply_u64(
+    struct HashMap *hashmap,
+    void *slots,
+    u32 ex_capa,
+    bool (*callback)(u64, void *))
+{
+    struct Table const table = _table(hashmap, slots, ex_capa);
 
-        if (BUCKET_IS_TAKEN(bucket->meta_data)) {
-            char key_buffer[MAP_MAX_KEY_BYTES] = {0};
-            memcpy(key_buffer, (char *)bucket + hashmap->sz_bucket, hashmap->sz_key - 1);
+    for (size_t j=0; j<=table.mask; ++j) {
+        if (BUCKET_IS_TAKEN(_bucket_at(&table, j)->meta_data)) {
+            u64 key;
+            memcpy(&key, _key_at(&table, j), sizeof key);
 
-            if (!callback(key_buffer, (char *)bucket + data_offset)) {
+            if (!callback(key, _item_at(&table, j))) {
                 return false;
             }
         }
@@ -546,50 +2004,273 @@ bool hmap_iter_apply(struct HashMap *hashmap, bool (*callback)(char const *, voi
     return true;
 }
 
+bool hmap_iter_apply_u64(struct HashMap *hashmap, bool (*callback)(u64, void *)) {
+    if (hashmap->key_type != HASHMAP_KEY_U64) {
+        fprintf(stderr, "Cannot iterate string keys as integers.\n");
+        return false;
+    }
+    if (!_table_iter_apply_u64(hashmap, hashmap->slots, hashmap->ex_capa, callback)) {
+        return false;
+    }
+    return hashmap->old_slots == NULL ||
+        _table_iter_apply_u64(hashmap, hashmap->old_slots, hashmap->old_ex_capa, callback);
+}
+
 u32 hmap_len(struct HashMap *hashmap) {
     return hashmap->occ_slots;
 }
 
-u32 get_occupied_slot_count(struct HashMap *hashmap) {
-    u32 const total_capacity = 1U << hashmap->ex_capa;
-    u32 occupied = 0;
+/*
+Smallest capacity exponent at which `elems` insertions to an empty table do not grow it,
+the last insertion sees `elems` - 1 occupied slots. Exceeds `MAP_MAX_EXP_CAPACITY` if
+`elems` does not fit at all.
+*/
+static u32 _ex_capa_for(size_t elems, f64 max_load) {
+    u32 ex_capa = MAP_INIT_EXP_CAPACITY;
 
-    for (u32 j=0; j<total_capacity; ++j) {
-        struct Bucket *bucket = (struct Bucket *)
-            ((char *)hashmap->slots + hashmap->sz_slot * j);
+    while (ex_capa <= MAP_MAX_EXP_CAPACITY && elems > 0 &&
+        elems - 1 >= MAP_CAPACITY(ex_capa) * max_load)
+    {
+        ex_capa += 1;
+    }
+    return ex_capa;
+}
 
-        if (BUCKET_IS_TAKEN(bucket->meta_data)) {
+u32 hmap_init_capa_for(struct HashMapConfig const *config, size_t elems) {
+    return _ex_capa_for(
+        elems, config->max_load_factor ? config->max_load_factor : MAP_LOAD_FACTOR_UPPER
+    );
+}
+
+bool hmap_reserve(struct HashMap *hashmap, size_t elems) {
+    if (_rejects_mutation(hashmap)) return false;
+
+    u32 const new_ex_capa = _ex_capa_for(elems, hashmap->max_load);
+
+    if (new_ex_capa > MAP_MAX_EXP_CAPACITY) {
+        fprintf(
+            stderr,
+            "Hash map capacity cannot be increased over 2^%u.\n",
+            MAP_MAX_EXP_CAPACITY
+        );
+        return false;
+    }
+    // Finish a migration in progress, the reserved capacity is then rehashed at once
+    _hmap_migrate(hashmap, SIZE_MAX);
+    if (hashmap->old_slots) return false;
+
+    return new_ex_capa <= hashmap->ex_capa ||
+        (!hashmap->fixed_slots && _hmap_resize(hashmap, new_ex_capa));
+}
+
+void hmap_finish_migration(struct HashMap *hashmap) {
+    _hmap_migrate(hashmap, SIZE_MAX);
+}
+
+bool hmap_shrink_to_fit(struct HashMap *hashmap) {
+    if (_rejects_mutation(hashmap)) return false;
+
+    // Smallest capacity the next insertion does not grow
+    u32 new_ex_capa = hashmap->ex_capa;
+    while (
+        new_ex_capa > MAP_INIT_EXP_CAPACITY &&
+        hashmap->occ_slots < MAP_CAPACITY(new_ex_capa - 1) * hashmap->max_load)
+    {
+        new_ex_capa -= 1;
+    }
+
+    if (new_ex_capa < hashmap->ex_capa && !_hmap_resize_to(hashmap, new_ex_capa)) {
+        return false;
+    }
+    // Memory of the old slots is released only once they are migrated
+    _hmap_migrate(hashmap, SIZE_MAX);
+
+    return hashmap->old_slots == NULL;
+}
+
+static u32 _table_occupied_slot_count(struct HashMap *hashmap, void *slots, u32 ex_capa) {
+    struct Table const table = _table(hashmap, slots, ex_capa);
+    u32 occupied = 0;
+
+    for (size_t j=0; j<=table.mask; ++j) {
+        if (BUCKET_IS_TAKEN(_bucket_at(&table, j)->meta_data)) {
             occupied += 1;
         }
     }
     return occupied;
 }
 
+u32 get_occupied_slot_count(struct HashMap *hashmap) {
+    u32 occupied = _table_occupied_slot_count(hashmap, hashmap->slots, hashmap->ex_capa);
+
+    if (hashmap->old_slots) {
+        occupied += _table_occupied_slot_count(hashmap, hashmap->old_slots, hashmap->old_ex_capa);
+    }
+    return occupied;
+}
+
 void hmap_show_stats(struct HashMap *hashmap) {
-    u32 const total_capacity = 1U << hashmap->ex_capa;
+    size_t const total_capacity = MAP_CAPACITY(hashmap->ex_capa);
 
-    fprintf(stdout, "Total capacity: %u\n", total_capacity);
+    fprintf(stdout, "Total capacity: %zu\n", total_capacity);
     fprintf(stdout, "Occupied slots: %u\n", hashmap->occ_slots);
     fprintf(stdout, "Slot size in bytes: %u\n", hashmap->sz_slot);
+    fprintf(stdout, "Layout: %s\n",
+        hashmap->layout == HASHMAP_LAYOUT_SPLIT ? "split" : "interleaved");
     fprintf(stdout, "Load factor: %.2f\n\n", (f32)hashmap->occ_slots / total_capacity);
+
+    if (hashmap->long_keys) {
+        fprintf(stdout, "Key arena bytes: %zu (unused %zu)\n\n", hashmap->arena.len, hashmap->arena.dead);
+    }
+
+    if (hashmap->old_slots) {
+        fprintf(stdout, "Resize in progress, old capacity: %zu\n", MAP_CAPACITY(hashmap->old_ex_capa));
+        fprintf(stdout, "Slots left to migrate: %u\n\n", hashmap->old_occ_slots);
+    }
 }
 
-void traverse_hashmap_slots(struct HashMap *hashmap) {
-    u32 const total_capacity = 1U << hashmap->ex_capa;
+static void _table_psl_histogram(
+    struct HashMap *hashmap,
+    void *slots,
+    u32 ex_capa,
+    struct HashMapStats *stats)
+{
+    struct Table const table = _table(hashmap, slots, ex_capa);
 
-    for (u32 j=0; j<total_capacity; ++j) {
-        struct Bucket *bucket = (struct Bucket *)
-            ((char *)hashmap->slots + hashmap->sz_slot * j);
+    for (size_t j=0; j<=table.mask; ++j) {
+        bucket_meta_type const meta_data = _bucket_at(&table, j)->meta_data;
+        if (!BUCKET_IS_TAKEN(meta_data)) continue;
 
-        fprintf(stdout, "Bucket address: %p\n", bucket);
+        u64 const psl = META_GET_PSL(meta_data);
+        size_t const bucket = psl < HASHMAP_STATS_PSL_BUCKETS ? psl : HASHMAP_STATS_PSL_BUCKETS - 1;
 
-        if (BUCKET_IS_TAKEN(bucket->meta_data)) {
-            fprintf(stdout, "Bucket taken, psl == %u\n", META_GET_PSL(bucket->meta_data));
+        stats->psl_histogram[bucket] += 1;
+        if (psl > stats->max_psl) stats->max_psl = psl;
+    }
+}
 
-            char key_buffer[MAP_MAX_KEY_BYTES] = {0};
-            memcpy(key_buffer, (char *)bucket + hashmap->sz_bucket, hashmap->sz_key - 1);
+bool hmap_get_stats(struct HashMap *hashmap, struct HashMapStats *stats) {
+    memset(stats, 0, sizeof *stats);
+    stats->capacity = MAP_CAPACITY(hashmap->ex_capa);
+    stats->len = hashmap->occ_slots;
 
-            fprintf(stdout, "Key: %s\n", key_buffer);
+    _table_psl_histogram(hashmap, hashmap->slots, hashmap->ex_capa, stats);
+    if (hashmap->old_slots) {
+        _table_psl_histogram(hashmap, hashmap->old_slots, hashmap->old_ex_capa, stats);
+    }
+
+#ifdef HASHMAP_STATS
+    stats->get_hits = MAP_STATS_GET(hashmap, get_hits);
+    stats->get_misses = MAP_STATS_GET(hashmap, get_misses);
+    stats->gets = stats->get_hits + stats->get_misses;
+    stats->inserts = MAP_STATS_GET(hashmap, inserts);
+    stats->updates = MAP_STATS_GET(hashmap, updates);
+    stats->removes = MAP_STATS_GET(hashmap, removes);
+    stats->displacements = MAP_STATS_GET(hashmap, displacements);
+    stats->backward_shifts = MAP_STATS_GET(hashmap, backward_shifts);
+    stats->resizes_up = MAP_STATS_GET(hashmap, resizes_up);
+    stats->resizes_down = MAP_STATS_GET(hashmap, resizes_down);
+    stats->resize_ns = MAP_STATS_GET(hashmap, resize_ns);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*
+Add the probe sequence lengths, clusters and memory of one table to `stats`. Sums of the
+probe sequence lengths and cluster lengths are accumulated to the respective means.
+*/
+static void _table_layout_stats(
+    struct HashMap *hashmap,
+    void *slots,
+    u32 ex_capa,
+    struct HashMapLayoutStats *stats)
+{
+    struct Table const table = _table(hashmap, slots, ex_capa);
+    size_t const capacity = table.mask + 1;
+    size_t start = 0;
+
+    // Clusters may wrap around the end of the table, the scan starts after an empty slot
+    while (start < capacity && BUCKET_IS_TAKEN(_bucket_at(&table, start)->meta_data)) {
+        start += 1;
+    }
+    u64 cluster_len = 0;
+    size_t occupied = 0;
+
+    for (size_t i=1; i<=capacity; ++i) {
+        bucket_meta_type const meta_data = _bucket_at(&table, (start + i) & table.mask)->meta_data;
+
+        if (BUCKET_IS_TAKEN(meta_data)) {
+            u64 const psl = META_GET_PSL(meta_data);
+            if (psl > stats->max_psl) stats->max_psl = psl;
+            stats->mean_psl += (f64)psl;
+
+            occupied += 1;
+            cluster_len += 1;
+            if (i < capacity) continue;
+        }
+        if (cluster_len == 0) continue;
+
+        u32 const bucket = 63 - (u32)__builtin_clzll(cluster_len);
+        stats->cluster_histogram[bucket < HASHMAP_STATS_CLUSTER_BUCKETS ? bucket :
+            HASHMAP_STATS_CLUSTER_BUCKETS - 1] += 1;
+        stats->cluster_count += 1;
+        if (cluster_len > stats->max_cluster_len) stats->max_cluster_len = cluster_len;
+        stats->mean_cluster_len += (f64)cluster_len;
+        cluster_len = 0;
+    }
+
+    size_t const key_bytes = hashmap->key_type == HASHMAP_KEY_U64 ? sizeof(u64) : MAP_MAX_KEY_BYTES;
+    size_t const slot_bytes = _slot_bytes(hashmap);
+
+    stats->capacity += capacity;
+    stats->table_bytes += capacity * slot_bytes;
+    stats->key_padding_bytes += capacity * (hashmap->sz_key - key_bytes);
+    stats->alignment_bytes += capacity *
+        (slot_bytes - hashmap->sz_bucket - hashmap->sz_key - hashmap->sz_item);
+    stats->empty_bytes += (capacity - occupied) * slot_bytes;
+}
+
+void hmap_get_layout_stats(struct HashMap *hashmap, struct HashMapLayoutStats *stats) {
+    memset(stats, 0, sizeof *stats);
+
+    _table_layout_stats(hashmap, hashmap->slots, hashmap->ex_capa, stats);
+    if (hashmap->old_slots) {
+        _table_layout_stats(hashmap, hashmap->old_slots, hashmap->old_ex_capa, stats);
+    }
+    stats->len = hashmap->occ_slots;
+    stats->mean_psl = stats->len ? stats->mean_psl / stats->len : 0;
+    stats->mean_cluster_len = stats->cluster_count ?
+        stats->mean_cluster_len / stats->cluster_count : 0;
+
+    stats->slot_bytes = _slot_bytes(hashmap);
+    stats->arena_bytes = hashmap->mapping ? hashmap->arena.len : hashmap->arena.capa;
+    // Key arena of a mapped file has zero capacity
+    stats->allocated_bytes = sizeof *hashmap + (size_t)MAP_TEMP_SLOTS * hashmap->sz_slot +
+        hashmap->arena.capa + (hashmap->fixed_slots ? 0 : stats->table_bytes);
+}
+
+static void _traverse_table_slots(struct HashMap *hashmap, void *slots, u32 ex_capa) {
+    struct Table const table = _table(hashmap, slots, ex_capa);
+
+    for (size_t j=0; j<=table.mask; ++j) {
+        struct Bucket *bucket = _bucket_at(&table, j);
+
+        fprintf(stdout, "Bucket address: %p\n", (void *)bucket);
+
+        if (BUCKET_IS_TAKEN(bucket->meta_data)) {
+            fprintf(stdout, "Bucket taken, psl == %u\n", (u32)META_GET_PSL(bucket->meta_data));
+
+            if (hashmap->key_type == HASHMAP_KEY_U64) {
+                u64 key;
+                memcpy(&key, _key_at(&table, j), sizeof key);
+                fprintf(stdout, "Key: %llu\n", (unsigned long long)key);
+            } else {
+                char key_buffer[MAP_MAX_KEY_BYTES];
+                fprintf(stdout, "Key: %s\n", _key_str(hashmap, _key_at(&table, j), key_buffer));
+            }
         } else {
             fprintf(stdout, "Bucket is free\n");
         }
@@ -597,3 +2278,12 @@ void traverse_hashmap_slots(struct HashMap *hashmap) {
     
     fprintf(stdout, "\n\n");
 }
+
+void traverse_hashmap_slots(struct HashMap *hashmap) {
+    _traverse_table_slots(hashmap, hashmap->slots, hashmap->ex_capa);
+
+    if (hashmap->old_slots) {
+        fprintf(stdout, "Slots not yet migrated:\n");
+        _traverse_table_slots(hashmap, hashmap->old_slots, hashmap->old_ex_capa);
+    }
+}
@@ -1,11 +1,24 @@
 #ifndef __MAP__
 #define __MAP__
 
+#include <stdatomic.h>
+
 #include "common.h"
 #include "siphash.h"
+#include "probe.h"
+#include "hashmap.h"
 
 #define MAP_INIT_EXP_CAPACITY 4
+
+typedef u64 (*hash_func_type)(void const *data, size_t data_len, u8 const key[HASH_RAND_KEY_LEN]);
+
+#ifdef HASHMAP_WIDE_HASH
+#define MAP_MAX_EXP_CAPACITY 32
+#else
 #define MAP_MAX_EXP_CAPACITY 20
+#endif
+
+#define MAP_CAPACITY(ex_capa) ((size_t)1 << (ex_capa))
 
 #define META_VALUE_SET(meta_data, value, offset, mask) \
     (((meta_data) & ~(mask)) | ((value) << (offset)))
@@ -14,27 +27,107 @@
 
 typedef void (*clean_func_type)(void *);
 
+/*
+Key arena, keys are stored back to back with null terminators.
+
+data: starting address of the arena.
+len: count of bytes in use, including keys that have been removed.
+capa: count of allocated bytes.
+dead: count of bytes that belong to removed keys.
+*/
+struct KeyArena {
+    char *data;
+    size_t len;
+    size_t capa;
+    size_t dead;
+};
+
+/*
+Table pointers of a hash map, enough to look up keys without reading the HashMap struct
+members that change on resizing.
+*/
+struct MapView {
+    void *slots;
+    u32 ex_capa;
+    void *old_slots;
+    u32 old_ex_capa;
+};
+
+/*
+Operation counters of a hash map, kept only when compiled with `HASHMAP_STATS`. See
+HashMapStats for the meaning of the counters. Counters are atomic and updated with relaxed
+ordering, as lookups counted by them may run concurrently on a hash map shared read-only.
+*/
+struct MapStats {
+    _Atomic u64 get_hits;
+    _Atomic u64 get_misses;
+    _Atomic u64 inserts;
+    _Atomic u64 updates;
+    _Atomic u64 removes;
+    _Atomic u64 displacements;
+    _Atomic u64 backward_shifts;
+    _Atomic u64 resizes_up;
+    _Atomic u64 resizes_down;
+    _Atomic u64 resize_ns;
+};
+
 /*
 Memory layout: meta data (bucket) | key | user data ... | meta data | key | user data.
 
 A slot consists of one meta data unit, key and user data item. Hash map will have 
 N slots, 2**`MAP_INIT_EXP_CAPACITY` by default and 2**`MAP_MAX_EXP_CAPACITY` at max.
-Meta data struct size is fixed to 4 bytes and key (which the end user uses to map to 
-the data) to `MAP_MAX_KEY_BYTES` bytes.
+Meta data struct size is fixed to 4 bytes (8 bytes if compiled with `HASHMAP_WIDE_HASH`)
+and key (which the end user uses to map to the data) to `MAP_MAX_KEY_BYTES` bytes.
 
 Members of HashMap struct:
 
 ex_capa: exponent e for the power of two (2^e) which gives the total capacity.
 occ_slots: count of occupied slots.
 sz_bucket: size of the meta data struct in bytes.
-sz_key: maximal size of the key in bytes (null terminator must be included for this size).
+sz_key: size of the key field in bytes. Maximal inline key size is `MAP_MAX_KEY_BYTES` - 1, the
+    last byte holds the key length. The field gets padded when data items would be misaligned.
 sz_item: data size, defined at initialization.
-sz_slot: slot size in bytes (a slot is given by one meta data unit, key and user data item).
+sz_slot: slot size in bytes (a slot is given by one meta data unit, key and user data item),
+    padded to the alignment of the meta data and of the data items.
+item_align: alignment of the data items given by `packing`, data items of the split layout
+    are placed `sz_item` rounded up to it apart.
 rand_key: random key used for the hash function.
 slots: starting address for the slots.
-_temp: starting address for the garbage data used internally by the hash map.
+_temp: starting address for the garbage data used internally by the hash map. The first slot
+    holds the data item returned by `hmap_remove`, the other two hold slots in flight during
+    placement if they are too large for the stack.
 clean_func: a function pointer doing necessary cleaning for user data. By default,
     this will be internally NULL and the hashmap will use basic `free` to do the cleaning.
+incremental: if true, resizing migrates slots gradually instead of all at once.
+old_slots: starting address for the slots being migrated, NULL if no resize is in progress.
+old_ex_capa: exponent for the capacity of the slots being migrated.
+old_occ_slots: count of occupied slots not yet migrated (included in `occ_slots`).
+migrate_idx: index of the next old slot to be migrated.
+probe: group scanning function for lookups, SIMD accelerated when the CPU supports it.
+long_keys: if true, keys longer than `MAP_MAX_KEY_BYTES` - 1 bytes are stored to `arena`.
+arena: storage for the long keys, keys are referred from their key fields by offset.
+key_type: type of the keys, string keys use a key field of `MAP_MAX_KEY_BYTES` bytes
+    and integer keys one of 8 bytes (both padded for data item alignment).
+packing: alignment policy of the data items, see HashMapPacking.
+hash_func: hash function of the keys, called with `rand_key`. NULL for integer keys hashed
+    by the default mixer, which is inlined to the map operations.
+layout: memory layout of the slots. With the split layout `slots` holds the meta data array
+    followed by the key and data item arrays, `sz_slot` still describes the temporary slots.
+retire_func: if not NULL, slots replaced by a resize are handed to this function with
+    `retire_ctx` and their capacity exponent instead of freeing them, as lock-free readers
+    may still be reading them. They must be freed later by `hmap_free_slots`.
+allocator: memory allocator of the struct, slots, temporary slots and key arena. Functions
+    left NULL select the C library allocator.
+max_load: upper load factor, the capacity is doubled when an insertion would exceed it.
+min_load: lower load factor, removals falling to it shrink the capacity unless `shrink` forbids.
+shrink: policy for shrinking the capacity on removals, see HashMapShrink.
+huge_pages: if true, slots of at least 2 MiB bypass `allocator` and
+    are mapped with mmap and advised to be backed by transparent huge pages (Linux only).
+fixed_slots: if true, `slots` are memory of the caller (e.g. a shared memory region), the
+    capacity never changes and insertions fail once the upper load factor is reached.
+mapping: if not NULL, `slots` and `arena` point into this read-only mapping of a snapshot
+    file of `mapping_bytes` bytes, and all modifications of the hash map are rejected.
+stats: operation counters, present only when compiled with `HASHMAP_STATS`.
 */
 struct HashMap {
     u32 ex_capa;
@@ -43,23 +136,106 @@ struct HashMap {
     u32 sz_key;
     u32 sz_item;
     u32 sz_slot;
+    u32 item_align;
     u8 rand_key[HASH_RAND_KEY_LEN];
     void *slots;
     void *_temp;
     void (*clean_func)(void *);
+    bool incremental;
+    void *old_slots;
+    u32 old_ex_capa;
+    u32 old_occ_slots;
+    size_t migrate_idx;
+    struct Probe probe;
+    enum HashMapLayout layout;
+    bool long_keys;
+    struct KeyArena arena;
+    enum HashMapKeyType key_type;
+    enum HashMapPacking packing;
+    hash_func_type hash_func;
+    void (*retire_func)(void *, void *, u32);
+    void *retire_ctx;
+    struct HashMapAllocator allocator;
+    bool huge_pages;
+    f64 max_load;
+    f64 min_load;
+    enum HashMapShrink shrink;
+    bool fixed_slots;
+    void *mapping;
+    size_t mapping_bytes;
+#ifdef HASHMAP_STATS
+    struct MapStats stats;
+#endif
 };
 
 struct HashMap* hmap_init(size_t item_size, u32 init_capa, void (*clean_func)(void *));
+struct HashMap* hmap_init_ex(struct HashMapConfig const *config, u32 init_capa);
 void hmap_free(struct HashMap *hashmap);
+void hmap_free_slots(struct HashMap const *hashmap, void *slots, u32 ex_capa);
+size_t hmap_slots_bytes(struct HashMap const *hashmap, u32 ex_capa);
+bool hmap_reserve_key_arena(struct HashMap *hashmap, size_t bytes);
+void hmap_attach_slots(struct HashMap *hashmap, void *slots, u32 ex_capa);
+void hmap_attach_mapping(
+    struct HashMap *hashmap,
+    void *mapping,
+    size_t mapping_bytes,
+    void *slots,
+    u32 ex_capa,
+    char *arena,
+    size_t arena_bytes);
+void hmap_finish_migration(struct HashMap *hashmap);
 
 void* hmap_get(struct HashMap *hashmap, char const *key);
 bool hmap_insert(struct HashMap *hashmap, char const *key, void const *data);
 void* hmap_remove(struct HashMap *hashmap, char const *key);
+void* hmap_get_n(struct HashMap *hashmap, void const *key, size_t len);
+bool hmap_insert_n(struct HashMap *hashmap, void const *key, size_t len, void const *data);
+void* hmap_remove_n(struct HashMap *hashmap, void const *key, size_t len);
+bool hmap_remove_into(struct HashMap *hashmap, char const *key, void *item);
+bool hmap_remove_into_n(struct HashMap *hashmap, void const *key, size_t len, void *item);
+void* hmap_get_u64(struct HashMap *hashmap, u64 key);
+bool hmap_insert_u64(struct HashMap *hashmap, u64 key, void const *data);
+void* hmap_remove_u64(struct HashMap *hashmap, u64 key);
+void hmap_view(struct HashMap const *hashmap, struct MapView *view);
+void* hmap_get_view(
+    struct HashMap *hashmap,
+    struct MapView const *view,
+    void const *key,
+    size_t len,
+    u64 hash);
+// Hash once and pass the hash to the map, `hash` must be the full result of `hmap_hash`
+u64 hmap_hash(struct HashMap const *hashmap, void const *key, size_t len);
+void* hmap_get_hashed(struct HashMap *hashmap, void const *key, size_t len, u64 hash);
+bool hmap_insert_hashed(
+    struct HashMap *hashmap,
+    void const *key,
+    size_t len,
+    u64 hash,
+    void const *data);
+bool hmap_remove_hashed(struct HashMap *hashmap, void const *key, size_t len, u64 hash, void *item);
+size_t hmap_get_batch(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    size_t count,
+    void *items[]);
+size_t hmap_insert_batch(
+    struct HashMap *hashmap,
+    char const *const keys[],
+    size_t count,
+    void const *const data[]);
+size_t hmap_remove_batch(struct HashMap *hashmap, char const *const keys[], size_t count, void *items);
+bool hmap_iter_apply_u64(struct HashMap *hashmap, bool (*callback)(u64, void *));
 bool hmap_iter_apply(struct HashMap *hashmap, bool (*callback)(char const *, void *));
 u32 hmap_len(struct HashMap *hashmap);
+bool hmap_shrink_to_fit(struct HashMap *hashmap);
+bool hmap_reserve(struct HashMap *hashmap, size_t elems);
+size_t hmap_build(struct HashMap *hashmap, char const *const keys[], void const *items, size_t count);
+u32 hmap_init_capa_for(struct HashMapConfig const *config, size_t elems);
 
 void traverse_hashmap_slots(struct HashMap *hashmap);
 void hmap_show_stats(struct HashMap *hashmap);
+bool hmap_get_stats(struct HashMap *hashmap, struct HashMapStats *stats);
+void hmap_get_layout_stats(struct HashMap *hashmap, struct HashMapLayoutStats *stats);
 
 // Following are meant only for testing the hash map
 bool get_random_key(u8 *buffer, size_t buffer_len);
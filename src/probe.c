@@ -0,0 +1,183 @@
+#include "probe.h"
+#include "bucket.h"
+
+#if !defined(HASHMAP_WIDE_HASH) && defined(__x86_64__) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define PROBE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+#define PROBE_SCALAR_WIDTH 4
+#define PROBE_SSE2_WIDTH 4
+#define PROBE_AVX2_WIDTH 8
+
+static inline bucket_meta_type _meta_at(u8 const *slots, size_t stride, size_t idx) {
+    return ((struct Bucket const *)(slots + stride * idx))->meta_data;
+}
+
+static struct ProbeResult _probe_group_scalar(
+    u8 const *slots,
+    size_t stride,
+    size_t idx,
+    size_t mask,
+    u32 psl,
+    u64 hash)
+{
+    struct ProbeResult result = {.match_mask=0, .stop=PROBE_SCALAR_WIDTH};
+
+    for (u32 i=0; i<PROBE_SCALAR_WIDTH; ++i) {
+        bucket_meta_type const meta_data = _meta_at(slots, stride, (idx + i) & mask);
+
+        if (!BUCKET_IS_TAKEN(meta_data) || META_GET_PSL(meta_data) < psl + i) {
+            result.stop = i;
+            break;
+        }
+        if (META_GET_HASH(meta_data) == hash) {
+            result.match_mask |= 1U << i;
+        }
+    }
+    return result;
+}
+
+#ifdef PROBE_X86_SIMD
+
+/*
+SIMD variants decode the meta data of all lanes at once. A lane ends the probe if
+its taken bit is zero or its PSL is smaller than the expected `psl + lane`, and
+matches if its truncated hash equals `hash`. PSL and hash fields are at most 20 bits
+so signed 32-bit comparisons are safe.
+*/
+static struct ProbeResult _probe_result_from_masks(u32 stop_mask, u32 match_mask, u32 width) {
+    u32 const stop = (u32)__builtin_ctz(stop_mask | (1U << width));
+    struct ProbeResult result = {.match_mask=match_mask & ((1U << stop) - 1), .stop=stop};
+    return result;
+}
+
+static struct ProbeResult _probe_group_sse2(
+    u8 const *slots,
+    size_t stride,
+    size_t idx,
+    size_t mask,
+    u32 psl,
+    u64 hash)
+{
+    __m128i metas;
+
+    if (stride == sizeof(struct Bucket) && idx + PROBE_SSE2_WIDTH <= mask + 1) {
+        // Dense meta data without wrap around, load all lanes at once
+        metas = _mm_loadu_si128((__m128i const *)(slots + stride * idx));
+    } else {
+        metas = _mm_set_epi32(
+            (i32)_meta_at(slots, stride, (idx + 3) & mask),
+            (i32)_meta_at(slots, stride, (idx + 2) & mask),
+            (i32)_meta_at(slots, stride, (idx + 1) & mask),
+            (i32)_meta_at(slots, stride, idx)
+        );
+    }
+    __m128i const taken = _mm_and_si128(metas, _mm_set1_epi32(BUCKET_TAKEN_MASK));
+    __m128i const psls = _mm_srli_epi32(
+        _mm_and_si128(metas, _mm_set1_epi32(BUCKET_PSL_MASK)), BUCKET_PSL_OFFSET
+    );
+    __m128i const hashes = _mm_srli_epi32(metas, BUCKET_HASH_OFFSET);
+    __m128i const expected = _mm_add_epi32(_mm_set1_epi32((i32)psl), _mm_set_epi32(3, 2, 1, 0));
+
+    __m128i const stops = _mm_or_si128(
+        _mm_cmpeq_epi32(taken, _mm_setzero_si128()),
+        _mm_cmplt_epi32(psls, expected)
+    );
+    __m128i const matches = _mm_cmpeq_epi32(hashes, _mm_set1_epi32((i32)hash));
+
+    return _probe_result_from_masks(
+        (u32)_mm_movemask_ps(_mm_castsi128_ps(stops)),
+        (u32)_mm_movemask_ps(_mm_castsi128_ps(matches)),
+        PROBE_SSE2_WIDTH
+    );
+}
+
+__attribute__((target("avx2")))
+static struct ProbeResult _probe_group_avx2(
+    u8 const *slots,
+    size_t stride,
+    size_t idx,
+    size_t mask,
+    u32 psl,
+    u64 hash)
+{
+    __m256i metas;
+
+    if (stride == sizeof(struct Bucket) && idx + PROBE_AVX2_WIDTH <= mask + 1) {
+        metas = _mm256_loadu_si256((__m256i const *)(slots + stride * idx));
+    } else {
+        metas = _mm256_set_epi32(
+            (i32)_meta_at(slots, stride, (idx + 7) & mask),
+            (i32)_meta_at(slots, stride, (idx + 6) & mask),
+            (i32)_meta_at(slots, stride, (idx + 5) & mask),
+            (i32)_meta_at(slots, stride, (idx + 4) & mask),
+            (i32)_meta_at(slots, stride, (idx + 3) & mask),
+            (i32)_meta_at(slots, stride, (idx + 2) & mask),
+            (i32)_meta_at(slots, stride, (idx + 1) & mask),
+            (i32)_meta_at(slots, stride, idx)
+        );
+    }
+    __m256i const taken = _mm256_and_si256(metas, _mm256_set1_epi32(BUCKET_TAKEN_MASK));
+    __m256i const psls = _mm256_srli_epi32(
+        _mm256_and_si256(metas, _mm256_set1_epi32(BUCKET_PSL_MASK)), BUCKET_PSL_OFFSET
+    );
+    __m256i const hashes = _mm256_srli_epi32(metas, BUCKET_HASH_OFFSET);
+    __m256i const expected = _mm256_add_epi32(
+        _mm256_set1_epi32((i32)psl), _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0)
+    );
+
+    __m256i const stops = _mm256_or_si256(
+        _mm256_cmpeq_epi32(taken, _mm256_setzero_si256()),
+        _mm256_cmpgt_epi32(expected, psls)
+    );
+    __m256i const matches = _mm256_cmpeq_epi32(hashes, _mm256_set1_epi32((i32)hash));
+
+    return _probe_result_from_masks(
+        (u32)_mm256_movemask_ps(_mm256_castsi256_ps(stops)),
+        (u32)_mm256_movemask_ps(_mm256_castsi256_ps(matches)),
+        PROBE_AVX2_WIDTH
+    );
+}
+
+static bool _cpu_supports_avx2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif // PROBE_X86_SIMD
+
+/*
+Select a group scanning implementation.
+
+`PROBE_IMPL_AUTO` picks the widest implementation supported by the running CPU
+and always succeeds. Other values request a specific implementation, false is
+returned if it is not available on this platform or build (the wide hash mode
+supports only the scalar implementation).
+*/
+bool probe_select(enum ProbeImpl impl, struct Probe *probe) {
+#ifdef PROBE_X86_SIMD
+    bool const has_avx2 = _cpu_supports_avx2();
+
+    if (impl == PROBE_IMPL_AUTO) {
+        impl = has_avx2 ? PROBE_IMPL_AVX2 : PROBE_IMPL_SSE2;
+    }
+    switch (impl) {
+    case PROBE_IMPL_AVX2:
+        if (!has_avx2) return false;
+        *probe = (struct Probe){_probe_group_avx2, PROBE_AVX2_WIDTH, PROBE_IMPL_AVX2};
+        return true;
+    case PROBE_IMPL_SSE2:
+        *probe = (struct Probe){_probe_group_sse2, PROBE_SSE2_WIDTH, PROBE_IMPL_SSE2};
+        return true;
+    default:
+        break;
+    }
+#endif
+    if (impl != PROBE_IMPL_AUTO && impl != PROBE_IMPL_SCALAR) {
+        return false;
+    }
+    *probe = (struct Probe){_probe_group_scalar, PROBE_SCALAR_WIDTH, PROBE_IMPL_SCALAR};
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef __PROBE__
+#define __PROBE__
+
+#include "common.h"
+
+#define PROBE_MAX_GROUP_WIDTH 8
+
+/*
+Result of scanning a group of consecutive buckets of a probe sequence.
+
+match_mask: bit i is set if the i:th bucket of the group holds the searched truncated hash.
+    Only buckets preceding `stop` are considered.
+stop: index of the first bucket that ends the probe sequence (bucket is free or its
+    PSL is smaller than the distance probed so far), or the group width if none did.
+*/
+struct ProbeResult {
+    u32 match_mask;
+    u32 stop;
+};
+
+/*
+Scan one group of buckets starting at index `idx`. Bucket i of the group is located
+at `slots + stride * ((idx + i) & mask)` and its expected PSL is `psl + i`.
+*/
+typedef struct ProbeResult (*probe_group_func_type)(
+    u8 const *slots,
+    size_t stride,
+    size_t idx,
+    size_t mask,
+    u32 psl,
+    u64 hash
+);
+
+enum ProbeImpl {
+    PROBE_IMPL_AUTO,
+    PROBE_IMPL_SCALAR,
+    PROBE_IMPL_SSE2,
+    PROBE_IMPL_AVX2,
+};
+
+/*
+Group scanning function and the count of buckets it scans per call.
+*/
+struct Probe {
+    probe_group_func_type scan;
+    u32 width;
+    enum ProbeImpl impl;
+};
+
+bool probe_select(enum ProbeImpl impl, struct Probe *probe);
+
+#endif // __PROBE__
@@ -0,0 +1,327 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sharded.h"
+
+// Lock-free lookup attempts before falling back to the shard lock
+#define SMAP_READ_ATTEMPTS 64
+// A modification retires at most two slot arrays (finishing a migration and resizing) and a view
+#define SMAP_RETIRE_RESERVE 4
+
+
+static u32 _shard_bits(u32 shard_count) {
+    u32 bits = 0;
+
+    while (((u32)1 << bits) < shard_count) {
+        bits += 1;
+    }
+    return bits;
+}
+
+size_t smap_shard_count(size_t shard_count) {
+    if (shard_count == 0) return SMAP_DEFAULT_SHARDS;
+    if (shard_count > SMAP_MAX_SHARDS) return shard_count;
+
+    return (size_t)1 << _shard_bits((u32)shard_count);
+}
+
+static inline struct Shard* _shard_of(struct ShardedHashMap const *smap, u64 hash) {
+    // Highest bits of the hash, these are dropped from the truncated hash of the buckets
+    size_t const idx = smap->shard_bits == 0 ? 0 : hash >> (64 - smap->shard_bits);
+
+    return &smap->shards[idx];
+}
+
+static void _free_retired_slots(void *map, void *slots, size_t ex_capa) {
+    hmap_free_slots(map, slots, (u32)ex_capa);
+}
+
+static void _retire_slots(void *shard, void *slots, u32 ex_capa) {
+    struct Shard *owner = shard;
+
+    // Slots come from the allocator of the shard map, which outlives its retire list
+    retire_push_with(&owner->retired, slots, _free_retired_slots, owner->map, ex_capa);
+}
+
+static void _smap_free_shards(struct ShardedHashMap *smap, u32 count) {
+    for (u32 j=0; j<count; ++j) {
+        struct Shard *shard = &smap->shards[j];
+
+        pthread_rwlock_destroy(&shard->lock);
+        free(atomic_load(&shard->view));
+        free(shard->spare_view);
+        retire_free_all(&shard->retired);
+        hmap_free(shard->map);
+    }
+    free(smap->shards);
+    free(smap);
+}
+
+static bool _shard_init(struct ShardedHashMap *smap, struct Shard *shard, struct HashMapConfig const *config, u32 init_capa) {
+    memset(shard, 0, sizeof *shard);
+
+    shard->map = hmap_init_ex(config, init_capa);
+    if (shard->map == NULL) {
+        return false;
+    }
+    if (smap->lock_free_reads) {
+        struct MapView *view = malloc(sizeof *view);
+        if (view == NULL) {
+            hmap_free(shard->map);
+            return false;
+        }
+        hmap_view(shard->map, view);
+        atomic_init(&shard->view, view);
+        atomic_init(&shard->seq, 0);
+
+        shard->map->retire_func = _retire_slots;
+        shard->map->retire_ctx = shard;
+    }
+    if (pthread_rwlock_init(&shard->lock, NULL) != 0) {
+        free(atomic_load(&shard->view));
+        hmap_free(shard->map);
+        return false;
+    }
+    return true;
+}
+
+struct ShardedHashMap* smap_init(struct HashMapConfig const *config, size_t shard_count, u32 init_capa) {
+    if (config->key_type != HASHMAP_KEY_STRING) {
+        fprintf(stderr, "Sharded hash maps support only string keys.\n");
+        return NULL;
+    }
+    if (config->lock_free_reads && config->long_keys) {
+        fprintf(stderr, "Lock-free reads are not available with long keys.\n");
+        return NULL;
+    }
+    if (shard_count == 0) {
+        shard_count = SMAP_DEFAULT_SHARDS;
+    } else if (shard_count > SMAP_MAX_SHARDS) {
+        fprintf(stderr, "Cannot use more than %u shards.\n", SMAP_MAX_SHARDS);
+        return NULL;
+    }
+
+    struct ShardedHashMap *smap = calloc(1, sizeof(struct ShardedHashMap));
+    if (smap == NULL) return NULL;
+
+    smap->shard_bits = _shard_bits(shard_count);
+    smap->shard_count = (u32)1 << smap->shard_bits;
+    smap->lock_free_reads = config->lock_free_reads;
+    smap->shards = aligned_alloc(SMAP_CACHE_LINE_BYTES, smap->shard_count * sizeof(struct Shard));
+
+    if (smap->shards == NULL) {
+        free(smap);
+        return NULL;
+    }
+
+    for (u32 j=0; j<smap->shard_count; ++j) {
+        if (!_shard_init(smap, &smap->shards[j], config, init_capa)) {
+            _smap_free_shards(smap, j);
+            return NULL;
+        }
+        if (j > 0) {
+            // Shards must agree on the hash of a key, the maps are still empty
+            memcpy(smap->shards[j].map->rand_key, smap->shards[0].map->rand_key, HASH_RAND_KEY_LEN);
+        }
+    }
+    smap->sz_item = smap->shards[0].map->sz_item;
+
+    return smap;
+}
+
+void smap_free(struct ShardedHashMap *smap) {
+    if (smap != NULL) {
+        _smap_free_shards(smap, smap->shard_count);
+    }
+}
+
+/*
+Lock the shard for a modification. With lock-free reads the sequence counter is made odd,
+which makes concurrent readers retry, and the memory needed to publish the modification
+is reserved beforehand. Returns false if that memory cannot be allocated.
+*/
+static bool _shard_write_begin(struct ShardedHashMap const *smap, struct Shard *shard) {
+    pthread_rwlock_wrlock(&shard->lock);
+
+    if (!smap->lock_free_reads) return true;
+
+    if (shard->spare_view == NULL) {
+        shard->spare_view = malloc(sizeof(struct MapView));
+    }
+    if (shard->spare_view == NULL || !retire_reserve(&shard->retired, SMAP_RETIRE_RESERVE)) {
+        pthread_rwlock_unlock(&shard->lock);
+        fprintf(stderr, "Cannot allocate memory for a shard modification.\n");
+        return false;
+    }
+    u64 const seq = atomic_load_explicit(&shard->seq, memory_order_relaxed);
+    atomic_store_explicit(&shard->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    return true;
+}
+
+/*
+Publish the table pointers of the shard map if a resize changed them. The replaced view
+and slots are retired with an epoch taken after the new view became visible, so only
+readers that may have loaded the old view delay their freeing.
+*/
+static void _shard_publish(struct Shard *shard) {
+    struct MapView *view = atomic_load_explicit(&shard->view, memory_order_relaxed);
+    struct MapView current;
+    hmap_view(shard->map, &current);
+
+    if (current.slots != view->slots || current.ex_capa != view->ex_capa ||
+        current.old_slots != view->old_slots || current.old_ex_capa != view->old_ex_capa)
+    {
+        *shard->spare_view = current;
+        atomic_store(&shard->view, shard->spare_view);
+        shard->spare_view = NULL;
+        retire_push(&shard->retired, view);
+    }
+    if (shard->retired.pending > 0) {
+        retire_tag_pending(&shard->retired, epoch_advance());
+    }
+}
+
+static void _shard_write_end(struct ShardedHashMap const *smap, struct Shard *shard) {
+    if (smap->lock_free_reads) {
+        _shard_publish(shard);
+
+        u64 const seq = atomic_load_explicit(&shard->seq, memory_order_relaxed);
+        atomic_store_explicit(&shard->seq, seq + 1, memory_order_release);
+
+        retire_reclaim(&shard->retired);
+    }
+    pthread_rwlock_unlock(&shard->lock);
+}
+
+/*
+Look up a key without locking. The lookup is retried as long as a writer is active or
+the sequence counter changed during it. Returns false if no consistent lookup was made
+within `SMAP_READ_ATTEMPTS` attempts, otherwise sets `found`.
+
+Tables are read while a writer may modify them, but the view of the table pointers stays
+allocated until this reader exits its epoch and all indices are masked to the table
+capacity, so a torn read is only ever a wrong result that fails the validation.
+
+The slots are read with plain loads on purpose. Those reads race with the writer in the
+sense of C11 and ThreadSanitizer reports them, but nothing read is used before the
+validation. Making them atomic would require atomic stores on every slot write of the hash
+map. `test/tsan.supp` suppresses the reports of this function and `_shmap_get_lock_free`.
+*/
+static bool _shard_get_lock_free(
+    struct ShardedHashMap const *smap,
+    struct Shard *shard,
+    char const *key,
+    size_t len,
+    u64 hash,
+    void *item,
+    bool *found)
+{
+    if (!epoch_enter()) return false;
+
+    bool validated = false;
+
+    for (u32 attempt=0; attempt<SMAP_READ_ATTEMPTS && !validated; ++attempt) {
+        u64 const seq = atomic_load_explicit(&shard->seq, memory_order_acquire);
+        if (seq & 1) continue;
+
+        struct MapView const *view = atomic_load(&shard->view);
+        void const *data = hmap_get_view(shard->map, view, key, len, hash);
+        if (data != NULL && item != NULL) {
+            memcpy(item, data, smap->sz_item);
+        }
+        atomic_thread_fence(memory_order_acquire);
+
+        if (atomic_load_explicit(&shard->seq, memory_order_relaxed) == seq) {
+            *found = data != NULL;
+            validated = true;
+        }
+    }
+    epoch_exit();
+
+    return validated;
+}
+
+bool smap_insert(struct ShardedHashMap *smap, char const *key, void const *data) {
+    if (key == NULL) return false;
+
+    size_t const len = strlen(key);
+    u64 const hash = hmap_hash(smap->shards[0].map, key, len);
+    struct Shard *shard = _shard_of(smap, hash);
+
+    if (!_shard_write_begin(smap, shard)) return false;
+    bool const inserted = hmap_insert_hashed(shard->map, key, len, hash, data);
+    _shard_write_end(smap, shard);
+
+    return inserted;
+}
+
+bool smap_get(struct ShardedHashMap *smap, char const *key, void *item) {
+    if (key == NULL) return false;
+
+    size_t const len = strlen(key);
+    u64 const hash = hmap_hash(smap->shards[0].map, key, len);
+    struct Shard *shard = _shard_of(smap, hash);
+
+    bool found = false;
+    if (smap->lock_free_reads && _shard_get_lock_free(smap, shard, key, len, hash, item, &found)) {
+        return found;
+    }
+
+    // Data item is copied while the lock is held, a pointer to it would not stay valid
+    pthread_rwlock_rdlock(&shard->lock);
+    void const *data = hmap_get_hashed(shard->map, key, len, hash);
+    if (data != NULL && item != NULL) {
+        memcpy(item, data, smap->sz_item);
+    }
+    pthread_rwlock_unlock(&shard->lock);
+
+    return data != NULL;
+}
+
+bool smap_remove(struct ShardedHashMap *smap, char const *key, void *item) {
+    if (key == NULL) return false;
+
+    size_t const len = strlen(key);
+    u64 const hash = hmap_hash(smap->shards[0].map, key, len);
+    struct Shard *shard = _shard_of(smap, hash);
+
+    if (!_shard_write_begin(smap, shard)) return false;
+    bool const removed = hmap_remove_hashed(shard->map, key, len, hash, item);
+    _shard_write_end(smap, shard);
+
+    return removed;
+}
+
+bool smap_iter_apply(struct ShardedHashMap *smap, bool (*callback)(char const *, void *)) {
+    if (callback == NULL) return false;
+
+    for (u32 j=0; j<smap->shard_count; ++j) {
+        struct Shard *shard = &smap->shards[j];
+
+        // Callback may modify the data items
+        if (!_shard_write_begin(smap, shard)) return false;
+        bool const completed = hmap_iter_apply(shard->map, callback);
+        _shard_write_end(smap, shard);
+
+        if (!completed) return false;
+    }
+    return true;
+}
+
+size_t smap_len(struct ShardedHashMap *smap) {
+    size_t len = 0;
+
+    for (u32 j=0; j<smap->shard_count; ++j) {
+        struct Shard *shard = &smap->shards[j];
+
+        pthread_rwlock_rdlock(&shard->lock);
+        len += hmap_len(shard->map);
+        pthread_rwlock_unlock(&shard->lock);
+    }
+    return len;
+}
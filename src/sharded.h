@@ -0,0 +1,69 @@
+#ifndef __SHARDED__
+#define __SHARDED__
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "common.h"
+#include "map.h"
+#include "epoch.h"
+
+#define SMAP_DEFAULT_SHARDS 16
+#define SMAP_MAX_SHARDS 256
+#define SMAP_CACHE_LINE_BYTES 64
+
+/*
+Shard of a sharded hash map, aligned to a cache line of its own so that the locks of
+neighbouring shards do not share a line.
+
+lock: reader-writer lock guarding the shard map, lookups share it and
+    modifications (which also use the scratch slots of the map) hold it exclusively.
+    With lock-free reads only writers take it, and readers if they fail to validate.
+seq: sequence counter for lock-free reads, odd while a writer modifies the shard.
+view: table pointers of the shard map published for lock-free reads.
+spare_view: view allocated in advance so that publishing a view cannot fail.
+retired: slots and views replaced by writers but possibly still read by readers.
+map: hash map holding the keys whose hash falls to this shard.
+*/
+struct Shard {
+    _Alignas(SMAP_CACHE_LINE_BYTES) pthread_rwlock_t lock;
+    _Atomic u64 seq;
+    struct MapView *_Atomic view;
+    struct MapView *spare_view;
+    struct RetireList retired;
+    struct HashMap *map;
+};
+
+/*
+Hash map split to independent shards by the highest bits of the key hash.
+
+All shard maps use the same random key and hash function, so the hash of a key is
+computed only once. The bits used for shard selection are not part of the truncated
+hash stored to the buckets, so keys of one shard still spread over all of its buckets.
+
+shard_bits: count of hash bits selecting the shard.
+shard_count: count of the shards, 2^`shard_bits`.
+sz_item: data size, defined at initialization.
+lock_free_reads: if true, lookups take no lock and are validated by the shard `seq`.
+shards: array of the shards.
+*/
+struct ShardedHashMap {
+    u32 shard_bits;
+    u32 shard_count;
+    u32 sz_item;
+    bool lock_free_reads;
+    struct Shard *shards;
+};
+
+// Count of shards actually used for a requested `shard_count`, rounded up to a power of two
+size_t smap_shard_count(size_t shard_count);
+struct ShardedHashMap* smap_init(struct HashMapConfig const *config, size_t shard_count, u32 init_capa);
+void smap_free(struct ShardedHashMap *smap);
+
+bool smap_insert(struct ShardedHashMap *smap, char const *key, void const *data);
+bool smap_get(struct ShardedHashMap *smap, char const *key, void *item);
+bool smap_remove(struct ShardedHashMap *smap, char const *key, void *item);
+bool smap_iter_apply(struct ShardedHashMap *smap, bool (*callback)(char const *, void *));
+size_t smap_len(struct ShardedHashMap *smap);
+
+#endif // __SHARDED__
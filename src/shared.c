@@ -0,0 +1,343 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "shared.h"
+#include "bucket.h"
+
+// Lock-free lookup attempts before falling back to the lock
+#define SHMAP_READ_ATTEMPTS 64
+
+
+static size_t _slots_offset() {
+    size_t const line = SHMAP_CACHE_LINE_BYTES;
+
+    return (sizeof(struct SharedHeader) + line - 1) / line * line;
+}
+
+static bool _config_is_shareable(struct HashMapConfig const *config) {
+    if (config->key_type != HASHMAP_KEY_STRING) {
+        fprintf(stderr, "Shared hash maps support only string keys.\n");
+        return false;
+    }
+    // Key arena and migrated slots would live outside the region
+    if (config->long_keys || config->incremental_resize) {
+        fprintf(stderr, "Long keys and incremental resizing are not available in shared memory.\n");
+        return false;
+    }
+    if (config->hash == HASHMAP_HASH_CUSTOM) {
+        fprintf(stderr, "Shared hash maps cannot use a custom hash function.\n");
+        return false;
+    }
+    return true;
+}
+
+/*
+Configuration of the hash map of a process. Capacity is fixed and data items are not
+owned by any single process, so the shrink policy and cleaning function are dropped.
+*/
+static struct HashMapConfig _process_config(struct HashMapConfig const *config) {
+    struct HashMapConfig process_config = *config;
+    process_config.clean_func = NULL;
+    process_config.shrink = HASHMAP_SHRINK_NEVER;
+    process_config.huge_pages = false;
+
+    return process_config;
+}
+
+static bool _region_is_aligned(void const *region) {
+    if ((uintptr_t)region % SHMAP_CACHE_LINE_BYTES != 0) {
+        fprintf(stderr, "Shared memory region must be aligned to %u bytes.\n", SHMAP_CACHE_LINE_BYTES);
+        return false;
+    }
+    return true;
+}
+
+size_t shmap_region_bytes(struct HashMapConfig const *config, size_t elems) {
+    if (!_config_is_shareable(config)) return 0;
+
+    u32 const ex_capa = hmap_init_capa_for(config, elems);
+    if (ex_capa > MAP_MAX_EXP_CAPACITY) {
+        fprintf(stderr, "Cannot allocate a hash map with capacity over 2^%u.\n", MAP_MAX_EXP_CAPACITY);
+        return 0;
+    }
+    struct HashMapConfig const process_config = _process_config(config);
+    struct HashMap *hashmap = hmap_init_ex(&process_config, MAP_INIT_EXP_CAPACITY);
+    if (hashmap == NULL) return 0;
+
+    size_t const bytes = _slots_offset() + hmap_slots_bytes(hashmap, ex_capa);
+    hmap_free(hashmap);
+
+    return bytes;
+}
+
+static struct SharedHashMap* _shmap_handle(struct SharedHeader *header, struct HashMap *hashmap) {
+    struct SharedHashMap *shmap = malloc(sizeof *shmap);
+    if (shmap == NULL) {
+        hmap_free(hashmap);
+        return NULL;
+    }
+    hmap_attach_slots(hashmap, (u8 *)header + header->slots_offset, header->ex_capa);
+    memcpy(hashmap->rand_key, header->rand_key, HASH_RAND_KEY_LEN);
+
+    shmap->header = header;
+    shmap->map = hashmap;
+
+    return shmap;
+}
+
+static bool _lock_init(pthread_mutex_t *lock) {
+    pthread_mutexattr_t attr;
+    if (pthread_mutexattr_init(&attr) != 0) return false;
+
+    bool initialised = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0;
+#ifdef SHMAP_ROBUST_LOCK
+    // Robust, a process dying with the lock held must not block the others for good
+    initialised = initialised && pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) == 0;
+#endif
+    initialised = initialised && pthread_mutex_init(lock, &attr) == 0;
+    pthread_mutexattr_destroy(&attr);
+
+    return initialised;
+}
+
+struct SharedHashMap* shmap_create(void *region, size_t region_bytes, struct HashMapConfig const *config) {
+    if (!_region_is_aligned(region) || !_config_is_shareable(config)) return NULL;
+
+    struct HashMapConfig const process_config = _process_config(config);
+    struct HashMap *hashmap = hmap_init_ex(&process_config, MAP_INIT_EXP_CAPACITY);
+    if (hashmap == NULL) return NULL;
+
+    // Largest capacity the region holds
+    size_t const offset = _slots_offset();
+    u32 ex_capa = MAP_INIT_EXP_CAPACITY;
+    if (region_bytes < offset + hmap_slots_bytes(hashmap, ex_capa)) {
+        fprintf(stderr, "Shared memory region is too small for a hash map.\n");
+        hmap_free(hashmap);
+        return NULL;
+    }
+    while (ex_capa < MAP_MAX_EXP_CAPACITY &&
+        region_bytes - offset >= hmap_slots_bytes(hashmap, ex_capa + 1))
+    {
+        ex_capa += 1;
+    }
+
+    struct SharedHeader *header = region;
+    memset(header, 0, offset);
+    memset((u8 *)region + offset, 0, hmap_slots_bytes(hashmap, ex_capa));
+
+    header->version = SHMAP_VERSION;
+    header->sz_bucket = hashmap->sz_bucket;
+    header->sz_key = hashmap->sz_key;
+    header->sz_item = hashmap->sz_item;
+    header->sz_slot = hashmap->sz_slot;
+    header->ex_capa = ex_capa;
+    header->layout = hashmap->layout;
+    header->hash = config->hash;
+    header->packing = hashmap->packing;
+    header->max_load = hashmap->max_load;
+    memcpy(header->rand_key, hashmap->rand_key, HASH_RAND_KEY_LEN);
+    header->slots_offset = offset;
+    atomic_init(&header->seq, 0);
+    atomic_init(&header->occ_slots, 0);
+
+    if (!_lock_init(&header->lock)) {
+        fprintf(stderr, "Cannot init the lock of a shared hash map.\n");
+        hmap_free(hashmap);
+        return NULL;
+    }
+    struct SharedHashMap *shmap = _shmap_handle(header, hashmap);
+    if (shmap == NULL) {
+        pthread_mutex_destroy(&header->lock);
+        return NULL;
+    }
+    // Header is complete before it becomes recognisable
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, SHMAP_MAGIC, SHMAP_MAGIC_BYTES);
+
+    return shmap;
+}
+
+struct SharedHashMap* shmap_attach(void *region, size_t region_bytes) {
+    if (!_region_is_aligned(region)) return NULL;
+
+    struct SharedHeader *header = region;
+    if (region_bytes < _slots_offset() || memcmp(header->magic, SHMAP_MAGIC, SHMAP_MAGIC_BYTES) != 0) {
+        fprintf(stderr, "Not a shared hash map region.\n");
+        return NULL;
+    }
+    atomic_thread_fence(memory_order_acquire);
+
+    if (header->version != SHMAP_VERSION || header->sz_bucket != sizeof(struct Bucket) ||
+        header->ex_capa > MAP_MAX_EXP_CAPACITY)
+    {
+        fprintf(stderr, "Shared hash map was created by an incompatible build.\n");
+        return NULL;
+    }
+    struct HashMapConfig const config = {
+        .item_size=header->sz_item,
+        .layout=header->layout,
+        .hash=header->hash,
+        .packing=header->packing,
+        .max_load_factor=header->max_load,
+        .shrink=HASHMAP_SHRINK_NEVER,
+    };
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    if (hashmap == NULL) return NULL;
+
+    if (hashmap->sz_slot != header->sz_slot || hashmap->sz_key != header->sz_key ||
+        region_bytes < header->slots_offset + hmap_slots_bytes(hashmap, header->ex_capa))
+    {
+        fprintf(stderr, "Shared hash map sizes do not match the region.\n");
+        hmap_free(hashmap);
+        return NULL;
+    }
+    return _shmap_handle(header, hashmap);
+}
+
+void shmap_detach(struct SharedHashMap *shmap) {
+    if (shmap != NULL) {
+        // Slots stay in the region for the other processes
+        hmap_free(shmap->map);
+        free(shmap);
+    }
+}
+
+/*
+Take the lock of the region. If its previous owner died during a modification, the
+interrupted modification may have lost the slot it was moving, and the slot count and
+sequence counter are repaired before the lock is made usable again. Without robust
+mutexes the death of the owner is not detected.
+*/
+static void _shmap_lock(struct SharedHashMap *shmap) {
+    struct SharedHeader *header = shmap->header;
+
+#ifndef SHMAP_ROBUST_LOCK
+    pthread_mutex_lock(&header->lock);
+#else
+    if (pthread_mutex_lock(&header->lock) == EOWNERDEAD) {
+        fprintf(stderr, "Recovering a shared hash map from a dead process.\n");
+        atomic_store(&header->occ_slots, get_occupied_slot_count(shmap->map));
+
+        u64 const seq = atomic_load_explicit(&header->seq, memory_order_relaxed);
+        if (seq & 1) {
+            atomic_store_explicit(&header->seq, seq + 1, memory_order_release);
+        }
+        pthread_mutex_consistent(&header->lock);
+    }
+#endif
+}
+
+/*
+Lock the region for a modification. The sequence counter is made odd, which makes
+concurrent readers retry, and the slot count of the process map is brought up to date.
+*/
+static void _shmap_write_begin(struct SharedHashMap *shmap) {
+    struct SharedHeader *header = shmap->header;
+    _shmap_lock(shmap);
+
+    u64 const seq = atomic_load_explicit(&header->seq, memory_order_relaxed);
+    atomic_store_explicit(&header->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    shmap->map->occ_slots = atomic_load_explicit(&header->occ_slots, memory_order_relaxed);
+}
+
+static void _shmap_write_end(struct SharedHashMap *shmap) {
+    struct SharedHeader *header = shmap->header;
+    atomic_store_explicit(&header->occ_slots, shmap->map->occ_slots, memory_order_relaxed);
+
+    u64 const seq = atomic_load_explicit(&header->seq, memory_order_relaxed);
+    atomic_store_explicit(&header->seq, seq + 1, memory_order_release);
+
+    pthread_mutex_unlock(&header->lock);
+}
+
+/*
+Look up a key without locking, see `_shard_get_lock_free` of the sharded hash map. Slots
+of the region are never reallocated, so no epoch is needed to keep them readable. Slots are
+read with plain loads while a writer may modify them, as explained there.
+*/
+static bool _shmap_get_lock_free(
+    struct SharedHashMap *shmap,
+    char const *key,
+    size_t len,
+    u64 hash,
+    void *item,
+    bool *found)
+{
+    struct SharedHeader *header = shmap->header;
+    struct MapView const view = {.slots=shmap->map->slots, .ex_capa=shmap->map->ex_capa};
+
+    for (u32 attempt=0; attempt<SHMAP_READ_ATTEMPTS; ++attempt) {
+        u64 const seq = atomic_load_explicit(&header->seq, memory_order_acquire);
+        if (seq & 1) continue;
+
+        void const *data = hmap_get_view(shmap->map, &view, key, len, hash);
+        if (data != NULL && item != NULL) {
+            memcpy(item, data, shmap->map->sz_item);
+        }
+        atomic_thread_fence(memory_order_acquire);
+
+        if (atomic_load_explicit(&header->seq, memory_order_relaxed) == seq) {
+            *found = data != NULL;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool shmap_insert(struct SharedHashMap *shmap, char const *key, void const *data) {
+    if (key == NULL) return false;
+
+    size_t const len = strlen(key);
+    u64 const hash = hmap_hash(shmap->map, key, len);
+
+    _shmap_write_begin(shmap);
+    bool const inserted = hmap_insert_hashed(shmap->map, key, len, hash, data);
+    _shmap_write_end(shmap);
+
+    return inserted;
+}
+
+bool shmap_get(struct SharedHashMap *shmap, char const *key, void *item) {
+    if (key == NULL) return false;
+
+    size_t const len = strlen(key);
+    u64 const hash = hmap_hash(shmap->map, key, len);
+
+    bool found = false;
+    if (_shmap_get_lock_free(shmap, key, len, hash, item, &found)) {
+        return found;
+    }
+
+    _shmap_lock(shmap);
+    void const *data = hmap_get_hashed(shmap->map, key, len, hash);
+    if (data != NULL && item != NULL) {
+        memcpy(item, data, shmap->map->sz_item);
+    }
+    pthread_mutex_unlock(&shmap->header->lock);
+
+    return data != NULL;
+}
+
+bool shmap_remove(struct SharedHashMap *shmap, char const *key, void *item) {
+    if (key == NULL) return false;
+
+    size_t const len = strlen(key);
+    u64 const hash = hmap_hash(shmap->map, key, len);
+
+    _shmap_write_begin(shmap);
+    bool const removed = hmap_remove_hashed(shmap->map, key, len, hash, item);
+    _shmap_write_end(shmap);
+
+    return removed;
+}
+
+size_t shmap_len(struct SharedHashMap *shmap) {
+    return atomic_load(&shmap->header->occ_slots);
+}
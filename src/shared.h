@@ -0,0 +1,83 @@
+#ifndef __SHARED__
+#define __SHARED__
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "common.h"
+#include "map.h"
+
+#define SHMAP_MAGIC "HMAPSHRD"
+#define SHMAP_MAGIC_BYTES 8
+#define SHMAP_VERSION 2
+#define SHMAP_CACHE_LINE_BYTES 64
+
+// Robust mutexes let the next process recover the lock of a dead owner, macOS lacks them
+#if defined(__linux__) || defined(PTHREAD_MUTEX_ROBUST)
+#define SHMAP_ROBUST_LOCK
+#endif
+
+/*
+Header at the start of a shared memory region, followed by the slot array of the hash map.
+
+Nothing in the region is a pointer, the slots are found at `slots_offset` from the start of
+the header, so every process may map the region to an address of its own. Capacity is
+fixed at creation to the largest one the region holds, slots are never reallocated.
+
+magic: `SHMAP_MAGIC`, written last so that attaching processes see a complete header.
+version: `SHMAP_VERSION`, incremented when the layout changes.
+sz_bucket, sz_key, sz_item, sz_slot: sizes of the hash map, see HashMap.
+ex_capa: capacity exponent of the slots.
+layout, hash, packing: configuration enums of the hash map.
+max_load: upper load factor, insertions fail once it is reached.
+rand_key: random key of the hash function, shared by all processes.
+slots_offset: offset of the slot array from the start of the header.
+lock: process-shared mutex taken by writers, and by readers failing to validate. Robust
+    where supported (`SHMAP_ROBUST_LOCK`), elsewhere a process dying with the lock held
+    blocks the other processes for good.
+seq: sequence counter for lock-free reads, odd while a writer modifies the slots.
+occ_slots: count of occupied slots, written under `lock`.
+*/
+struct SharedHeader {
+    char magic[SHMAP_MAGIC_BYTES];
+    u32 version;
+    u32 sz_bucket;
+    u32 sz_key;
+    u32 sz_item;
+    u32 sz_slot;
+    u32 ex_capa;
+    u32 layout;
+    u32 hash;
+    u32 packing;
+    f64 max_load;
+    u8 rand_key[HASH_RAND_KEY_LEN];
+    u64 slots_offset;
+    _Alignas(SHMAP_CACHE_LINE_BYTES) pthread_mutex_t lock;
+    _Atomic u64 seq;
+    _Atomic u32 occ_slots;
+};
+
+/*
+Handle of a process to a hash map in a shared memory region.
+
+header: start of the region.
+map: hash map of this process whose slots are those of the region. Its scratch slots
+    and function pointers are private to the process, its slot count is synchronised
+    with `occ_slots` of the header while the lock is held.
+*/
+struct SharedHashMap {
+    struct SharedHeader *header;
+    struct HashMap *map;
+};
+
+size_t shmap_region_bytes(struct HashMapConfig const *config, size_t elems);
+struct SharedHashMap* shmap_create(void *region, size_t region_bytes, struct HashMapConfig const *config);
+struct SharedHashMap* shmap_attach(void *region, size_t region_bytes);
+void shmap_detach(struct SharedHashMap *shmap);
+
+bool shmap_insert(struct SharedHashMap *shmap, char const *key, void const *data);
+bool shmap_get(struct SharedHashMap *shmap, char const *key, void *item);
+bool shmap_remove(struct SharedHashMap *shmap, char const *key, void *item);
+size_t shmap_len(struct SharedHashMap *shmap);
+
+#endif // __SHARED__
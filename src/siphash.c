@@ -13,11 +13,16 @@
  * with this software. If not, see
  * <http://creativecommons.org/publicdomain/zero/1.0/>.
  */
+#include <string.h>
+
 #include "common.h"
 #include "siphash.h"
 
+// Compression and finalization rounds of SipHash-2-4 and SipHash-1-3
 #define cROUNDS 2
 #define dROUNDS 4
+#define cROUNDS_13 1
+#define dROUNDS_13 3
 
 #define ROTL(x, b) (u64)(((x) << (b)) | ((x) >> (64 - (b))))
 
@@ -55,62 +60,101 @@
         v2 = ROTL(v2, 32);                                           \
     } while (0)
 
-static u64 _siphash(u8 const *in, size_t const in_len, u8 const *key) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SIPHASH_NATIVE_LE 1
+#endif
+
+// Little-endian 64-bit load, a single unaligned load on little-endian targets
+static inline u64 _load64_le(u8 const *p) {
+#ifdef SIPHASH_NATIVE_LE
+    u64 v;
+    memcpy(&v, p, sizeof v);
+    return v;
+#else
+    return U8TO64_LE(p);
+#endif
+}
+
+static inline u64 _load32_le(u8 const *p) {
+#ifdef SIPHASH_NATIVE_LE
+    u32 v;
+    memcpy(&v, p, sizeof v);
+    return v;
+#else
+    return ((u64)p[0]) | ((u64)p[1] << 8) | ((u64)p[2] << 16) | ((u64)p[3] << 24);
+#endif
+}
+
+/*
+Last block of the message: the `in_len % 8` trailing bytes with the length in the top byte.
+
+When the message has at least 8 bytes, the trailing bytes are taken from one load of the
+last 8 bytes, which may overlap the preceding block, without branching on the tail length.
+Shorter messages are read by at most two overlapping loads so no byte past the message
+is touched.
+*/
+static inline u64 _last_block(u8 const *in, size_t const in_len) {
+    u32 const left = in_len & 7;
+    u64 tail;
+
+    if (in_len >= 8) {
+        u64 const last = _load64_le(in + in_len - 8);
+        // All zero for `left` == 0, shift amount is masked to stay defined
+        u64 const mask = (u64)0 - (left != 0);
+        tail = (last >> ((64 - 8 * left) & 63)) & mask;
+    } else if (left >= 4) {
+        tail = _load32_le(in) | (_load32_le(in + left - 4) << (8 * (left - 4)));
+    } else if (left > 0) {
+        tail = ((u64)in[0]) | ((u64)in[left >> 1] << (8 * (left >> 1))) |
+            ((u64)in[left - 1] << (8 * (left - 1)));
+    } else {
+        tail = 0;
+    }
+    return tail | ((u64)in_len << 56);
+}
+
+static inline u64 _siphash(
+    u8 const *in,
+    size_t const in_len,
+    u8 const *key,
+    u32 const c_rounds,
+    u32 const d_rounds)
+{
     // initialization, 16-byte key k (k0, k1) and 32-byte state v (v0 to v3)
-    u64 k0 = U8TO64_LE(key);
-    u64 k1 = U8TO64_LE(key + 8);
+    u64 k0 = _load64_le(key);
+    u64 k1 = _load64_le(key + 8);
 
     u64 v0 = UINT64_C(0x736f6d6570736575) ^ k0;
     u64 v1 = UINT64_C(0x646f72616e646f6d) ^ k1;
     u64 v2 = UINT64_C(0x6c7967656e657261) ^ k0;
     u64 v3 = UINT64_C(0x7465646279746573) ^ k1;
 
+    u8 const *const start = in;
     u8 const *end = in + in_len - (in_len % sizeof(u64));
 
     for (; in != end; in += 8) {
-        u64 msg = U8TO64_LE(in);
+        u64 msg = _load64_le(in);
         v3 ^= msg;
 
-        for (u32 i=1; i <= cROUNDS; ++i) {
+        for (u32 i=1; i <= c_rounds; ++i) {
             SIPROUND;
         }
 
         v0 ^= msg;
     }
 
-    i32 const left = in_len & 7;
-    u64 b = ((u64)in_len) << 56;
-
-    switch (left) {
-    case 7:
-        b |= ((u64)in[6]) << 48;
-    case 6:
-        b |= ((u64)in[5]) << 40;
-    case 5:
-        b |= ((u64)in[4]) << 32;
-    case 4:
-        b |= ((u64)in[3]) << 24;
-    case 3:
-        b |= ((u64)in[2]) << 16;
-    case 2:
-        b |= ((u64)in[1]) << 8;
-    case 1:
-        b |= ((u64)in[0]);
-        break;
-    case 0:
-        break;
-    }
+    u64 b = _last_block(start, in_len);
 
     v3 ^= b;
 
-    for (u32 i=1; i <= cROUNDS; ++i) {
+    for (u32 i=1; i <= c_rounds; ++i) {
         SIPROUND;
     }
 
     v0 ^= b;
     v2 ^= 0xff;
 
-    for (u32 j=1; j <= dROUNDS; ++j) {
+    for (u32 j=1; j <= d_rounds; ++j) {
         SIPROUND;
     }
 
@@ -124,5 +168,130 @@ static u64 _siphash(u8 const *in, size_t const in_len, u8 const *key) {
 }
 
 u64 siphash(void const *data, size_t data_len, u8 const key[HASH_RAND_KEY_LEN]) {
-    return _siphash((u8 *)data, data_len, key);
+    return _siphash((u8 *)data, data_len, key, cROUNDS, dROUNDS);
+}
+
+u64 siphash13(void const *data, size_t data_len, u8 const key[HASH_RAND_KEY_LEN]) {
+    return _siphash((u8 *)data, data_len, key, cROUNDS_13, dROUNDS_13);
+}
+
+// SIPROUND for the named state `a0` to `a3`
+#define SIPROUND_STATE(a0, a1, a2, a3)                               \
+    do {                                                             \
+        a0 += a1;                                                    \
+        a1 = ROTL(a1, 13);                                           \
+        a1 ^= a0;                                                    \
+        a0 = ROTL(a0, 32);                                           \
+        a2 += a3;                                                    \
+        a3 = ROTL(a3, 16);                                           \
+        a3 ^= a2;                                                    \
+        a0 += a3;                                                    \
+        a3 = ROTL(a3, 21);                                           \
+        a3 ^= a0;                                                    \
+        a2 += a1;                                                    \
+        a1 = ROTL(a1, 17);                                           \
+        a1 ^= a2;                                                    \
+        a2 = ROTL(a2, 32);                                           \
+    } while (0)
+
+#define SIPCOMPRESS(a0, a1, a2, a3, msg)                             \
+    do {                                                             \
+        a3 ^= (msg);                                                 \
+        for (u32 i=1; i <= cROUNDS; ++i) {                           \
+            SIPROUND_STATE(a0, a1, a2, a3);                          \
+        }                                                            \
+        a0 ^= (msg);                                                 \
+    } while (0)
+
+#define SIPCOMPRESS_PAIR(x_msg, y_msg)                               \
+    do {                                                             \
+        a3 ^= (x_msg);                                               \
+        b3 ^= (y_msg);                                               \
+        for (u32 i=1; i <= cROUNDS; ++i) {                           \
+            SIPROUND_STATE(a0, a1, a2, a3);                          \
+            SIPROUND_STATE(b0, b1, b2, b3);                          \
+        }                                                            \
+        a0 ^= (x_msg);                                               \
+        b0 ^= (y_msg);                                               \
+    } while (0)
+
+// GCC would pack the two states to SSE registers, which lack 64-bit rotations
+#if defined(__GNUC__) && !defined(__clang__)
+#define SIPHASH_SCALAR_STATE __attribute__((optimize("no-tree-slp-vectorize")))
+#else
+#define SIPHASH_SCALAR_STATE
+#endif
+
+/*
+SipHash-2-4 of two messages with interleaved state.
+
+Blocks that both messages have are compressed in lockstep, so that the rounds of the two
+independent states overlap in the CPU pipeline. Two states fit in general purpose registers
+on 64-bit targets, wider interleaving would spill them to memory.
+*/
+SIPHASH_SCALAR_STATE
+static void _siphash_pair(
+    u8 const *x,
+    size_t const x_len,
+    u8 const *y,
+    size_t const y_len,
+    u64 const k0,
+    u64 const k1,
+    u64 out[SIPHASH_BATCH_LANES])
+{
+    u64 a0 = UINT64_C(0x736f6d6570736575) ^ k0;
+    u64 a1 = UINT64_C(0x646f72616e646f6d) ^ k1;
+    u64 a2 = UINT64_C(0x6c7967656e657261) ^ k0;
+    u64 a3 = UINT64_C(0x7465646279746573) ^ k1;
+    u64 b0 = a0, b1 = a1, b2 = a2, b3 = a3;
+
+    size_t const x_blocks = x_len / sizeof(u64);
+    size_t const y_blocks = y_len / sizeof(u64);
+    size_t const common_blocks = x_blocks < y_blocks ? x_blocks : y_blocks;
+
+    for (size_t j=0; j<common_blocks; ++j) {
+        u64 const x_msg = _load64_le(x + 8 * j);
+        u64 const y_msg = _load64_le(y + 8 * j);
+        SIPCOMPRESS_PAIR(x_msg, y_msg);
+    }
+    for (size_t j=common_blocks; j<x_blocks; ++j) {
+        SIPCOMPRESS(a0, a1, a2, a3, _load64_le(x + 8 * j));
+    }
+    for (size_t j=common_blocks; j<y_blocks; ++j) {
+        SIPCOMPRESS(b0, b1, b2, b3, _load64_le(y + 8 * j));
+    }
+    u64 const x_last = _last_block(x, x_len);
+    u64 const y_last = _last_block(y, y_len);
+    SIPCOMPRESS_PAIR(x_last, y_last);
+
+    a2 ^= 0xff;
+    b2 ^= 0xff;
+
+    for (u32 j=1; j <= dROUNDS; ++j) {
+        SIPROUND_STATE(a0, a1, a2, a3);
+        SIPROUND_STATE(b0, b1, b2, b3);
+    }
+
+    // 64-bit hash values to 8-byte little-endian representation
+    U64TO8_LE((u8 *)&out[0], a0 ^ a1 ^ a2 ^ a3);
+    U64TO8_LE((u8 *)&out[1], b0 ^ b1 ^ b2 ^ b3);
+}
+
+void siphash_batch(
+    void const *const data[],
+    size_t const data_len[],
+    size_t count,
+    u8 const key[HASH_RAND_KEY_LEN],
+    u64 out[])
+{
+    u64 const k0 = _load64_le(key);
+    u64 const k1 = _load64_le(key + 8);
+    size_t i = 0;
+
+    for (; i + SIPHASH_BATCH_LANES <= count; i += SIPHASH_BATCH_LANES) {
+        _siphash_pair(data[i], data_len[i], data[i + 1], data_len[i + 1], k0, k1, &out[i]);
+    }
+    for (; i < count; ++i) {
+        out[i] = _siphash(data[i], data_len[i], key, cROUNDS, dROUNDS);
+    }
 }
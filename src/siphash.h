@@ -1,6 +1,25 @@
+#ifndef __SIPHASH__
+#define __SIPHASH__
+
 #include <inttypes.h>
 
 #define HASH_RAND_KEY_LEN 16
 #define HASH_MAX_RAND_BUF_LEN 256
+#define SIPHASH_BATCH_LANES 2
 
 u64 siphash(void const *data, size_t data_len, u8 const key[HASH_RAND_KEY_LEN]);
+u64 siphash13(void const *data, size_t data_len, u8 const key[HASH_RAND_KEY_LEN]);
+
+/*
+SipHash-2-4 of `count` messages, `out[i]` equals `siphash(data[i], data_len[i], key)`.
+
+Messages are hashed `SIPHASH_BATCH_LANES` at a time with interleaved state.
+*/
+void siphash_batch(
+    void const *const data[],
+    size_t const data_len[],
+    size_t count,
+    u8 const key[HASH_RAND_KEY_LEN],
+    u64 out[]);
+
+#endif // __SIPHASH__
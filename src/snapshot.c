@@ -0,0 +1,338 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdatomic.h>
+
+#include "snapshot.h"
+#include "bucket.h"
+#include "wyhash.h"
+
+// Temporary file name is the path followed by ".tmp.<pid>.<counter>"
+#define SNAPSHOT_TEMP_SUFFIX_BYTES 40
+#define SNAPSHOT_TEMP_ATTEMPTS 100
+
+// Checksums need no secret, only a fixed key
+static u8 const checksum_key[HASH_RAND_KEY_LEN] = {0};
+// Distinguishes temporary files of concurrent saves within the process
+static _Atomic u32 temp_counter;
+
+
+static u64 _checksum(void const *data, size_t len) {
+    return wyhash(data, len, checksum_key);
+}
+
+static u64 _header_checksum(struct SnapshotHeader const *header) {
+    struct SnapshotHeader copy = *header;
+    copy.checksum = 0;
+
+    return _checksum(&copy, sizeof copy);
+}
+
+/*
+Hash function choice of the hash map, custom functions cannot be restored from a file.
+*/
+static bool _hash_choice(struct HashMap const *hashmap, enum HashMapHash *hash) {
+    if (hashmap->hash_func == NULL) {
+        *hash = HASHMAP_HASH_DEFAULT;
+    } else if (hashmap->hash_func == siphash) {
+        *hash = HASHMAP_HASH_SIPHASH24;
+    } else if (hashmap->hash_func == siphash13) {
+        *hash = HASHMAP_HASH_SIPHASH13;
+    } else if (hashmap->hash_func == wyhash) {
+        *hash = HASHMAP_HASH_WYHASH;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool _write_all(int fd, void const *data, size_t len) {
+    u8 const *bytes = data;
+
+    while (len > 0) {
+        ssize_t const written = write(fd, bytes, len);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (written == 0) {
+            errno = EIO;
+            return false;
+        }
+        bytes += written;
+        len -= (size_t)written;
+    }
+    return true;
+}
+
+static bool _read_all(int fd, void *data, size_t len) {
+    u8 *bytes = data;
+
+    while (len > 0) {
+        ssize_t const got = read(fd, bytes, len);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (got == 0) return false;
+        bytes += got;
+        len -= (size_t)got;
+    }
+    return true;
+}
+
+/*
+Create a new temporary file next to `path` and write its name to `temp_path`. The file is
+created with mode 0644 less the umask, as `path` itself would be. Returns -1 on failure.
+*/
+static int _create_temp(char const *path, char *temp_path, size_t temp_bytes) {
+    for (u32 attempt=0; attempt<SNAPSHOT_TEMP_ATTEMPTS; ++attempt) {
+        u32 const count = atomic_fetch_add(&temp_counter, 1);
+        snprintf(temp_path, temp_bytes, "%s.tmp.%ld.%u", path, (long)getpid(), count);
+
+        int const fd = open(temp_path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd >= 0 || errno != EEXIST) return fd;
+    }
+    return -1;
+}
+
+bool snapshot_save(struct HashMap *hashmap, char const *path) {
+    enum HashMapHash hash;
+    if (!_hash_choice(hashmap, &hash)) {
+        fprintf(stderr, "Cannot save a hash map with a custom hash function.\n");
+        return false;
+    }
+    // Only the current slots are stored
+    hmap_finish_migration(hashmap);
+    if (hashmap->old_slots) {
+        fprintf(stderr, "Cannot save a hash map during an unfinished resize.\n");
+        return false;
+    }
+
+    struct SnapshotHeader header;
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_BYTES);
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.header_bytes = sizeof header;
+    header.sz_bucket = hashmap->sz_bucket;
+    header.sz_key = hashmap->sz_key;
+    header.sz_item = hashmap->sz_item;
+    header.sz_slot = hashmap->sz_slot;
+    header.ex_capa = hashmap->ex_capa;
+    header.occ_slots = hashmap->occ_slots;
+    header.layout = hashmap->layout;
+    header.key_type = hashmap->key_type;
+    header.hash = hash;
+    header.shrink = hashmap->shrink;
+    header.long_keys = hashmap->long_keys;
+    header.incremental = hashmap->incremental;
+    header.huge_pages = hashmap->huge_pages;
+    header.packing = hashmap->packing;
+    header.max_load = hashmap->max_load;
+    header.min_load = hashmap->min_load;
+    memcpy(header.rand_key, hashmap->rand_key, HASH_RAND_KEY_LEN);
+    header.slots_bytes = hmap_slots_bytes(hashmap, hashmap->ex_capa);
+    header.arena_bytes = hashmap->arena.len;
+    header.arena_dead = hashmap->arena.dead;
+    header.slots_checksum = _checksum(hashmap->slots, header.slots_bytes);
+    header.arena_checksum = _checksum(hashmap->arena.data, header.arena_bytes);
+    header.checksum = _header_checksum(&header);
+
+    // Written to a temporary file replacing `path` only once complete, so a failed save
+    // keeps the previous snapshot and processes having it mapped never see a partial file
+    size_t const temp_bytes = strlen(path) + SNAPSHOT_TEMP_SUFFIX_BYTES;
+    char *temp_path = malloc(temp_bytes);
+    if (temp_path == NULL) {
+        fprintf(stderr, "Cannot allocate memory for saving the hash map.\n");
+        return false;
+    }
+
+    int const fd = _create_temp(path, temp_path, temp_bytes);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot create %s: %s.\n", temp_path, strerror(errno));
+        free(temp_path);
+        return false;
+    }
+    bool saved = _write_all(fd, &header, sizeof header) &&
+        _write_all(fd, hashmap->slots, header.slots_bytes) &&
+        _write_all(fd, hashmap->arena.data, header.arena_bytes);
+
+    if (!saved) {
+        fprintf(stderr, "Cannot write the hash map to %s: %s.\n", temp_path, strerror(errno));
+    } else if (fsync(fd) != 0) {
+        fprintf(stderr, "Cannot sync %s: %s.\n", temp_path, strerror(errno));
+        saved = false;
+    }
+    if (close(fd) != 0 && saved) {
+        fprintf(stderr, "Cannot close %s: %s.\n", temp_path, strerror(errno));
+        saved = false;
+    }
+    if (saved && rename(temp_path, path) != 0) {
+        fprintf(stderr, "Cannot replace %s: %s.\n", path, strerror(errno));
+        saved = false;
+    }
+    if (!saved) {
+        unlink(temp_path);
+    }
+    free(temp_path);
+
+    return saved;
+}
+
+static bool _header_is_valid(struct SnapshotHeader const *header, off_t file_bytes) {
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_BYTES) != 0) {
+        fprintf(stderr, "Not a hash map snapshot.\n");
+        return false;
+    }
+    if (header->version != SNAPSHOT_VERSION) {
+        fprintf(stderr, "Unsupported snapshot version %u.\n", header->version);
+        return false;
+    }
+    if (header->byte_order != SNAPSHOT_BYTE_ORDER || header->header_bytes != sizeof *header ||
+        header->sz_bucket != sizeof(struct Bucket))
+    {
+        fprintf(stderr, "Snapshot was saved by an incompatible build.\n");
+        return false;
+    }
+    if (header->checksum != _header_checksum(header)) {
+        fprintf(stderr, "Snapshot header is corrupted.\n");
+        return false;
+    }
+    if (header->ex_capa > MAP_MAX_EXP_CAPACITY ||
+        (u64)file_bytes != sizeof *header + header->slots_bytes + header->arena_bytes)
+    {
+        fprintf(stderr, "Snapshot size does not match its header.\n");
+        return false;
+    }
+    return true;
+}
+
+/*
+Init an empty hash map with the configuration of the snapshot, capacity of the slots
+is given separately. Returns NULL if the sizes of the slots do not match the snapshot.
+*/
+static struct HashMap* _init_from_header(struct SnapshotHeader const *header, u32 init_capa) {
+    struct HashMapConfig const config = {
+        .item_size=header->sz_item,
+        .incremental_resize=header->incremental,
+        .layout=header->layout,
+        .long_keys=header->long_keys,
+        .key_type=header->key_type,
+        .hash=header->hash,
+        .huge_pages=header->huge_pages,
+        .packing=header->packing,
+        .max_load_factor=header->max_load,
+        .min_load_factor=header->min_load,
+        .shrink=header->shrink,
+    };
+    struct HashMap *hashmap = hmap_init_ex(&config, init_capa);
+    if (hashmap == NULL) return NULL;
+
+    if (hmap_slots_bytes(hashmap, header->ex_capa) != header->slots_bytes ||
+        hashmap->sz_slot != header->sz_slot || hashmap->sz_key != header->sz_key)
+    {
+        fprintf(stderr, "Snapshot slot sizes do not match.\n");
+        hmap_free(hashmap);
+        return NULL;
+    }
+    hashmap->occ_slots = header->occ_slots;
+    memcpy(hashmap->rand_key, header->rand_key, HASH_RAND_KEY_LEN);
+
+    return hashmap;
+}
+
+static struct HashMap* _load_from(int fd) {
+    struct stat st;
+    struct SnapshotHeader header;
+
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof header ||
+        !_read_all(fd, &header, sizeof header))
+    {
+        fprintf(stderr, "Cannot read the snapshot header.\n");
+        return NULL;
+    }
+    if (!_header_is_valid(&header, st.st_size)) return NULL;
+
+    struct HashMap *hashmap = _init_from_header(&header, header.ex_capa);
+    if (hashmap == NULL) return NULL;
+    // Slots are read straight into the slot array, no key is rehashed
+    bool loaded = _read_all(fd, hashmap->slots, header.slots_bytes) &&
+        _checksum(hashmap->slots, header.slots_bytes) == header.slots_checksum;
+
+    if (loaded && header.arena_bytes > 0) {
+        loaded = hmap_reserve_key_arena(hashmap, header.arena_bytes) &&
+            _read_all(fd, hashmap->arena.data, header.arena_bytes) &&
+            _checksum(hashmap->arena.data, header.arena_bytes) == header.arena_checksum;
+    }
+    hashmap->arena.len = loaded ? header.arena_bytes : 0;
+    hashmap->arena.dead = loaded ? header.arena_dead : 0;
+    if (!loaded) {
+        fprintf(stderr, "Snapshot data is corrupted.\n");
+        // Slots may hold partial data, freeing must not interpret them
+        memset(hashmap->slots, 0, header.slots_bytes);
+        hmap_free(hashmap);
+        return NULL;
+    }
+
+    return hashmap;
+}
+
+struct HashMap* snapshot_load(char const *path) {
+    int const fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s for reading: %s.\n", path, strerror(errno));
+        return NULL;
+    }
+    struct HashMap *hashmap = _load_from(fd);
+    close(fd);
+
+    return hashmap;
+}
+
+struct HashMap* snapshot_open_mapped(char const *path) {
+    int const fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s for reading: %s.\n", path, strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(struct SnapshotHeader)) {
+        fprintf(stderr, "Cannot read the snapshot header.\n");
+        close(fd);
+        return NULL;
+    }
+    size_t const bytes = (size_t)st.st_size;
+    // Shared mapping, pages of the file are shared through the page cache by all processes
+    void *mapping = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Cannot map %s: %s.\n", path, strerror(errno));
+        return NULL;
+    }
+    struct SnapshotHeader const *header = mapping;
+    // Slots and arena are not checksummed, that would read the whole file
+    struct HashMap *hashmap = !_header_is_valid(header, st.st_size) ? NULL :
+        _init_from_header(header, MAP_INIT_EXP_CAPACITY);
+
+    if (hashmap == NULL) {
+        munmap(mapping, bytes);
+        return NULL;
+    }
+    u8 *slots = (u8 *)mapping + sizeof *header;
+    hmap_attach_mapping(
+        hashmap, mapping, bytes, slots, header->ex_capa,
+        (char *)slots + header->slots_bytes, header->arena_bytes
+    );
+    hashmap->arena.dead = header->arena_dead;
+
+    return hashmap;
+}
@@ -0,0 +1,77 @@
+#ifndef __SNAPSHOT__
+#define __SNAPSHOT__
+
+#include "common.h"
+#include "map.h"
+
+#define SNAPSHOT_MAGIC "HMAPSNAP"
+#define SNAPSHOT_MAGIC_BYTES 8
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_BYTE_ORDER 0x01020304U
+
+/*
+Header of a snapshot file, followed by the slot array and the key arena of the hash map.
+
+The slots are stored as they are in memory, so a snapshot is valid only for a build with
+the same byte order and bucket size (`HASHMAP_WIDE_HASH`), which the header records.
+Truncated hashes and probe sequence lengths of the buckets stay valid as the random key
+and hash function are restored with them. Size of the header is a multiple of 16 bytes,
+so slots of a mapped snapshot are aligned like allocated ones.
+
+magic: `SNAPSHOT_MAGIC`, identifies the file.
+version: `SNAPSHOT_VERSION`, incremented when the format changes.
+byte_order: `SNAPSHOT_BYTE_ORDER` as written by the saving machine.
+header_bytes: size of this header.
+sz_bucket, sz_key, sz_item, sz_slot: sizes of the hash map, see HashMap.
+ex_capa, occ_slots: capacity exponent and count of occupied slots.
+layout, key_type, hash, shrink: configuration enums of the hash map.
+long_keys, incremental, huge_pages: configuration flags of the hash map.
+packing: slot packing of the hash map, see HashMapPacking.
+max_load, min_load: load factors of the hash map.
+rand_key: random key of the hash function.
+slots_bytes: size of the slot array following the header.
+arena_bytes, arena_dead: bytes in use and bytes of removed keys in the key arena.
+slots_checksum, arena_checksum: checksums of the slot array and the key arena.
+checksum: checksum of this header, computed with this member zeroed.
+*/
+struct SnapshotHeader {
+    char magic[SNAPSHOT_MAGIC_BYTES];
+    u32 version;
+    u32 byte_order;
+    u32 header_bytes;
+    u32 sz_bucket;
+    u32 sz_key;
+    u32 sz_item;
+    u32 sz_slot;
+    u32 ex_capa;
+    u32 occ_slots;
+    u32 layout;
+    u32 key_type;
+    u32 hash;
+    u32 shrink;
+    u8 long_keys;
+    u8 incremental;
+    u8 huge_pages;
+    u8 packing;
+    f64 max_load;
+    f64 min_load;
+    u8 rand_key[HASH_RAND_KEY_LEN];
+    u64 slots_bytes;
+    u64 arena_bytes;
+    u64 arena_dead;
+    u64 slots_checksum;
+    u64 arena_checksum;
+    u64 checksum;
+};
+
+// Slots of a mapped snapshot follow the header, so it must keep them aligned like allocated ones
+_Static_assert(
+    sizeof(struct SnapshotHeader) % _Alignof(max_align_t) == 0,
+    "Snapshot header must keep the slots aligned to max_align_t"
+);
+
+bool snapshot_save(struct HashMap *hashmap, char const *path);
+struct HashMap* snapshot_load(char const *path);
+struct HashMap* snapshot_open_mapped(char const *path);
+
+#endif // __SNAPSHOT__
@@ -0,0 +1,145 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "stats.h"
+
+/*
+Destination of a statistics dump, either `stream` or `buffer` of `size` bytes. `len` counts
+the bytes written so far, also those that did not fit to the buffer.
+*/
+struct StatsWriter {
+    FILE *stream;
+    char *buffer;
+    size_t size;
+    size_t len;
+    bool failed;
+};
+
+static void _write(struct StatsWriter *writer, char const *format, ...) {
+    if (writer->failed) return;
+
+    va_list args;
+    va_start(args, format);
+    int written;
+
+    if (writer->stream) {
+        written = vfprintf(writer->stream, format, args);
+    } else {
+        // Past the end of the buffer only the length is counted
+        size_t const left = writer->len < writer->size ? writer->size - writer->len : 0;
+        written = vsnprintf(left ? writer->buffer + writer->len : NULL, left, format, args);
+    }
+    va_end(args);
+
+    if (written < 0) {
+        writer->failed = true;
+        return;
+    }
+    writer->len += (size_t)written;
+}
+
+/*
+Histogram as a JSON array, trailing empty buckets left out.
+*/
+static void _write_histogram(struct StatsWriter *writer, u64 const *counts, size_t buckets) {
+    while (buckets > 0 && counts[buckets - 1] == 0) {
+        buckets -= 1;
+    }
+    _write(writer, "[");
+    for (size_t b=0; b<buckets; ++b) {
+        _write(writer, b ? ",%llu" : "%llu", (unsigned long long)counts[b]);
+    }
+    _write(writer, "]");
+}
+
+static void _write_counters(struct StatsWriter *writer, struct HashMapStats const *stats) {
+    _write(
+        writer,
+        ",\"counters\":{\"gets\":%llu,\"get_hits\":%llu,\"get_misses\":%llu,\"inserts\":%llu,"
+        "\"updates\":%llu,\"removes\":%llu,\"displacements\":%llu,\"backward_shifts\":%llu,"
+        "\"resizes_up\":%llu,\"resizes_down\":%llu,\"resize_ns\":%llu}",
+        (unsigned long long)stats->gets,
+        (unsigned long long)stats->get_hits,
+        (unsigned long long)stats->get_misses,
+        (unsigned long long)stats->inserts,
+        (unsigned long long)stats->updates,
+        (unsigned long long)stats->removes,
+        (unsigned long long)stats->displacements,
+        (unsigned long long)stats->backward_shifts,
+        (unsigned long long)stats->resizes_up,
+        (unsigned long long)stats->resizes_down,
+        (unsigned long long)stats->resize_ns
+    );
+}
+
+static void _write_json(struct StatsWriter *writer, struct HashMap *hashmap) {
+    struct HashMapStats stats;
+    struct HashMapLayoutStats layout;
+    bool const counted = hmap_get_stats(hashmap, &stats);
+    hmap_get_layout_stats(hashmap, &layout);
+
+    _write(
+        writer,
+        "{\"capacity\":%llu,\"len\":%llu,\"load_factor\":%.4f,\"layout\":\"%s\",\"key_type\":\"%s\","
+        "\"incremental_resize\":%s,\"long_keys\":%s",
+        (unsigned long long)layout.capacity,
+        (unsigned long long)layout.len,
+        layout.capacity ? (f64)layout.len / layout.capacity : 0.0,
+        hashmap->layout == HASHMAP_LAYOUT_SPLIT ? "split" : "interleaved",
+        hashmap->key_type == HASHMAP_KEY_U64 ? "u64" : "string",
+        hashmap->incremental ? "true" : "false",
+        hashmap->long_keys ? "true" : "false"
+    );
+    _write(
+        writer,
+        ",\"bytes\":{\"bucket\":%u,\"key\":%u,\"item\":%u,\"slot\":%llu,\"table\":%llu,"
+        "\"arena\":%llu,\"allocated\":%llu,\"key_padding\":%llu,\"alignment\":%llu,\"empty\":%llu}",
+        hashmap->sz_bucket,
+        hashmap->sz_key,
+        hashmap->sz_item,
+        (unsigned long long)layout.slot_bytes,
+        (unsigned long long)layout.table_bytes,
+        (unsigned long long)layout.arena_bytes,
+        (unsigned long long)layout.allocated_bytes,
+        (unsigned long long)layout.key_padding_bytes,
+        (unsigned long long)layout.alignment_bytes,
+        (unsigned long long)layout.empty_bytes
+    );
+    _write(
+        writer,
+        ",\"psl\":{\"max\":%llu,\"mean\":%.4f,\"histogram\":",
+        (unsigned long long)layout.max_psl,
+        layout.mean_psl
+    );
+    _write_histogram(writer, stats.psl_histogram, HASHMAP_STATS_PSL_BUCKETS);
+    _write(
+        writer,
+        "},\"clusters\":{\"count\":%llu,\"max\":%llu,\"mean\":%.4f,\"log2_histogram\":",
+        (unsigned long long)layout.cluster_count,
+        (unsigned long long)layout.max_cluster_len,
+        layout.mean_cluster_len
+    );
+    _write_histogram(writer, layout.cluster_histogram, HASHMAP_STATS_CLUSTER_BUCKETS);
+    _write(writer, "}");
+
+    if (counted) {
+        _write_counters(writer, &stats);
+    }
+    _write(writer, "}\n");
+}
+
+bool stats_dump(struct HashMap *hashmap, FILE *stream) {
+    if (stream == NULL) return false;
+
+    struct StatsWriter writer = {.stream=stream};
+    _write_json(&writer, hashmap);
+
+    return !writer.failed && !ferror(stream);
+}
+
+size_t stats_dump_buffer(struct HashMap *hashmap, char *buffer, size_t size) {
+    struct StatsWriter writer = {.buffer=buffer, .size=buffer ? size : 0};
+    _write_json(&writer, hashmap);
+
+    return writer.len;
+}
@@ -0,0 +1,12 @@
+#ifndef __STATS__
+#define __STATS__
+
+#include <stdio.h>
+
+#include "common.h"
+#include "map.h"
+
+bool stats_dump(struct HashMap *hashmap, FILE *stream);
+size_t stats_dump_buffer(struct HashMap *hashmap, char *buffer, size_t size);
+
+#endif // __STATS__
@@ -0,0 +1,104 @@
+/*
+ * Keyed hash function following the construction of wyhash (final version 4)
+ * by Wang Yi, released into the public domain (The Unlicense).
+ *
+ * The 64-bit seed is derived from the 16-byte random key of the hash map, multiplication
+ * secrets are the defaults of the original. Data is read in native byte order, so hash
+ * values are not portable across platforms of different endianness.
+ */
+#include <string.h>
+
+#include "common.h"
+#include "wyhash.h"
+
+static u64 const secret[4] = {
+    UINT64_C(0x2d358dccaa6c78a5), UINT64_C(0x8bb84b93962eacc9),
+    UINT64_C(0x4b33a62ed433d4a3), UINT64_C(0x4d5a2da51de1aa47),
+};
+
+// 128-bit product of `a` and `b`, low half to `a` and high half to `b`
+static inline void _mum(u64 *a, u64 *b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = *a;
+    r *= *b;
+    *a = (u64)r;
+    *b = (u64)(r >> 64);
+#else
+    u64 const ha = *a >> 32, hb = *b >> 32, la = (u32)*a, lb = (u32)*b;
+    u64 const rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    u64 const t = rl + (rm0 << 32);
+    u64 const lo = t + (rm1 << 32);
+    u64 const hi = rh + (rm0 >> 32) + (rm1 >> 32) + (t < rl) + (lo < t);
+    *a = lo;
+    *b = hi;
+#endif
+}
+
+static inline u64 _mix(u64 a, u64 b) {
+    _mum(&a, &b);
+    return a ^ b;
+}
+
+static inline u64 _read8(u8 const *p) {
+    u64 v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+static inline u64 _read4(u8 const *p) {
+    u32 v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+static inline u64 _read3(u8 const *p, size_t k) {
+    return (((u64)p[0]) << 16) | (((u64)p[k >> 1]) << 8) | p[k - 1];
+}
+
+static u64 _wyhash(u8 const *p, size_t const len, u64 seed) {
+    seed ^= _mix(seed ^ secret[0], secret[1]);
+    u64 a, b;
+
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (_read4(p) << 32) | _read4(p + ((len >> 3) << 2));
+            b = (_read4(p + len - 4) << 32) | _read4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = _read3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+
+        if (i > 48) {
+            u64 see1 = seed, see2 = seed;
+            do {
+                seed = _mix(_read8(p) ^ secret[1], _read8(p + 8) ^ seed);
+                see1 = _mix(_read8(p + 16) ^ secret[2], _read8(p + 24) ^ see1);
+                see2 = _mix(_read8(p + 32) ^ secret[3], _read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = _mix(_read8(p) ^ secret[1], _read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = _read8(p + i - 16);
+        b = _read8(p + i - 8);
+    }
+    a ^= secret[1];
+    b ^= seed;
+    _mum(&a, &b);
+
+    return _mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+u64 wyhash(void const *data, size_t data_len, u8 const key[HASH_RAND_KEY_LEN]) {
+    u64 const seed = _read8(key) ^ _read8(key + 8);
+    return _wyhash((u8 const *)data, data_len, seed);
+}
@@ -0,0 +1,9 @@
+#ifndef __WYHASH__
+#define __WYHASH__
+
+#include "common.h"
+#include "siphash.h"
+
+u64 wyhash(void const *data, size_t data_len, u8 const key[HASH_RAND_KEY_LEN]);
+
+#endif // __WYHASH__
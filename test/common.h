@@ -29,8 +29,14 @@ typedef struct {
 } test_func;
 
 extern test_func siphash_tests[];
+extern test_func wyhash_tests[];
 extern test_func random_tests[];
+extern test_func probe_tests[];
 extern test_func map_tests[];
+extern test_func sharded_tests[];
+extern test_func shared_tests[];
+extern test_func snapshot_tests[];
+extern test_func stats_tests[];
 
 extern test_func hashmap_tests[];
 extern test_func hashset_tests[];
@@ -92,11 +92,10 @@ static void test_complete_hashmap_mid_size() {
 
     struct HashMap *hashmap = hashmap_init_with_size(type_size, init_elems, NULL);
     assert(hashmap != NULL);
-    // 500 < 2^9, thus capacity exponent should be nine
-    assert(hashmap->ex_capa == 9);
+    // 500 keys exceed 0.9 * 2^9, thus capacity exponent should be ten
+    assert(hashmap->ex_capa == 10);
 
-    // insert 500 "measurements" to the hashmap
-    // resize should occur after threshold value floor(0.9 * 500) is reached
+    // insert 500 "measurements" to the hashmap, no resize should occur
     u32 const elems = 500;
 
     for (u32 i=1; i<=elems; ++i) {
@@ -153,7 +152,7 @@ static void test_complete_hashmap_mid_size() {
 
 static void test_complete_hashmap_oversize_init() {
     size_t const type_size = sizeof(struct Measurement);
-    size_t const init_elems = 1050000;
+    size_t const init_elems = MAP_CAPACITY(MAP_MAX_EXP_CAPACITY) + 1;
 
     // requested storage (element count) is larger than maximal allowed capacity
     struct HashMap *hashmap = hashmap_init_with_size(type_size, init_elems, NULL);
@@ -162,6 +161,29 @@ static void test_complete_hashmap_oversize_init() {
     PRINT_SUCCESS(__func__);
 }
 
+static void test_complete_hashmap_over_narrow_capacity_init() {
+    size_t const type_size = sizeof(i32);
+    // one element more than the default bucket layout (20 bits of hash) can address
+    size_t const init_elems = (1U << 20) + 1;
+
+    struct HashMap *hashmap = hashmap_init_with_size(type_size, init_elems, NULL);
+
+#ifdef HASHMAP_WIDE_HASH
+    assert(hashmap != NULL);
+    assert(hashmap->ex_capa == 21);
+
+    i32 value = 7;
+    assert(hashmap_insert(hashmap, "wide_key", &value) == true);
+    assert(*(i32 *)hashmap_get(hashmap, "wide_key") == value);
+
+    hashmap_free(hashmap);
+#else
+    assert(hashmap == NULL);
+#endif
+
+    PRINT_SUCCESS(__func__);
+}
+
 static i32_pair find_pair_that_sum_to_specific_target(i32 *array, u32 arr_len, i32 target) {
     struct HashMap *hashmap = hashmap_init_with_size(sizeof *array, arr_len, NULL);
     assert(hashmap != NULL);
@@ -436,11 +458,380 @@ static void test_hashmap_usage_in_word_count_algorithm() {
     PRINT_SUCCESS(__func__);
 }
 
+static void test_hashmap_init_ex_incremental_resize() {
+    struct HashMapConfig const config = {
+        .item_size=sizeof(struct Measurement),
+        .init_elems=100,
+        .incremental_resize=true
+    };
+    struct HashMap *hashmap = hashmap_init_ex(&config);
+    assert(hashmap != NULL);
+    assert(hashmap->ex_capa == 7);
+
+    u32 const elems = 5000;
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+
+        struct Measurement measurement = {.name="incremental", .val_x=i};
+        assert(hashmap_insert(hashmap, key, &measurement) == true);
+    }
+    assert(hashmap_len(hashmap) == elems);
+
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+
+        struct Measurement *m_back = hashmap_get(hashmap, key);
+        assert(m_back != NULL);
+        assert(m_back->val_x == (i32)i);
+    }
+    for (u32 i=1; i<=elems; i+=2) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hashmap_remove(hashmap, key) != NULL);
+    }
+    assert(hashmap_len(hashmap) == elems / 2);
+    assert(hashmap_get(hashmap, "key_1") == NULL);
+    assert(hashmap_get(hashmap, "key_2") != NULL);
+
+    hashmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+
+static void test_hashmap_init_ex_split_layout() {
+    struct HashMapConfig const config = {
+        .item_size=sizeof(struct Measurement),
+        .layout=HASHMAP_LAYOUT_SPLIT
+    };
+    struct HashMap *hashmap = hashmap_init_ex(&config);
+    assert(hashmap != NULL);
+
+    u32 const elems = 1000;
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+
+        struct Measurement measurement = {.name="split", .val_x=i};
+        assert(hashmap_insert(hashmap, key, &measurement) == true);
+    }
+    assert(hashmap_len(hashmap) == elems);
+
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+
+        struct Measurement *m_back = hashmap_get(hashmap, key);
+        assert(m_back != NULL);
+        assert(m_back->val_x == (i32)i);
+        assert(strcmp(m_back->name, "split") == 0);
+    }
+    struct Measurement *m_back = hashmap_remove(hashmap, "key_10");
+    assert(m_back != NULL && m_back->val_x == 10);
+    assert(hashmap_get(hashmap, "key_10") == NULL);
+    assert(hashmap_len(hashmap) == elems - 1);
+
+    hashmap_free(hashmap);
+
+    struct HashMapConfig const invalid_config = {
+        .item_size=sizeof(struct Measurement),
+        .layout=(enum HashMapLayout)42
+    };
+    assert(hashmap_init_ex(&invalid_config) == NULL);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_hashmap_binary_keys() {
+    struct HashMap *hashmap = hashmap_init(sizeof(u64), NULL);
+    assert(hashmap != NULL);
+
+    // packed integer ids, most of them contain null bytes
+    u64 const elems = 2000;
+    for (u64 id=0; id<elems; ++id) {
+        assert(hashmap_insert_n(hashmap, &id, sizeof id, &id) == true);
+    }
+    assert(hashmap_len(hashmap) == elems);
+
+    for (u64 id=0; id<elems; ++id) {
+        u64 *value = hashmap_get_n(hashmap, &id, sizeof id);
+        assert(value != NULL);
+        assert(*value == id);
+    }
+    u64 const missing = elems;
+    assert(hashmap_get_n(hashmap, &missing, sizeof missing) == NULL);
+
+    // prefix of a key is a different key
+    u64 const first = 1;
+    assert(hashmap_get_n(hashmap, &first, sizeof first - 1) == NULL);
+
+    for (u64 id=0; id<elems; id+=2) {
+        assert(*(u64 *)hashmap_remove_n(hashmap, &id, sizeof id) == id);
+    }
+    assert(hashmap_len(hashmap) == elems / 2);
+    assert(hashmap_remove_n(hashmap, &(u64){0}, sizeof(u64)) == NULL);
+
+    // 16 byte uuid with a null byte in the middle
+    u8 const uuid[16] = {0x12, 0x3e, 0x45, 0x67, 0xe8, 0x9b, 0x12, 0xd3, 0x00, 0x56, 0x42, 0x66, 0x14, 0x17, 0x40, 0x00};
+    assert(hashmap_insert_n(hashmap, uuid, sizeof uuid, &(u64){42}) == true);
+    assert(*(u64 *)hashmap_get_n(hashmap, uuid, sizeof uuid) == 42);
+
+    // string and binary keys with equal bytes are the same key
+    assert(hashmap_insert(hashmap, "string_key", &(u64){7}) == true);
+    assert(*(u64 *)hashmap_get_n(hashmap, "string_key", strlen("string_key")) == 7);
+    assert(hashmap_get_n(hashmap, "string_key", strlen("string_key") + 1) == NULL);
+
+    // empty key is valid, null pointers and too long keys are not
+    assert(hashmap_insert_n(hashmap, "", 0, &(u64){0}) == true);
+    assert(hashmap_get(hashmap, "") != NULL);
+    assert(hashmap_insert_n(hashmap, NULL, 0, &(u64){0}) == false);
+    assert(hashmap_get_n(hashmap, NULL, 4) == NULL);
+    assert(hashmap_insert_n(hashmap, "twenty_bytes_of_key", 20, &(u64){0}) == false);
+
+    hashmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_hashmap_u64_keys() {
+    struct HashMapConfig const config = {
+        .item_size=sizeof(struct Measurement),
+        .init_elems=1000,
+        .key_type=HASHMAP_KEY_U64
+    };
+    struct HashMap *hashmap = hashmap_init_ex(&config);
+    assert(hashmap != NULL);
+
+    for (u64 id=1; id<=1000; ++id) {
+        struct Measurement measurement = {.name="sensor", .val_x=(i32)id};
+        assert(hashmap_insert_u64(hashmap, id << 32, &measurement) == true);
+    }
+    assert(hashmap_len(hashmap) == 1000);
+
+    struct Measurement *m_back = hashmap_get_u64(hashmap, UINT64_C(500) << 32);
+    assert(m_back != NULL);
+    assert(m_back->val_x == 500);
+    assert(hashmap_get_u64(hashmap, 500) == NULL);
+
+    m_back = hashmap_remove_u64(hashmap, UINT64_C(500) << 32);
+    assert(m_back != NULL && m_back->val_x == 500);
+    assert(hashmap_get_u64(hashmap, UINT64_C(500) << 32) == NULL);
+    assert(hashmap_len(hashmap) == 999);
+
+    hashmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_hashmap_batch_operations() {
+    struct HashMap *hashmap = hashmap_init(sizeof(struct Measurement), NULL);
+    assert(hashmap != NULL);
+
+    char const *keys[] = {"sensor_1", "sensor_2", "sensor_3", "sensor_4", "sensor_5"};
+    struct Measurement measurements[5];
+    void const *data[5];
+
+    for (u32 i=0; i<5; ++i) {
+        measurements[i] = (struct Measurement){.name="sensor", .val_x=(i32)i};
+        data[i] = &measurements[i];
+    }
+    assert(hashmap_insert_batch(hashmap, keys, 5, data) == 5);
+    assert(hashmap_len(hashmap) == 5);
+
+    char const *lookup[] = {"sensor_5", "sensor_0", "sensor_1"};
+    void *items[3];
+    assert(hashmap_get_batch(hashmap, lookup, 3, items) == 2);
+    assert(((struct Measurement *)items[0])->val_x == 4);
+    assert(items[1] == NULL);
+    assert(((struct Measurement *)items[2])->val_x == 0);
+
+    struct Measurement removed[3];
+    assert(hashmap_remove_batch(hashmap, lookup, 3, removed) == 2);
+    assert(removed[0].val_x == 4 && removed[2].val_x == 0);
+    assert(hashmap_len(hashmap) == 3);
+    assert(hashmap_get(hashmap, "sensor_1") == NULL);
+
+    hashmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_hashmap_remove_into() {
+    struct HashMap *hashmap = hashmap_init(sizeof(struct Measurement), NULL);
+    assert(hashmap != NULL);
+
+    assert(hashmap_insert(hashmap, "sensor_1", &(struct Measurement){.name="sensor", .val_x=1}) == true);
+    assert(hashmap_insert(hashmap, "sensor_2", &(struct Measurement){.name="sensor", .val_x=2}) == true);
+
+    // removed data item is copied to caller memory, it stays valid over later operations
+    struct Measurement removed;
+    assert(hashmap_remove_into(hashmap, "sensor_1", &removed) == true);
+    assert(hashmap_insert(hashmap, "sensor_3", &(struct Measurement){.name="sensor", .val_x=3}) == true);
+    assert(hashmap_remove(hashmap, "sensor_2") != NULL);
+    assert(removed.val_x == 1);
+
+    assert(hashmap_remove_into(hashmap, "sensor_1", &removed) == false);
+    assert(hashmap_len(hashmap) == 1);
+
+    hashmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_hashmap_reserve() {
+    // exactly 2^10 elements fit to 2^11 slots below the upper load factor
+    struct HashMapConfig config = {.item_size=sizeof(i32), .init_elems=1024};
+    struct HashMap *hashmap = hashmap_init_ex(&config);
+    assert(hashmap != NULL && hashmap->ex_capa == 11);
+    hashmap_free(hashmap);
+
+    config.init_elems = 0;
+    hashmap = hashmap_init_ex(&config);
+    assert(hashmap != NULL && hashmap->ex_capa == MAP_INIT_EXP_CAPACITY);
+
+    assert(hashmap_insert(hashmap, "first", &(i32){-1}) == true);
+    assert(hashmap_reserve(hashmap, 5000) == true);
+    assert(hashmap->ex_capa == 13);
+    void *slots = hashmap->slots;
+
+    for (i32 i=1; i<5000; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%d", "key", i);
+        assert(hashmap_insert(hashmap, key, &i) == true);
+    }
+    // no rehash during the load
+    assert(hashmap->slots == slots && hashmap_len(hashmap) == 5000);
+    assert(*(i32 *)hashmap_get(hashmap, "first") == -1);
+
+    // never shrinks
+    assert(hashmap_reserve(hashmap, 10) == true);
+    assert(hashmap->ex_capa == 13);
+    assert(hashmap_reserve(hashmap, MAP_CAPACITY(MAP_MAX_EXP_CAPACITY)) == false);
+    assert(hashmap->ex_capa == 13);
+
+    hashmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_hashmap_build() {
+    struct HashMap *hashmap = hashmap_init(sizeof(struct Measurement), NULL);
+    assert(hashmap != NULL);
+
+    char const *keys[] = {"sensor_1", "sensor_2", "sensor_3"};
+    struct Measurement const items[] = {
+        {.name="first", .val_x=1}, {.name="second", .val_x=2}, {.name="third", .val_x=3}
+    };
+    assert(hashmap_build(hashmap, keys, items, 3) == 3);
+    assert(hashmap_len(hashmap) == 3);
+
+    struct Measurement const *m = hashmap_get(hashmap, "sensor_2");
+    assert(m != NULL && m->val_x == 2 && strcmp(m->name, "second") == 0);
+
+    hashmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_hashmap_shrink_to_fit() {
+    struct HashMapConfig const config = {.item_size=sizeof(i32), .shrink=HASHMAP_SHRINK_NEVER};
+    struct HashMap *hashmap = hashmap_init_ex(&config);
+    assert(hashmap != NULL);
+
+    for (i32 i=0; i<1000; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%d", "key", i);
+        assert(hashmap_insert(hashmap, key, &i) == true);
+    }
+    for (i32 i=0; i<990; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%d", "key", i);
+        assert(hashmap_remove_into(hashmap, key, NULL) == true);
+    }
+    assert(hashmap_shrink_to_fit(hashmap) == true);
+    assert(hashmap_len(hashmap) == 10);
+    assert(*(i32 *)hashmap_get(hashmap, "key_995") == 995);
+
+    hashmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_hashmap_save_load() {
+    struct HashMap *hashmap = hashmap_init(sizeof(i32), NULL);
+    assert(hashmap != NULL);
+
+    for (i32 i=0; i<200; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%d", "key", i);
+        assert(hashmap_insert(hashmap, key, &i) == true);
+    }
+    assert(hashmap_save(hashmap, "hashmap_save_test.bin") == true);
+    hashmap_free(hashmap);
+
+    struct HashMap *mapped = hashmap_open_mmap("hashmap_save_test.bin");
+    assert(mapped != NULL);
+    assert(*(i32 *)hashmap_get(mapped, "key_42") == 42);
+    assert(hashmap_insert(mapped, "key_200", &(i32){200}) == false);
+
+    hashmap = hashmap_load("hashmap_save_test.bin");
+    remove("hashmap_save_test.bin");
+    assert(hashmap != NULL);
+    assert(hashmap_len(hashmap) == 200);
+    assert(*(i32 *)hashmap_get(hashmap, "key_123") == 123);
+    // mapping stays valid after the file is removed
+    assert(*(i32 *)hashmap_get(mapped, "key_123") == 123);
+
+    hashmap_free(mapped);
+    hashmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_hashmap_get_stats() {
+    struct HashMap *hashmap = hashmap_init(sizeof(i32), NULL);
+    assert(hashmap != NULL);
+
+    for (i32 i=0; i<100; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%d", "key", i);
+        assert(hashmap_insert(hashmap, key, &i) == true);
+    }
+    assert(hashmap_get(hashmap, "key_1") != NULL);
+    assert(hashmap_get(hashmap, "none") == NULL);
+
+    struct HashMapStats stats;
+    bool const counted = hashmap_get_stats(hashmap, &stats);
+    assert(stats.len == 100 && stats.capacity >= 100);
+
+    u64 total = 0;
+    for (size_t b=0; b<HASHMAP_STATS_PSL_BUCKETS; ++b) {
+        total += stats.psl_histogram[b];
+    }
+    assert(total == 100);
+    assert(counted ? stats.get_hits == 1 && stats.get_misses == 1 : stats.gets == 0);
+
+    struct HashMapLayoutStats layout;
+    hashmap_get_layout_stats(hashmap, &layout);
+    assert(layout.len == 100 && layout.max_psl == stats.max_psl);
+    assert(layout.cluster_count > 0 && layout.table_bytes == layout.capacity * layout.slot_bytes);
+
+    char json[1024];
+    size_t const len = hashmap_stats_dump_buffer(hashmap, json, sizeof json);
+    assert(len > 0 && len < sizeof json && strstr(json, "\"len\":100,") != NULL);
+
+    hashmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
 
 test_func hashmap_tests[] = {
     {"complete_hashmap", test_complete_hashmap},
     {"complete_hashmap_mid_size", test_complete_hashmap_mid_size},
     {"complete_hashmap_oversize_init", test_complete_hashmap_oversize_init},
+    {"complete_hashmap_over_narrow_capacity_init", test_complete_hashmap_over_narrow_capacity_init},
     {"hashmap_usage_in_search_algorithm", test_hashmap_usage_in_search_algorithm},
     {"hashmap_iter_apply", test_hashmap_iter_apply},
     {"hashmap_iter_apply_early_termination", test_hashmap_iter_apply_early_termination},
@@ -449,5 +840,16 @@ test_func hashmap_tests[] = {
     {"hashmap_readme_example", test_hashmap_readme_example},
     {"hashmap_two_hashmaps", test_hashmap_two_hashmaps},
     {"hashmap_usage_in_word_count_algorithm", test_hashmap_usage_in_word_count_algorithm},
+    {"hashmap_init_ex_incremental_resize", test_hashmap_init_ex_incremental_resize},
+    {"hashmap_init_ex_split_layout", test_hashmap_init_ex_split_layout},
+    {"hashmap_binary_keys", test_hashmap_binary_keys},
+    {"hashmap_u64_keys", test_hashmap_u64_keys},
+    {"hashmap_batch_operations", test_hashmap_batch_operations},
+    {"hashmap_remove_into", test_hashmap_remove_into},
+    {"hashmap_reserve", test_hashmap_reserve},
+    {"hashmap_build", test_hashmap_build},
+    {"hashmap_shrink_to_fit", test_hashmap_shrink_to_fit},
+    {"hashmap_save_load", test_hashmap_save_load},
+    {"hashmap_get_stats", test_hashmap_get_stats},
     {NULL, NULL},
 };
@@ -11,6 +11,14 @@ static void run_siphash_tests() {
     }
 }
 
+static void run_wyhash_tests() {
+    test_func *test = &wyhash_tests[0];
+
+    for (; test->name; test++) {
+        test->func();
+    }
+}
+
 static void run_random_tests() {
     test_func *test = &random_tests[0];
 
@@ -19,6 +27,14 @@ static void run_random_tests() {
     }
 }
 
+static void run_probe_tests() {
+    test_func *test = &probe_tests[0];
+
+    for (; test->name; test++) {
+        test->func();
+    }
+}
+
 static void run_map_tests() {
     test_func *test = &map_tests[0];
 
@@ -27,6 +43,38 @@ static void run_map_tests() {
     }
 }
 
+static void run_sharded_tests() {
+    test_func *test = &sharded_tests[0];
+
+    for (; test->name; test++) {
+        test->func();
+    }
+}
+
+static void run_shared_tests() {
+    test_func *test = &shared_tests[0];
+
+    for (; test->name; test++) {
+        test->func();
+    }
+}
+
+static void run_snapshot_tests() {
+    test_func *test = &snapshot_tests[0];
+
+    for (; test->name; test++) {
+        test->func();
+    }
+}
+
+static void run_stats_tests() {
+    test_func *test = &stats_tests[0];
+
+    for (; test->name; test++) {
+        test->func();
+    }
+}
+
 static void run_hashmap_tests() {
     test_func *test = &hashmap_tests[0];
 
@@ -42,12 +90,30 @@ int main() {
     fprintf(stdout, "running siphash tests...\n");
     run_siphash_tests();
 
+    fprintf(stdout, "\nrunning wyhash tests...\n");
+    run_wyhash_tests();
+
     fprintf(stdout, "\nrunning random tests...\n");
     run_random_tests();
 
+    fprintf(stdout, "\nrunning probe tests...\n");
+    run_probe_tests();
+
     fprintf(stdout, "\nrunning map tests...\n");
     run_map_tests();
 
+    fprintf(stdout, "\nrunning sharded tests...\n");
+    run_sharded_tests();
+
+    fprintf(stdout, "\nrunning shared tests...\n");
+    run_shared_tests();
+
+    fprintf(stdout, "\nrunning snapshot tests...\n");
+    run_snapshot_tests();
+
+    fprintf(stdout, "\nrunning stats tests...\n");
+    run_stats_tests();
+
     fprintf(stdout, "\nrunning hashmap tests...\n");
     run_hashmap_tests();
 
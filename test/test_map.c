@@ -5,6 +5,8 @@
 
 #include "common.h"
 #include "map.h"
+#include "bucket.h"
+#include "wyhash.h"
 
 
 typedef struct {
@@ -340,6 +342,47 @@ static void test_hashmap_init_for_too_large_size() {
     PRINT_SUCCESS(__func__);
 }
 
+static void test_hashmap_wide_hash_resizing() {
+#ifdef HASHMAP_WIDE_HASH
+    // capacity exponent over 20 is only addressable with the wide bucket layout
+    u32 const init_exp = 21;
+    struct HashMap *hashmap = hmap_init(sizeof(i32), init_exp, NULL);
+
+    assert(hashmap != NULL);
+    assert(hashmap->ex_capa == init_exp);
+    assert(hashmap->sz_bucket == sizeof(u64));
+
+    u32 const elems = 100;
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+
+    // first removal drops the capacity from 2^21 down to the minimum in one resize,
+    // entries must be re-indexed from the stored hash bits only
+    assert(hmap_remove(hashmap, "key_1") != NULL);
+    assert(hashmap->ex_capa < init_exp);
+    assert(hashmap->occ_slots == elems - 1);
+
+    for (u32 i=2; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+
+        i32 *value = hmap_get(hashmap, key);
+        assert(value != NULL);
+        assert(*value == (i32)i);
+    }
+
+    hmap_free(hashmap);
+#else
+    assert(MAP_MAX_EXP_CAPACITY == 20);
+    assert(hmap_init(sizeof(i32), MAP_MAX_EXP_CAPACITY + 1, NULL) == NULL);
+#endif
+
+    PRINT_SUCCESS(__func__);
+}
+
 static void test_hashmap_init_for_too_large_item_size() {
     size_t const type_size = UINT32_MAX;
     struct HashMap *hashmap = hmap_init(type_size, MAP_INIT_EXP_CAPACITY, NULL);
@@ -801,6 +844,1315 @@ static void test_hashmap_custom_allocation_with_remove_and_resize() {
     PRINT_SUCCESS(__func__);
 }
 
+static u32 clean_count_call_counter = 0;
+
+static void clean_count(void *data_item) {
+    assert(data_item != NULL);
+    clean_count_call_counter += 1;
+}
+
+static void test_hashmap_incremental_resizing_up() {
+    struct HashMapConfig const config = {
+        .item_size=sizeof(i32),
+        .clean_func=clean_count,
+        .incremental_resize=true
+    };
+    u32 const init_exp = 8;
+    struct HashMap *hashmap = hmap_init_ex(&config, init_exp);
+
+    assert(hashmap != NULL);
+    assert(hashmap->incremental == true);
+    assert(hashmap->old_slots == NULL);
+
+    // resize is triggered when the 232nd key gets inserted (231 >= 0.9 * 256)
+    u32 const elems = 232;
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+    assert(hashmap->ex_capa == init_exp + 1);
+    assert(hashmap->occ_slots == elems);
+    // only a bounded number of slots were moved by the insertion
+    assert(hashmap->old_slots != NULL);
+    assert(hashmap->old_ex_capa == init_exp);
+    assert(hashmap->old_occ_slots > 0);
+    assert(hashmap->old_occ_slots < elems);
+    assert(get_occupied_slot_count(hashmap) == elems);
+
+    // keys are found from both tables during migration
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+
+        i32 *value = hmap_get(hashmap, key);
+        assert(value != NULL);
+        assert(*value == (i32)i);
+    }
+
+    // updates and removals of keys that might not be migrated yet
+    assert(hmap_insert(hashmap, "key_1", &(i32){-1}) == true);
+    assert(*(i32 *)hmap_get(hashmap, "key_1") == -1);
+    assert(*(i32 *)hmap_remove(hashmap, "key_2") == 2);
+    assert(hmap_get(hashmap, "key_2") == NULL);
+    assert(hmap_remove(hashmap, "key_2") == NULL);
+    assert(hashmap->occ_slots == elems - 1);
+
+    // operations keep migrating until the old table is released
+    for (u32 i=elems+1; hashmap->old_slots != NULL; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+    assert(hashmap->old_occ_slots == 0);
+    assert(hashmap->ex_capa == init_exp + 1);
+    assert(get_occupied_slot_count(hashmap) == hashmap->occ_slots);
+
+    assert(*(i32 *)hmap_get(hashmap, "key_1") == -1);
+    assert(*(i32 *)hmap_get(hashmap, "key_232") == 232);
+
+    clean_count_call_counter = 0;
+    u32 const len = hmap_len(hashmap);
+    hmap_free(hashmap);
+    assert(clean_count_call_counter == len);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_hashmap_incremental_resizing_down() {
+    struct HashMapConfig const config = {
+        .item_size=sizeof(i32),
+        .clean_func=clean_count,
+        .incremental_resize=true
+    };
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+
+    u32 const elems = 500;
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+    assert(hashmap->occ_slots == elems);
+
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+
+        i32 *value = hmap_remove(hashmap, key);
+        assert(value != NULL);
+        assert(*value == (i32)i);
+        assert(hmap_get(hashmap, key) == NULL);
+        assert(get_occupied_slot_count(hashmap) == elems - i);
+    }
+    assert(hashmap->occ_slots == 0);
+    assert(hashmap->ex_capa == MAP_INIT_EXP_CAPACITY);
+
+    // clean up with a migration in progress must reach slots of both tables
+    for (u32 i=1; i<=14; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+    clean_count_call_counter = 0;
+    hmap_free(hashmap);
+    assert(clean_count_call_counter == 14);
+
+    PRINT_SUCCESS(__func__);
+}
+
+
+static void test_hashmap_split_layout() {
+    struct HashMapConfig const config = {
+        .item_size=sizeof(i32),
+        .clean_func=clean_count,
+        .layout=HASHMAP_LAYOUT_SPLIT
+    };
+    u32 const init_exp = 6;
+    struct HashMap *hashmap = hmap_init_ex(&config, init_exp);
+
+    assert(hashmap != NULL);
+    assert(hashmap->layout == HASHMAP_LAYOUT_SPLIT);
+
+    u32 const elems = 2000;
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+    assert(hashmap->ex_capa > init_exp);
+    assert(hashmap->occ_slots == elems);
+    assert(get_occupied_slot_count(hashmap) == elems);
+
+    // meta data array is dense, keys and data items follow it in their own arrays
+    size_t const capacity = MAP_CAPACITY(hashmap->ex_capa);
+    char const *keys = (char *)hashmap->slots + capacity * hashmap->sz_bucket;
+    i32 const *items = (i32 *)(keys + capacity * hashmap->sz_key);
+
+    i32 *value = hmap_get(hashmap, "key_1");
+    assert(value != NULL);
+    assert(*value == 1);
+    assert(value >= items && value < items + capacity);
+    size_t const idx = value - items;
+    assert(strcmp(keys + idx * hashmap->sz_key, "key_1") == 0);
+
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+
+        value = hmap_get(hashmap, key);
+        assert(value != NULL);
+        assert(*value == (i32)i);
+    }
+    assert(hmap_get(hashmap, "key_0") == NULL);
+
+    for (u32 i=1; i<=elems; i+=2) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(*(i32 *)hmap_remove(hashmap, key) == (i32)i);
+    }
+    assert(hashmap->occ_slots == elems / 2);
+    assert(get_occupied_slot_count(hashmap) == elems / 2);
+    assert(*(i32 *)hmap_get(hashmap, "key_2000") == 2000);
+
+    clean_count_call_counter = 0;
+    hmap_free(hashmap);
+    assert(clean_count_call_counter == elems / 2);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_hashmap_split_layout_incremental_resizing() {
+    struct HashMapConfig const config = {
+        .item_size=sizeof(i32),
+        .incremental_resize=true,
+        .layout=HASHMAP_LAYOUT_SPLIT
+    };
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+
+    u32 const elems = 3000;
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+
+        if (i % 500 == 0) {
+            assert(get_occupied_slot_count(hashmap) == i);
+        }
+    }
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(*(i32 *)hmap_get(hashmap, key) == (i32)i);
+    }
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(*(i32 *)hmap_remove(hashmap, key) == (i32)i);
+    }
+    assert(hashmap->occ_slots == 0);
+    assert(hashmap->old_slots == NULL);
+    assert(hashmap->ex_capa == MAP_INIT_EXP_CAPACITY);
+
+    hmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void check_packing(struct HashMapConfig const *config, size_t item_align) {
+    struct HashMap *hashmap = hmap_init_ex(config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    assert(hashmap->item_align == item_align);
+    assert(hashmap->sz_slot % hashmap->sz_bucket == 0 && hashmap->sz_slot % item_align == 0);
+    assert((hashmap->sz_bucket + hashmap->sz_key) % item_align == 0);
+    // no more padding of the 20 byte key field than needed for the alignment
+    assert(hashmap->sz_key >= 20 && hashmap->sz_key < 20 + item_align);
+
+    u8 item[16];
+    u32 const elems = 500;
+    for (u32 i=0; i<elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        memset(item, (u8)i, sizeof item);
+        assert(hmap_insert(hashmap, key, item) == true);
+    }
+    for (u32 i=0; i<elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        u8 const *value = hmap_get(hashmap, key);
+        assert(value != NULL && (uintptr_t)value % item_align == 0);
+
+        memset(item, (u8)i, sizeof item);
+        assert(memcmp(value, item, config->item_size) == 0);
+    }
+    hmap_free(hashmap);
+}
+
+static void test_hashmap_packing() {
+    struct HashMapConfig config = {.item_size=1};
+
+    // natural alignment is the largest power of two dividing the item size
+    size_t const sizes[] = {1, 2, 4, 5, 12, 16};
+    size_t const natural[] = {1, 2, 4, 1, 4, sizeof(void *)};
+    for (size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); ++i) {
+        config.item_size = sizes[i];
+        config.packing = HASHMAP_PACKING_NATURAL;
+        check_packing(&config, natural[i]);
+
+        config.packing = HASHMAP_PACKING_ALIGNED;
+        check_packing(&config, _Alignof(max_align_t));
+
+        config.packing = HASHMAP_PACKING_PACKED;
+        check_packing(&config, 1);
+    }
+    // data items of the split layout get padded to their alignment
+    config = (struct HashMapConfig){
+        .item_size=12, .layout=HASHMAP_LAYOUT_SPLIT, .packing=HASHMAP_PACKING_ALIGNED
+    };
+    check_packing(&config, _Alignof(max_align_t));
+
+    // natural packing pads a slot of a 4 byte item only to the meta data alignment
+    config = (struct HashMapConfig){.item_size=sizeof(i32)};
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    assert(hashmap->sz_slot == (hashmap->sz_bucket == 4 ? 28 : 32));
+    hmap_free(hashmap);
+
+    config.packing = HASHMAP_PACKING_PACKED + 1;
+    assert(hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY) == NULL);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void make_long_key(char *buffer, size_t buffer_len, u32 i) {
+    // lengths vary from inline size up to a couple of hundred bytes
+    size_t const len = 10 + (i * 37) % 190;
+    assert(len < buffer_len);
+
+    int const prefix_len = snprintf(buffer, buffer_len, "https://example.com/%u/", i);
+    for (size_t k=prefix_len; k<len; ++k) {
+        buffer[k] = 'a' + (char)((i + k) % 26);
+    }
+    buffer[len > (size_t)prefix_len ? len : (size_t)prefix_len] = '\0';
+}
+
+static u32 long_keys_seen = 0;
+
+static bool check_long_key(char const *key, void *data) {
+    char expected[256];
+    make_long_key(expected, sizeof expected, *(u32 *)data);
+    assert(strcmp(key, expected) == 0);
+    long_keys_seen += 1;
+    return true;
+}
+
+static void test_hashmap_long_keys() {
+    struct HashMapConfig const config = {.item_size=sizeof(u32), .long_keys=true};
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+
+    assert(hashmap != NULL);
+    assert(hashmap->long_keys == true);
+    assert(hashmap->arena.len == 0);
+
+    // short keys stay inline
+    assert(hmap_insert(hashmap, "short_key", &(u32){0}) == true);
+    assert(hmap_insert(hashmap, "exactly_19_bytes_ok", &(u32){0}) == true);
+    assert(hashmap->arena.len == 0);
+    assert(hmap_remove(hashmap, "short_key") != NULL);
+    assert(hmap_remove(hashmap, "exactly_19_bytes_ok") != NULL);
+
+    u32 const elems = 3000;
+    for (u32 i=1; i<=elems; ++i) {
+        char key[256];
+        make_long_key(key, sizeof key, i);
+        assert(hmap_insert(hashmap, key, &i) == true);
+    }
+    assert(hashmap->occ_slots == elems);
+    assert(hashmap->arena.len > 0);
+    assert(hashmap->arena.dead == 0);
+
+    // reinserting existing keys does not grow the arena
+    size_t const arena_len = hashmap->arena.len;
+    for (u32 i=1; i<=elems; ++i) {
+        char key[256];
+        make_long_key(key, sizeof key, i);
+        assert(hmap_insert(hashmap, key, &i) == true);
+    }
+    assert(hashmap->arena.len == arena_len);
+    assert(hashmap->occ_slots == elems);
+
+    for (u32 i=1; i<=elems; ++i) {
+        char key[256];
+        make_long_key(key, sizeof key, i);
+
+        u32 *value = hmap_get(hashmap, key);
+        assert(value != NULL);
+        assert(*value == i);
+
+        // same prefix and length but different last byte
+        key[strlen(key) - 1] ^= 1;
+        assert(hmap_get(hashmap, key) == NULL);
+    }
+
+    // removing most of the keys compacts the arena
+    for (u32 i=1; i<=elems; ++i) {
+        if (i % 10 == 0) continue;
+
+        char key[256];
+        make_long_key(key, sizeof key, i);
+        assert(*(u32 *)hmap_remove(hashmap, key) == i);
+    }
+    assert(hashmap->occ_slots == elems / 10);
+    assert(hashmap->arena.len < arena_len / 2);
+
+    for (u32 i=10; i<=elems; i+=10) {
+        char key[256];
+        make_long_key(key, sizeof key, i);
+        assert(*(u32 *)hmap_get(hashmap, key) == i);
+    }
+    long_keys_seen = 0;
+    assert(hmap_iter_apply(hashmap, check_long_key) == true);
+    assert(long_keys_seen == elems / 10);
+
+    hmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_hashmap_long_keys_incremental_resizing() {
+    struct HashMapConfig const config = {
+        .item_size=sizeof(u32),
+        .incremental_resize=true,
+        .long_keys=true,
+        .layout=HASHMAP_LAYOUT_SPLIT
+    };
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+
+    u32 const elems = 2000;
+    for (u32 i=1; i<=elems; ++i) {
+        char key[256];
+        make_long_key(key, sizeof key, i);
+        assert(hmap_insert(hashmap, key, &i) == true);
+    }
+    for (u32 i=1; i<=elems; i+=2) {
+        char key[256];
+        make_long_key(key, sizeof key, i);
+        assert(*(u32 *)hmap_remove(hashmap, key) == i);
+    }
+    for (u32 i=1; i<=elems; ++i) {
+        char key[256];
+        make_long_key(key, sizeof key, i);
+
+        u32 *value = hmap_get(hashmap, key);
+        if (i % 2 == 1) {
+            assert(value == NULL);
+        } else {
+            assert(value != NULL && *value == i);
+        }
+    }
+    long_keys_seen = 0;
+    assert(hmap_iter_apply(hashmap, check_long_key) == true);
+    assert(long_keys_seen == elems / 2);
+
+    hmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static u64 u64_keys_sum = 0;
+
+static bool sum_u64_keys(u64 key, void *data) {
+    assert(*(u64 *)data == key);
+    u64_keys_sum += key;
+    return true;
+}
+
+static void check_u64_map(struct HashMapConfig const *config) {
+    struct HashMap *hashmap = hmap_init_ex(config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    assert(hashmap->key_type == HASHMAP_KEY_U64);
+
+    struct HashMap *str_hashmap = hmap_init(sizeof(u64), MAP_INIT_EXP_CAPACITY, NULL);
+    assert(str_hashmap != NULL);
+    // 8 byte key field (plus alignment padding) instead of the string key field
+    assert(hashmap->sz_key == sizeof(u64) + hashmap->sz_bucket % sizeof(void *));
+    assert(hashmap->sz_slot < str_hashmap->sz_slot);
+    hmap_free(str_hashmap);
+
+    u64 const elems = 5000;
+    for (u64 i=0; i<elems; ++i) {
+        // spread keys over the whole range, including 0
+        u64 const key = i * UINT64_C(0x9e3779b97f4a7c15);
+        assert(hmap_insert_u64(hashmap, key, &key) == true);
+    }
+    assert(hmap_insert_u64(hashmap, UINT64_MAX, &(u64){UINT64_MAX}) == true);
+    assert(hashmap->occ_slots == elems + 1);
+
+    for (u64 i=0; i<elems; ++i) {
+        u64 const key = i * UINT64_C(0x9e3779b97f4a7c15);
+        u64 *value = hmap_get_u64(hashmap, key);
+        assert(value != NULL);
+        assert(*value == key);
+        assert(hmap_get_u64(hashmap, key + 1) == NULL);
+    }
+    assert(*(u64 *)hmap_get_u64(hashmap, UINT64_MAX) == UINT64_MAX);
+
+    // updating an existing key
+    assert(hmap_insert_u64(hashmap, UINT64_MAX, &(u64){UINT64_MAX}) == true);
+    assert(hashmap->occ_slots == elems + 1);
+    assert(*(u64 *)hmap_remove_u64(hashmap, UINT64_MAX) == UINT64_MAX);
+    assert(hmap_remove_u64(hashmap, UINT64_MAX) == NULL);
+
+    u64 expected_sum = 0;
+    for (u64 i=0; i<elems; ++i) {
+        u64 const key = i * UINT64_C(0x9e3779b97f4a7c15);
+        if (i % 4 == 0) {
+            assert(*(u64 *)hmap_remove_u64(hashmap, key) == key);
+        } else {
+            expected_sum += key;
+        }
+    }
+    assert(hashmap->occ_slots == elems - elems / 4);
+    assert(get_occupied_slot_count(hashmap) == hashmap->occ_slots);
+
+    u64_keys_sum = 0;
+    assert(hmap_iter_apply_u64(hashmap, sum_u64_keys) == true);
+    assert(u64_keys_sum == expected_sum);
+
+    // string key operations are not available
+    assert(hmap_insert(hashmap, "key", &(u64){1}) == false);
+    assert(hmap_get(hashmap, "key") == NULL);
+    assert(hmap_remove(hashmap, "key") == NULL);
+
+    hmap_free(hashmap);
+}
+
+static void test_hashmap_u64_keys() {
+    struct HashMapConfig config = {.item_size=sizeof(u64), .key_type=HASHMAP_KEY_U64};
+    check_u64_map(&config);
+
+    config.dos_resistant = true;
+    check_u64_map(&config);
+
+    config.dos_resistant = false;
+    config.incremental_resize = true;
+    config.layout = HASHMAP_LAYOUT_SPLIT;
+    check_u64_map(&config);
+
+    // integer key operations are not available for string keys
+    struct HashMap *hashmap = hmap_init(sizeof(u64), MAP_INIT_EXP_CAPACITY, NULL);
+    assert(hashmap != NULL);
+    assert(hmap_insert_u64(hashmap, 1, &(u64){1}) == false);
+    assert(hmap_get_u64(hashmap, 1) == NULL);
+    assert(hmap_remove_u64(hashmap, 1) == NULL);
+    assert(hmap_iter_apply_u64(hashmap, sum_u64_keys) == false);
+    hmap_free(hashmap);
+
+    struct HashMapConfig const invalid_config = {
+        .item_size=sizeof(u64),
+        .key_type=HASHMAP_KEY_U64,
+        .long_keys=true
+    };
+    assert(hmap_init_ex(&invalid_config, MAP_INIT_EXP_CAPACITY) == NULL);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static u32 custom_hash_call_counter = 0;
+
+static u64 custom_hash(void const *data, size_t len, u8 const key[16]) {
+    // FNV-1a seeded with the random key
+    u64 hash = UINT64_C(0xcbf29ce484222325);
+    for (size_t i=0; i<16; ++i) {
+        hash = (hash ^ key[i]) * UINT64_C(0x100000001b3);
+    }
+    for (size_t i=0; i<len; ++i) {
+        hash = (hash ^ ((u8 const *)data)[i]) * UINT64_C(0x100000001b3);
+    }
+    custom_hash_call_counter += 1;
+    return hash;
+}
+
+static void check_hash_choice(struct HashMapConfig const *config) {
+    struct HashMap *hashmap = hmap_init_ex(config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+
+    u32 const elems = 2000;
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+    assert(hashmap->occ_slots == elems);
+
+    for (u32 i=1; i<=elems; ++i) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(*(i32 *)hmap_get(hashmap, key) == (i32)i);
+    }
+    for (u32 i=1; i<=elems; i+=2) {
+        char key[10];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(*(i32 *)hmap_remove(hashmap, key) == (i32)i);
+    }
+    assert(hmap_get(hashmap, "key_1") == NULL);
+    assert(*(i32 *)hmap_get(hashmap, "key_2") == 2);
+    assert(get_occupied_slot_count(hashmap) == elems / 2);
+
+    hmap_free(hashmap);
+}
+
+static void test_hashmap_hash_functions() {
+    struct HashMapConfig config = {.item_size=sizeof(i32)};
+
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL && hashmap->hash_func == siphash);
+    hmap_free(hashmap);
+
+    config.hash = HASHMAP_HASH_SIPHASH24;
+    check_hash_choice(&config);
+
+    config.hash = HASHMAP_HASH_SIPHASH13;
+    hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL && hashmap->hash_func == siphash13);
+    hmap_free(hashmap);
+    check_hash_choice(&config);
+
+    config.hash = HASHMAP_HASH_WYHASH;
+    hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL && hashmap->hash_func == wyhash);
+    hmap_free(hashmap);
+    check_hash_choice(&config);
+
+    config.hash = HASHMAP_HASH_CUSTOM;
+    config.hash_func = custom_hash;
+    custom_hash_call_counter = 0;
+    check_hash_choice(&config);
+    assert(custom_hash_call_counter > 0);
+
+    // integer keys use the inlined mixer by default, SipHash-2-4 if dos resistance is asked
+    struct HashMapConfig u64_config = {.item_size=sizeof(i32), .key_type=HASHMAP_KEY_U64};
+    hashmap = hmap_init_ex(&u64_config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL && hashmap->hash_func == NULL);
+    hmap_free(hashmap);
+
+    u64_config.dos_resistant = true;
+    hashmap = hmap_init_ex(&u64_config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL && hashmap->hash_func == siphash);
+    hmap_free(hashmap);
+
+    u64_config.hash = HASHMAP_HASH_WYHASH;
+    hashmap = hmap_init_ex(&u64_config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL && hashmap->hash_func == wyhash);
+    assert(hmap_insert_u64(hashmap, 42, &(i32){42}) == true);
+    assert(*(i32 *)hmap_get_u64(hashmap, 42) == 42);
+    hmap_free(hashmap);
+
+    // custom hash function must be given, hash choice must be known
+    config.hash_func = NULL;
+    assert(hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY) == NULL);
+    config.hash = (enum HashMapHash)(HASHMAP_HASH_CUSTOM + 1);
+    assert(hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY) == NULL);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void check_batch_operations(struct HashMapConfig const *config) {
+    struct HashMap *hashmap = hmap_init_ex(config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+
+    // count not divisible by the batch group size, a few invalid keys included
+    u32 const elems = 1001;
+    char (*key_bytes)[32] = malloc(elems * sizeof *key_bytes);
+    char const **keys = malloc(elems * sizeof *keys);
+    i32 *values = malloc(elems * sizeof *values);
+    void const **data = malloc(elems * sizeof *data);
+    void **items = malloc(elems * sizeof *items);
+    assert(key_bytes && keys && values && data && items);
+
+    u32 invalid = 0;
+    for (u32 i=0; i<elems; ++i) {
+        snprintf(key_bytes[i], sizeof key_bytes[i], "%s_%u", "batch_key", i);
+        keys[i] = key_bytes[i];
+        values[i] = (i32)i;
+        data[i] = &values[i];
+
+        if (i % 100 == 7) {
+            keys[i] = NULL;
+            invalid += 1;
+        }
+    }
+    u32 const valid = elems - invalid;
+
+    assert(hmap_insert_batch(hashmap, keys, elems, data) == valid);
+    assert(hashmap->occ_slots == valid);
+    // repeated insertions replace the data items
+    assert(hmap_insert_batch(hashmap, keys, 10, data) == 10 - 1);
+    assert(hashmap->occ_slots == valid);
+
+    for (u32 i=0; i<elems; ++i) {
+        items[i] = (void *)&values[0];
+    }
+    assert(hmap_get_batch(hashmap, keys, elems, items) == valid);
+
+    for (u32 i=0; i<elems; ++i) {
+        if (keys[i] == NULL) {
+            assert(items[i] == NULL);
+        } else {
+            assert(items[i] == hmap_get(hashmap, keys[i]));
+            assert(*(i32 *)items[i] == (i32)i);
+        }
+    }
+
+    // remove every other key, removed data items come back in key order
+    char const **removed_keys = malloc(elems * sizeof *removed_keys);
+    i32 *removed = malloc(elems * sizeof *removed);
+    assert(removed_keys && removed);
+
+    u32 remove_count = 0;
+    for (u32 i=0; i<elems; i+=2) {
+        removed_keys[remove_count++] = keys[i];
+    }
+    memset(removed, 0xff, elems * sizeof *removed);
+    u32 const removed_valid = hmap_remove_batch(hashmap, removed_keys, remove_count, removed);
+    assert(hashmap->occ_slots == valid - removed_valid);
+    assert(get_occupied_slot_count(hashmap) == hashmap->occ_slots);
+
+    for (u32 j=0; j<remove_count; ++j) {
+        assert(removed_keys[j] == NULL ? removed[j] == -1 : removed[j] == (i32)(2 * j));
+    }
+    // already removed keys are not found, the buffer is optional
+    assert(hmap_remove_batch(hashmap, removed_keys, remove_count, NULL) == 0);
+    assert(hmap_get_batch(hashmap, removed_keys, remove_count, items) == 0);
+
+    for (u32 i=1; i<elems; i+=2) {
+        assert(keys[i] == NULL || *(i32 *)hmap_get(hashmap, keys[i]) == (i32)i);
+    }
+
+    free(removed);
+    free(removed_keys);
+    free(items);
+    free(data);
+    free(values);
+    free(keys);
+    free(key_bytes);
+    hmap_free(hashmap);
+}
+
+static void test_hashmap_batch_operations() {
+    struct HashMapConfig config = {.item_size=sizeof(i32)};
+    check_batch_operations(&config);
+
+    config.incremental_resize = true;
+    config.layout = HASHMAP_LAYOUT_SPLIT;
+    check_batch_operations(&config);
+
+    config.hash = HASHMAP_HASH_WYHASH;
+    check_batch_operations(&config);
+
+    config.incremental_resize = false;
+    config.layout = HASHMAP_LAYOUT_INTERLEAVED;
+    config.hash = HASHMAP_HASH_CUSTOM;
+    config.hash_func = custom_hash;
+    check_batch_operations(&config);
+
+    // too long keys are invalid as usual, unless long keys are enabled
+    char const *keys[] = {"short", "a key that is longer than the inline key field"};
+    void const *data[] = {&(i32){1}, &(i32){2}};
+    void *items[2];
+
+    struct HashMapConfig const long_config = {.item_size=sizeof(i32), .long_keys=true};
+    struct HashMap *hashmap = hmap_init_ex(&long_config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    assert(hmap_insert_batch(hashmap, keys, 2, data) == 2);
+    assert(hmap_get_batch(hashmap, keys, 2, items) == 2);
+    assert(*(i32 *)items[1] == 2);
+    hmap_free(hashmap);
+
+    hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    assert(hmap_insert_batch(hashmap, keys, 2, data) == 1);
+    assert(hmap_get_batch(hashmap, keys, 2, items) == 1);
+    assert(items[1] == NULL);
+    hmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+struct LargeItem {
+    u32 id;
+    u8 payload[300];
+};
+
+static void check_remove_into(struct HashMapConfig const *config) {
+    struct HashMap *hashmap = hmap_init_ex(config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+
+    // many displacements and resizes up and down on the way
+    u32 const elems = 1500;
+    for (u32 i=0; i<elems; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        struct LargeItem item = {.id=i};
+        memset(item.payload, (u8)i, sizeof item.payload);
+        assert(hmap_insert(hashmap, key, &item) == true);
+    }
+    assert(hashmap->occ_slots == elems);
+
+    for (u32 i=0; i<elems; i+=2) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        struct LargeItem item = {.id=UINT32_MAX};
+        assert(hmap_remove_into(hashmap, key, &item) == true);
+        assert(item.id == i);
+        assert(item.payload[0] == (u8)i && item.payload[sizeof item.payload - 1] == (u8)i);
+
+        // removed key is gone, the buffer is left untouched
+        item.id = UINT32_MAX;
+        assert(hmap_remove_into(hashmap, key, &item) == false);
+        assert(item.id == UINT32_MAX);
+    }
+    for (u32 i=1; i<elems; i+=2) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        struct LargeItem const *item = hmap_get(hashmap, key);
+        assert(item != NULL && item->id == i && item->payload[42] == (u8)i);
+    }
+    assert(get_occupied_slot_count(hashmap) == elems / 2);
+
+    // buffer is optional
+    for (u32 i=1; i<elems; i+=2) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_remove_into(hashmap, key, NULL) == true);
+    }
+    assert(hashmap->occ_slots == 0);
+    assert(hmap_remove_into(hashmap, NULL, NULL) == false);
+
+    hmap_free(hashmap);
+}
+
+static void test_hashmap_remove_into() {
+    // slots too large for the stack use the temporary slots while in flight
+    struct HashMapConfig config = {.item_size=sizeof(struct LargeItem)};
+    check_remove_into(&config);
+
+    config.layout = HASHMAP_LAYOUT_SPLIT;
+    config.incremental_resize = true;
+    check_remove_into(&config);
+
+    // slot that fits to the stack
+    struct HashMap *hashmap = hmap_init(sizeof(i32), MAP_INIT_EXP_CAPACITY, NULL);
+    assert(hashmap != NULL && hashmap->sz_slot <= 256);
+
+    for (u32 i=0; i<1000; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+    i32 value = -1;
+    assert(hmap_remove_into(hashmap, "key_500", &value) == true);
+    assert(value == 500);
+    assert(hmap_remove_into_n(hashmap, "key_501", 7, &value) == true);
+    assert(value == 501);
+    assert(*(i32 *)hmap_remove(hashmap, "key_502") == 502);
+
+    for (u32 i=0; i<1000; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        i32 const *found = hmap_get(hashmap, key);
+        assert(i >= 500 && i <= 502 ? found == NULL : *found == (i32)i);
+    }
+    hmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+/*
+Allocator keeping the size of every allocation in a header, so that sizes given back
+on freeing can be checked.
+*/
+struct CountingAllocator {
+    size_t live_allocs;
+    size_t live_bytes;
+    size_t total_allocs;
+};
+
+static void* counting_alloc(void *ctx, size_t size) {
+    struct CountingAllocator *counter = ctx;
+    max_align_t *header = malloc(sizeof(max_align_t) + size);
+    if (header == NULL) return NULL;
+
+    *(size_t *)header = size;
+    counter->live_allocs += 1;
+    counter->live_bytes += size;
+    counter->total_allocs += 1;
+
+    return header + 1;
+}
+
+static void counting_free(void *ctx, void *ptr, size_t size) {
+    struct CountingAllocator *counter = ctx;
+    max_align_t *header = (max_align_t *)ptr - 1;
+
+    assert(*(size_t *)header == size);
+    counter->live_allocs -= 1;
+    counter->live_bytes -= size;
+    free(header);
+}
+
+static void* counting_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+    void *new_ptr = counting_alloc(ctx, new_size);
+
+    if (new_ptr && ptr) {
+        memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+        counting_free(ctx, ptr, old_size);
+    }
+    return new_ptr;
+}
+
+static void check_allocator(struct HashMapConfig *config, struct CountingAllocator *counter) {
+    struct HashMap *hashmap = hmap_init_ex(config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    // struct, slots and temporary slots
+    assert(counter->live_allocs == 3);
+
+    for (u32 i=0; i<3000; ++i) {
+        char key[48];
+        snprintf(key, sizeof key, "%s_%u", "key_long_enough_for_the_arena", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+    for (u32 i=0; i<3000; ++i) {
+        char key[48];
+        snprintf(key, sizeof key, "%s_%u", "key_long_enough_for_the_arena", i);
+        assert(*(i32 *)hmap_get(hashmap, key) == (i32)i);
+    }
+    // resizes down and compacts the arena
+    for (u32 i=0; i<2900; ++i) {
+        char key[48];
+        snprintf(key, sizeof key, "%s_%u", "key_long_enough_for_the_arena", i);
+        assert(hmap_remove_into(hashmap, key, NULL) == true);
+    }
+    assert(counter->total_allocs > 10);
+
+    hmap_free(hashmap);
+    assert(counter->live_allocs == 0 && counter->live_bytes == 0);
+}
+
+static void test_hashmap_allocator() {
+    struct CountingAllocator counter = {0};
+    struct HashMapConfig config = {
+        .item_size=sizeof(i32),
+        .long_keys=true,
+        .allocator={.alloc_func=counting_alloc, .free_func=counting_free, .ctx=&counter},
+    };
+    check_allocator(&config, &counter);
+
+    config.allocator.realloc_func = counting_realloc;
+    config.incremental_resize = true;
+    config.layout = HASHMAP_LAYOUT_SPLIT;
+    check_allocator(&config, &counter);
+
+    config.allocator.free_func = NULL;
+    assert(hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY) == NULL);
+    assert(counter.live_allocs == 0);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_hashmap_huge_pages() {
+    struct CountingAllocator counter = {0};
+    struct HashMapConfig config = {
+        .item_size=sizeof(i32),
+        .huge_pages=true,
+        .allocator={.alloc_func=counting_alloc, .free_func=counting_free, .ctx=&counter},
+        // aligned packing pads the slots to at least 32 bytes
+        .packing=HASHMAP_PACKING_ALIGNED,
+    };
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL && hashmap->sz_slot >= 32);
+
+    // 2^16 slots of at least 32 bytes take at least 2 MiB
+    u32 const elems = 55000;
+    for (u32 i=0; i<elems; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+    assert(hashmap->ex_capa == 16);
+#ifdef __linux__
+    // slots were mapped at a huge page boundary instead of coming from the allocator
+    assert(((size_t)hashmap->slots & (((size_t)2 << 20) - 1)) == 0);
+    assert(counter.live_allocs == 2);
+#endif
+    for (u32 i=0; i<elems; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(*(i32 *)hmap_get(hashmap, key) == (i32)i);
+    }
+    // back to small tables from the allocator
+    for (u32 i=0; i<elems; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_remove_into(hashmap, key, NULL) == true);
+    }
+    assert(hashmap->ex_capa == MAP_INIT_EXP_CAPACITY);
+    assert(counter.live_allocs == 3);
+
+    hmap_free(hashmap);
+    assert(counter.live_allocs == 0);
+
+    PRINT_SUCCESS(__func__);
+}
+
+/*
+Fill the hash map to `elems` keys and then remove and insert back `swing` keys `rounds` times.
+Returns the count of capacity changes during the oscillation.
+*/
+static u32 count_oscillation_resizes(struct HashMap *hashmap, u32 elems, u32 swing, u32 rounds) {
+    char key[16];
+
+    for (u32 i=0; i<elems; ++i) {
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+    u32 resizes = 0;
+    u32 ex_capa = hashmap->ex_capa;
+
+    for (u32 round=0; round<rounds; ++round) {
+        for (u32 i=elems-swing; i<elems; ++i) {
+            snprintf(key, sizeof key, "%s_%u", "key", i);
+            assert(hmap_remove_into(hashmap, key, NULL) == true);
+            resizes += hashmap->ex_capa != ex_capa;
+            ex_capa = hashmap->ex_capa;
+        }
+        for (u32 i=elems-swing; i<elems; ++i) {
+            snprintf(key, sizeof key, "%s_%u", "key", i);
+            assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+            resizes += hashmap->ex_capa != ex_capa;
+            ex_capa = hashmap->ex_capa;
+        }
+    }
+    assert(hmap_len(hashmap) == elems);
+
+    return resizes;
+}
+
+static void test_hashmap_shrink_policies() {
+    // 2^10 slots, oscillating between 390 and 470 keys crosses both 0.4 and 0.45 of 1024
+    struct HashMapConfig config = {.item_size=sizeof(i32)};
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    assert(count_oscillation_resizes(hashmap, 470, 80, 10) == 20);
+    hmap_free(hashmap);
+
+    config.shrink = HASHMAP_SHRINK_HYSTERESIS;
+    hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    assert(count_oscillation_resizes(hashmap, 470, 80, 10) == 0);
+
+    // shrinks once the load is at most half of the upper load factor after halving
+    for (u32 i=0; i<470; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_remove_into(hashmap, key, NULL) == true);
+        if (hmap_len(hashmap) > 230) assert(hashmap->ex_capa == 10);
+    }
+    assert(hashmap->ex_capa == MAP_INIT_EXP_CAPACITY);
+    hmap_free(hashmap);
+
+    config.shrink = HASHMAP_SHRINK_NEVER;
+    hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    assert(count_oscillation_resizes(hashmap, 470, 470, 2) == 0);
+    assert(hashmap->ex_capa == 10);
+
+    for (u32 i=0; i<460; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_remove_into(hashmap, key, NULL) == true);
+    }
+    assert(hashmap->ex_capa == 10);
+
+    // 10 keys fit to 16 slots below the upper load factor
+    assert(hmap_shrink_to_fit(hashmap) == true);
+    assert(hashmap->ex_capa == MAP_INIT_EXP_CAPACITY);
+    for (u32 i=460; i<470; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(*(i32 *)hmap_get(hashmap, key) == (i32)i);
+    }
+    assert(hmap_insert(hashmap, "key_new", &(i32){-1}) == true);
+    assert(hashmap->ex_capa == MAP_INIT_EXP_CAPACITY);
+    hmap_free(hashmap);
+
+    config.shrink = 42;
+    assert(hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY) == NULL);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_hashmap_load_factors() {
+    struct HashMapConfig config = {.item_size=sizeof(i32), .max_load_factor=0.5};
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    assert(hashmap->max_load == 0.5 && hashmap->min_load < 0.25);
+
+    for (u32 i=0; i<600; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+        assert(hmap_len(hashmap) <= MAP_CAPACITY(hashmap->ex_capa) / 2);
+    }
+    assert(hashmap->ex_capa == 11);
+
+    // incremental resize is finished by shrinking to fit
+    hmap_free(hashmap);
+    config.incremental_resize = true;
+    config.shrink = HASHMAP_SHRINK_NEVER;
+    hashmap = hmap_init_ex(&config, 12);
+    assert(hashmap != NULL);
+    for (u32 i=0; i<600; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+    assert(hmap_shrink_to_fit(hashmap) == true);
+    assert(hashmap->ex_capa == 11 && hashmap->old_slots == NULL);
+    assert(get_occupied_slot_count(hashmap) == 600);
+    hmap_free(hashmap);
+
+    struct HashMapConfig invalid = {.item_size=sizeof(i32), .max_load_factor=1.0};
+    assert(hmap_init_ex(&invalid, MAP_INIT_EXP_CAPACITY) == NULL);
+    invalid.max_load_factor = 0.8;
+    invalid.min_load_factor = 0.4;
+    assert(hmap_init_ex(&invalid, MAP_INIT_EXP_CAPACITY) == NULL);
+    invalid.max_load_factor = -0.5;
+    invalid.min_load_factor = 0;
+    assert(hmap_init_ex(&invalid, MAP_INIT_EXP_CAPACITY) == NULL);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_hashmap_reserve_incremental() {
+    struct HashMapConfig const config = {.item_size=sizeof(i32), .incremental_resize=true};
+    assert(hmap_init_capa_for(&config, 0) == MAP_INIT_EXP_CAPACITY);
+    assert(hmap_init_capa_for(&config, 15) == MAP_INIT_EXP_CAPACITY);
+    assert(hmap_init_capa_for(&config, 16) == MAP_INIT_EXP_CAPACITY + 1);
+
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+
+    // leaves a migration in progress
+    for (u32 i=0; i<470; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+    assert(hashmap->old_slots != NULL);
+
+    assert(hmap_reserve(hashmap, 3000) == true);
+    assert(hashmap->old_slots == NULL && hashmap->ex_capa == 12);
+    assert(get_occupied_slot_count(hashmap) == 470);
+
+    for (u32 i=470; i<3000; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+        assert(hashmap->ex_capa == 12 && hashmap->old_slots == NULL);
+    }
+    for (u32 i=0; i<3000; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(*(i32 *)hmap_get(hashmap, key) == (i32)i);
+    }
+    hmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void check_build_matches_insertion(u32 elems, u32 round) {
+    char (*key_buffer)[24] = malloc((size_t)elems * sizeof *key_buffer);
+    char const **keys = malloc((size_t)elems * sizeof *keys);
+    i32 *items = malloc((size_t)elems * sizeof *items);
+    assert(key_buffer != NULL && keys != NULL && items != NULL);
+
+    for (u32 i=0; i<elems; ++i) {
+        snprintf(key_buffer[i], sizeof key_buffer[i], "r%u_%u", round, i);
+        keys[i] = key_buffer[i];
+        items[i] = (i32)i;
+    }
+    struct HashMap *built = hmap_init_with_key(sizeof(i32), NULL);
+    struct HashMap *inserted = hmap_init_with_key(sizeof(i32), NULL);
+    assert(built != NULL && inserted != NULL);
+
+    assert(hmap_build(built, keys, items, elems) == elems);
+    assert(hmap_reserve(inserted, elems) == true);
+    for (u32 i=0; i<elems; ++i) {
+        assert(hmap_insert(inserted, keys[i], &items[i]) == true);
+    }
+    // Robin Hood placement leaves the same probe sequence lengths, only keys sharing
+    // a home slot may be ordered differently
+    assert(built->ex_capa == inserted->ex_capa && built->occ_slots == elems);
+    size_t const mask = MAP_CAPACITY(built->ex_capa) - 1;
+
+    for (size_t j=0; j<=mask; ++j) {
+        bucket_meta_type const meta = *(bucket_meta_type *)((u8 *)built->slots + j * built->sz_slot);
+        bucket_meta_type const other = *(bucket_meta_type *)((u8 *)inserted->slots + j * built->sz_slot);
+
+        assert(BUCKET_IS_TAKEN(meta) == BUCKET_IS_TAKEN(other));
+        if (!BUCKET_IS_TAKEN(meta)) continue;
+
+        assert(META_GET_PSL(meta) == META_GET_PSL(other));
+        assert(((j - META_GET_PSL(meta)) & mask) == (META_GET_HASH(meta) & mask));
+    }
+    for (u32 i=0; i<elems; ++i) {
+        assert(*(i32 *)hmap_get(built, keys[i]) == (i32)i);
+    }
+
+    for (u32 i=0; i<elems; ++i) {
+        assert(hmap_remove_into(built, keys[i], NULL) == true);
+    }
+    assert(get_occupied_slot_count(built) == 0);
+
+    hmap_free(built);
+    hmap_free(inserted);
+    free(items);
+    free(keys);
+    free(key_buffer);
+}
+
+static void test_hashmap_build() {
+    // nearly full small tables wrap around their end often
+    for (u32 round=0; round<200; ++round) {
+        check_build_matches_insertion(14, round);
+    }
+    check_build_matches_insertion(50000, 0);
+
+    struct HashMapConfig config = {.item_size=sizeof(i32), .long_keys=true};
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+
+    // duplicates keep the last data item, invalid keys are skipped
+    char const *keys[] = {
+        "short", "a key long enough for the key arena", NULL, "short",
+        "a key long enough for the key arena", "other"
+    };
+    i32 const items[] = {1, 2, 3, 4, 5, 6};
+    assert(hmap_build(hashmap, keys, items, 6) == 3);
+    assert(hmap_len(hashmap) == 3);
+    assert(*(i32 *)hmap_get(hashmap, "short") == 4);
+    assert(*(i32 *)hmap_get(hashmap, "a key long enough for the key arena") == 5);
+    assert(*(i32 *)hmap_get(hashmap, "other") == 6);
+
+    // falls back to insertions when not empty
+    char const *more[] = {"other", "new"};
+    assert(hmap_build(hashmap, more, (i32[]){7, 8}, 2) == 1);
+    assert(*(i32 *)hmap_get(hashmap, "other") == 7);
+    assert(hmap_len(hashmap) == 4);
+    hmap_free(hashmap);
+
+    config = (struct HashMapConfig){.item_size=sizeof(i32), .key_type=HASHMAP_KEY_U64};
+    hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    assert(hmap_build(hashmap, more, (i32[]){7, 8}, 2) == 0);
+    hmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static u64 constant_hash(void const *data, size_t len, u8 const key[16]) {
+    (void)data;
+    (void)len;
+    (void)key;
+    return 0;
+}
+
+static void check_psl_histogram(struct HashMapStats const *stats) {
+    u64 total = 0, max_bucket = 0;
+
+    for (u64 b=0; b<HASHMAP_STATS_PSL_BUCKETS; ++b) {
+        total += stats->psl_histogram[b];
+        if (stats->psl_histogram[b] > 0) max_bucket = b;
+    }
+    assert(total == stats->len);
+    assert(max_bucket == (stats->max_psl < HASHMAP_STATS_PSL_BUCKETS ? stats->max_psl :
+        HASHMAP_STATS_PSL_BUCKETS - 1));
+}
+
+static void test_hashmap_stats() {
+    struct HashMap *hashmap = hmap_init(sizeof(i32), MAP_INIT_EXP_CAPACITY, NULL);
+    assert(hashmap != NULL);
+
+    for (i32 i=0; i<1000; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%d", "key", i);
+        assert(hmap_insert(hashmap, key, &i) == true);
+    }
+    for (i32 i=0; i<10; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%d", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){-i}) == true);
+    }
+    for (i32 i=0; i<150; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%d", i < 100 ? "key" : "none", i);
+        assert((hmap_get(hashmap, key) != NULL) == (i < 100));
+    }
+    for (i32 i=0; i<900; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%d", "key", i);
+        assert(hmap_remove(hashmap, key) != NULL);
+    }
+
+    struct HashMapStats stats;
+    bool const counted = hmap_get_stats(hashmap, &stats);
+    assert(stats.capacity == MAP_CAPACITY(hashmap->ex_capa));
+    assert(stats.len == 100);
+    check_psl_histogram(&stats);
+
+#ifdef HASHMAP_STATS
+    assert(counted == true);
+    assert(stats.inserts == 1000 && stats.updates == 10 && stats.removes == 900);
+    assert(stats.gets == 150 && stats.get_hits == 100 && stats.get_misses == 50);
+    // 16 slots grow to 2048 one doubling at a time
+    assert(stats.resizes_up == 7 && stats.resizes_down > 0);
+    assert(stats.displacements > 0 && stats.backward_shifts > 0 && stats.resize_ns > 0);
+#else
+    assert(counted == false);
+    assert(stats.inserts == 0 && stats.gets == 0 && stats.resizes_up == 0);
+#endif
+    hmap_free(hashmap);
+
+    // With a constant hash every key probes from the same slot, PSLs go 0, 1, 2, ...
+    struct HashMapConfig const config = {
+        .item_size=sizeof(i32), .hash=HASHMAP_HASH_CUSTOM, .hash_func=constant_hash
+    };
+    hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+
+    u32 const elems = HASHMAP_STATS_PSL_BUCKETS + 8;
+    for (u32 i=0; i<elems; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){1}) == true);
+    }
+    hmap_get_stats(hashmap, &stats);
+    assert(stats.max_psl == elems - 1);
+    assert(stats.psl_histogram[0] == 1 && stats.psl_histogram[HASHMAP_STATS_PSL_BUCKETS - 2] == 1);
+    assert(stats.psl_histogram[HASHMAP_STATS_PSL_BUCKETS - 1] == elems - (HASHMAP_STATS_PSL_BUCKETS - 1));
+    check_psl_histogram(&stats);
+#ifdef HASHMAP_STATS
+    // every insertion after the first passes all previous keys without displacing any
+    assert(stats.inserts == elems && stats.displacements == 0);
+#endif
+    hmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
 
 test_func map_tests[] = {
     {"value_set_macro_lsb", test_value_set_macro_lsb},
@@ -815,6 +2167,7 @@ test_func map_tests[] = {
     {"hashmap_operations_small_size_many_insertions", test_hashmap_operations_small_size_many_insertions},
     {"hashmap_init_to_specific_size", test_hashmap_init_to_specific_size},
     {"hashmap_init_for_too_large_size", test_hashmap_init_for_too_large_size},
+    {"hashmap_wide_hash_resizing", test_hashmap_wide_hash_resizing},
     {"hashmap_init_for_too_large_item_size", test_hashmap_init_for_too_large_item_size},
     {"hashmap_element_removal", test_hashmap_element_removal},
     {"hashmap_resizing_up", test_hashmap_resizing_up},
@@ -829,5 +2182,23 @@ test_func map_tests[] = {
     {"hashmap_custom_allocation_and_free", test_hashmap_custom_allocation_and_free},
     {"hashmap_custom_allocation_with_remove", test_hashmap_custom_allocation_with_remove},
     {"hashmap_custom_allocation_with_remove_and_resize", test_hashmap_custom_allocation_with_remove_and_resize},
+    {"hashmap_incremental_resizing_up", test_hashmap_incremental_resizing_up},
+    {"hashmap_incremental_resizing_down", test_hashmap_incremental_resizing_down},
+    {"hashmap_split_layout", test_hashmap_split_layout},
+    {"hashmap_split_layout_incremental_resizing", test_hashmap_split_layout_incremental_resizing},
+    {"hashmap_packing", test_hashmap_packing},
+    {"hashmap_long_keys", test_hashmap_long_keys},
+    {"hashmap_long_keys_incremental_resizing", test_hashmap_long_keys_incremental_resizing},
+    {"hashmap_u64_keys", test_hashmap_u64_keys},
+    {"hashmap_hash_functions", test_hashmap_hash_functions},
+    {"hashmap_batch_operations", test_hashmap_batch_operations},
+    {"hashmap_remove_into", test_hashmap_remove_into},
+    {"hashmap_allocator", test_hashmap_allocator},
+    {"hashmap_huge_pages", test_hashmap_huge_pages},
+    {"hashmap_shrink_policies", test_hashmap_shrink_policies},
+    {"hashmap_load_factors", test_hashmap_load_factors},
+    {"hashmap_reserve_incremental", test_hashmap_reserve_incremental},
+    {"hashmap_build", test_hashmap_build},
+    {"hashmap_stats", test_hashmap_stats},
     {NULL, NULL},
 };
@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "common.h"
+#include "map.h"
+#include "bucket.h"
+#include "probe.h"
+
+#define TEST_BUCKETS 64
+
+
+static u32 lcg_state = 12345;
+
+static u32 lcg_next() {
+    lcg_state = lcg_state * 1103515245U + 12345U;
+    return lcg_state >> 8;
+}
+
+static void fill_buckets(u8 *slots, size_t stride, size_t count) {
+    memset(slots, 0, stride * count);
+
+    for (size_t i=0; i<count; ++i) {
+        struct Bucket *bucket = (struct Bucket *)(slots + stride * i);
+        // roughly every fourth bucket is free, hashes come from a small set to get matches
+        if (lcg_next() % 4 == 0) continue;
+
+        bucket->meta_data = META_SET_TAKEN(bucket->meta_data, 1U);
+        bucket->meta_data = META_SET_PSL(bucket->meta_data, lcg_next() % 8);
+        bucket->meta_data = META_SET_HASH(bucket->meta_data, (bucket_meta_type)(lcg_next() % 4));
+    }
+}
+
+static struct ProbeResult reference_scan(
+    u8 const *slots, size_t stride, size_t idx, size_t mask, u32 psl, u64 hash, u32 width)
+{
+    struct ProbeResult result = {.match_mask=0, .stop=width};
+
+    for (u32 i=0; i<width; ++i) {
+        bucket_meta_type meta_data = ((struct Bucket const *)(slots + stride * ((idx + i) & mask)))->meta_data;
+
+        if (!BUCKET_IS_TAKEN(meta_data) || META_GET_PSL(meta_data) < psl + i) {
+            result.stop = i;
+            break;
+        }
+        if (META_GET_HASH(meta_data) == hash) result.match_mask |= 1U << i;
+    }
+    return result;
+}
+
+static void check_impl_against_reference(struct Probe const *probe, size_t stride) {
+    u8 *slots = calloc(TEST_BUCKETS, stride);
+    assert(slots != NULL);
+
+    for (u32 round=0; round<50; ++round) {
+        fill_buckets(slots, stride, TEST_BUCKETS);
+
+        for (size_t idx=0; idx<TEST_BUCKETS; ++idx) {
+            u32 const psl = lcg_next() % 6;
+            u64 const hash = lcg_next() % 4;
+
+            struct ProbeResult const expected = reference_scan(
+                slots, stride, idx, TEST_BUCKETS - 1, psl, hash, probe->width
+            );
+            struct ProbeResult const result = probe->scan(
+                slots, stride, idx, TEST_BUCKETS - 1, psl, hash
+            );
+            assert(result.stop == expected.stop);
+            assert(result.match_mask == expected.match_mask);
+        }
+    }
+    free(slots);
+}
+
+static void test_probe_auto_selection() {
+    struct Probe probe;
+
+    assert(probe_select(PROBE_IMPL_AUTO, &probe) == true);
+    assert(probe.scan != NULL);
+    assert(probe.width > 0 && probe.width <= PROBE_MAX_GROUP_WIDTH);
+
+    // scalar implementation is available on every platform
+    assert(probe_select(PROBE_IMPL_SCALAR, &probe) == true);
+    assert(probe.impl == PROBE_IMPL_SCALAR);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_probe_implementations_match_reference() {
+    enum ProbeImpl const impls[] = {PROBE_IMPL_SCALAR, PROBE_IMPL_SSE2, PROBE_IMPL_AVX2};
+
+    for (size_t i=0; i<sizeof(impls)/sizeof(impls[0]); ++i) {
+        struct Probe probe;
+        if (!probe_select(impls[i], &probe)) continue;
+
+        // slots with a key and data item, and densely packed meta data
+        check_impl_against_reference(&probe, 40);
+        check_impl_against_reference(&probe, sizeof(struct Bucket));
+    }
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_probe_implementations_in_hashmap() {
+    enum ProbeImpl const impls[] = {PROBE_IMPL_SCALAR, PROBE_IMPL_SSE2, PROBE_IMPL_AVX2};
+
+    for (size_t i=0; i<sizeof(impls)/sizeof(impls[0]); ++i) {
+        struct HashMap *hashmap = hmap_init(sizeof(u32), 10, NULL);
+        assert(hashmap != NULL);
+
+        if (!probe_select(impls[i], &hashmap->probe)) {
+            hmap_free(hashmap);
+            continue;
+        }
+
+        // load close to the resize threshold 0.9 gives long probe sequences
+        u32 const elems = 920;
+        for (u32 j=0; j<elems; ++j) {
+            char key[16];
+            snprintf(key, sizeof key, "probe_%u", j);
+            assert(hmap_insert(hashmap, key, &j) == true);
+        }
+        assert(hashmap->ex_capa == 10);
+
+        for (u32 j=0; j<2*elems; ++j) {
+            char key[16];
+            snprintf(key, sizeof key, "probe_%u", j);
+
+            u32 *value = hmap_get(hashmap, key);
+            if (j < elems) {
+                assert(value != NULL);
+                assert(*value == j);
+            } else {
+                assert(value == NULL);
+            }
+        }
+        for (u32 j=0; j<elems; j+=3) {
+            char key[16];
+            snprintf(key, sizeof key, "probe_%u", j);
+            assert(hmap_remove(hashmap, key) != NULL);
+            assert(hmap_get(hashmap, key) == NULL);
+        }
+
+        hmap_free(hashmap);
+    }
+
+    PRINT_SUCCESS(__func__);
+}
+
+
+test_func probe_tests[] = {
+    {"probe_auto_selection", test_probe_auto_selection},
+    {"probe_implementations_match_reference", test_probe_implementations_match_reference},
+    {"probe_implementations_in_hashmap", test_probe_implementations_in_hashmap},
+    {NULL, NULL},
+};
@@ -0,0 +1,391 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "common.h"
+#include "sharded.h"
+
+#define THREAD_COUNT 4
+#define THREAD_KEYS 3000
+
+
+static void test_sharded_init() {
+    struct HashMapConfig config = {.item_size=sizeof(i32)};
+
+    struct ShardedHashMap *smap = smap_init(&config, 0, MAP_INIT_EXP_CAPACITY);
+    assert(smap != NULL);
+    assert(smap->shard_count == SMAP_DEFAULT_SHARDS);
+    assert(smap->sz_item == sizeof(i32));
+    assert(((size_t)smap->shards & (SMAP_CACHE_LINE_BYTES - 1)) == 0);
+
+    // every shard hashes with the same random key
+    for (u32 j=1; j<smap->shard_count; ++j) {
+        assert(memcmp(smap->shards[j].map->rand_key, smap->shards[0].map->rand_key, HASH_RAND_KEY_LEN) == 0);
+    }
+    smap_free(smap);
+
+    smap = smap_init(&config, 5, MAP_INIT_EXP_CAPACITY);
+    assert(smap != NULL);
+    assert(smap->shard_count == 8 && smap->shard_bits == 3);
+    smap_free(smap);
+
+    smap = smap_init(&config, 1, MAP_INIT_EXP_CAPACITY);
+    assert(smap != NULL);
+    assert(smap->shard_count == 1 && smap->shard_bits == 0);
+    assert(smap_insert(smap, "key", &(i32){1}) == true);
+    assert(smap_get(smap, "key", NULL) == true);
+    smap_free(smap);
+
+    assert(smap_init(&config, SMAP_MAX_SHARDS + 1, MAP_INIT_EXP_CAPACITY) == NULL);
+
+    config.key_type = HASHMAP_KEY_U64;
+    assert(smap_init(&config, 0, MAP_INIT_EXP_CAPACITY) == NULL);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_sharded_init_with_size() {
+    struct HashMapConfig const config = {.item_size=sizeof(i32), .init_elems=6000};
+    size_t const shard_counts[] = {0, 3, 4, 5};
+
+    for (size_t i=0; i<sizeof(shard_counts)/sizeof(shard_counts[0]); ++i) {
+        struct ShardedHashMap *smap = hashmap_sharded_init(&config, shard_counts[i]);
+        assert(smap != NULL && smap->shard_count == smap_shard_count(shard_counts[i]));
+
+        // initial elements are divided among the shards actually created
+        u32 const shard_capa = hmap_init_capa_for(&config, 6000 / smap->shard_count);
+        for (u32 j=0; j<smap->shard_count; ++j) {
+            assert(smap->shards[j].map->ex_capa == shard_capa);
+        }
+        smap_free(smap);
+    }
+    assert(smap_shard_count(3) == 4 && smap_shard_count(5) == 8);
+    assert(smap_shard_count(0) == SMAP_DEFAULT_SHARDS);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_sharded_operations() {
+    struct HashMapConfig const config = {.item_size=sizeof(i32)};
+    struct ShardedHashMap *smap = smap_init(&config, 8, MAP_INIT_EXP_CAPACITY);
+    assert(smap != NULL);
+
+    u32 const elems = 2000;
+    for (u32 i=0; i<elems; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(smap_insert(smap, key, &(i32){i}) == true);
+    }
+    assert(smap_len(smap) == elems);
+
+    // keys spread over all shards
+    for (u32 j=0; j<smap->shard_count; ++j) {
+        assert(hmap_len(smap->shards[j].map) > elems / smap->shard_count / 2);
+    }
+
+    for (u32 i=0; i<elems; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        i32 value = -1;
+        assert(smap_get(smap, key, &value) == true);
+        assert(value == (i32)i);
+    }
+    i32 value = -1;
+    assert(smap_get(smap, "key_2000", &value) == false);
+    assert(value == -1);
+
+    assert(smap_remove(smap, "key_10", &value) == true);
+    assert(value == 10);
+    assert(smap_remove(smap, "key_10", &value) == false);
+    assert(smap_remove(smap, "key_11", NULL) == true);
+    assert(smap_get(smap, "key_11", NULL) == false);
+    assert(smap_len(smap) == elems - 2);
+
+    // invalid keys as with a single hash map
+    assert(smap_insert(smap, NULL, &(i32){1}) == false);
+    assert(smap_insert(smap, "a key that is too long", &(i32){1}) == false);
+    assert(smap_get(smap, NULL, NULL) == false);
+    assert(smap_remove(smap, NULL, NULL) == false);
+
+    smap_free(smap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static u32 iter_counter = 0;
+
+static bool count_and_double(char const *key, void *data) {
+    assert(key != NULL);
+    *(i32 *)data *= 2;
+    iter_counter += 1;
+    return true;
+}
+
+static bool stop_at_first(char const *key, void *data) {
+    (void)key;
+    (void)data;
+    iter_counter += 1;
+    return false;
+}
+
+static void test_sharded_iter_apply() {
+    struct HashMapConfig const config = {.item_size=sizeof(i32)};
+    struct ShardedHashMap *smap = smap_init(&config, 4, MAP_INIT_EXP_CAPACITY);
+    assert(smap != NULL);
+
+    for (u32 i=0; i<100; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(smap_insert(smap, key, &(i32){i}) == true);
+    }
+
+    iter_counter = 0;
+    assert(smap_iter_apply(smap, count_and_double) == true);
+    assert(iter_counter == 100);
+
+    i32 value = 0;
+    assert(smap_get(smap, "key_21", &value) == true);
+    assert(value == 42);
+
+    iter_counter = 0;
+    assert(smap_iter_apply(smap, stop_at_first) == false);
+    assert(iter_counter == 1);
+
+    smap_free(smap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+struct ThreadArgs {
+    struct ShardedHashMap *smap;
+    u32 id;
+};
+
+static void* writer_thread(void *arg) {
+    struct ThreadArgs const *args = arg;
+    char key[16];
+
+    for (u32 i=0; i<THREAD_KEYS; ++i) {
+        snprintf(key, sizeof key, "t%u_%u", args->id, i);
+        assert(smap_insert(args->smap, key, &(i32){i}) == true);
+    }
+    for (u32 i=0; i<THREAD_KEYS; ++i) {
+        snprintf(key, sizeof key, "t%u_%u", args->id, i);
+        i32 value = -1;
+        assert(smap_get(args->smap, key, &value) == true);
+        assert(value == (i32)i);
+    }
+    for (u32 i=0; i<THREAD_KEYS; i+=2) {
+        snprintf(key, sizeof key, "t%u_%u", args->id, i);
+        i32 value = -1;
+        assert(smap_remove(args->smap, key, &value) == true);
+        assert(value == (i32)i);
+    }
+    return NULL;
+}
+
+static void* reader_thread(void *arg) {
+    struct ThreadArgs const *args = arg;
+
+    // Shared keys are never modified while the writers run
+    for (u32 round=0; round<20; ++round) {
+        for (u32 i=0; i<100; ++i) {
+            char key[16];
+            snprintf(key, sizeof key, "shared_%u", i);
+            i32 value = -1;
+            assert(smap_get(args->smap, key, &value) == true);
+            assert(value == (i32)i);
+        }
+    }
+    return NULL;
+}
+
+static void check_threads(struct HashMapConfig const *config, u32 shard_count) {
+    struct ShardedHashMap *smap = smap_init(config, shard_count, MAP_INIT_EXP_CAPACITY);
+    assert(smap != NULL);
+
+    for (u32 i=0; i<100; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "shared_%u", i);
+        assert(smap_insert(smap, key, &(i32){i}) == true);
+    }
+
+    pthread_t threads[2 * THREAD_COUNT];
+    struct ThreadArgs args[2 * THREAD_COUNT];
+
+    for (u32 t=0; t<2*THREAD_COUNT; ++t) {
+        args[t] = (struct ThreadArgs){.smap=smap, .id=t};
+        void* (*func)(void *) = t < THREAD_COUNT ? writer_thread : reader_thread;
+        assert(pthread_create(&threads[t], NULL, func, &args[t]) == 0);
+    }
+    for (u32 t=0; t<2*THREAD_COUNT; ++t) {
+        assert(pthread_join(threads[t], NULL) == 0);
+    }
+
+    assert(smap_len(smap) == 100 + THREAD_COUNT * THREAD_KEYS / 2);
+    assert(smap_get(smap, "t0_1", NULL) == true);
+    assert(smap_get(smap, "t0_0", NULL) == false);
+
+    smap_free(smap);
+}
+
+static void test_sharded_threads() {
+    struct HashMapConfig config = {.item_size=sizeof(i32), .incremental_resize=true};
+    check_threads(&config, 4);
+
+    config.incremental_resize = false;
+    check_threads(&config, 4);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_epoch_reclamation() {
+    struct RetireList list = {0};
+    assert(retire_reserve(&list, 2) == true);
+
+    assert(epoch_enter() == true);
+    assert(epoch_min_active() != UINT64_MAX);
+
+    // retired while a reader is active, must outlive the reader
+    retire_push(&list, malloc(16));
+    assert(list.pending == 1);
+    retire_tag_pending(&list, epoch_advance());
+    assert(list.pending == 0);
+    retire_reclaim(&list);
+    assert(list.len == 1);
+
+    epoch_exit();
+    assert(epoch_min_active() == UINT64_MAX);
+    retire_reclaim(&list);
+    assert(list.len == 0);
+
+    // readers entering after the retirement do not hold it back
+    retire_push(&list, malloc(16));
+    retire_tag_pending(&list, epoch_advance());
+    assert(epoch_enter() == true);
+    retire_reclaim(&list);
+    assert(list.len == 0);
+    epoch_exit();
+
+    retire_free_all(&list);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_sharded_lock_free_reads() {
+    struct HashMapConfig config = {.item_size=sizeof(i32), .lock_free_reads=true};
+    struct ShardedHashMap *smap = smap_init(&config, 2, MAP_INIT_EXP_CAPACITY);
+    assert(smap != NULL && smap->lock_free_reads);
+
+    struct MapView const *view = atomic_load(&smap->shards[0].view);
+    assert(view->slots == smap->shards[0].map->slots);
+
+    u32 const elems = 3000;
+    for (u32 i=0; i<elems; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(smap_insert(smap, key, &(i32){i}) == true);
+    }
+    for (u32 i=0; i<elems; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        i32 value = -1;
+        assert(smap_get(smap, key, &value) == true);
+        assert(value == (i32)i);
+    }
+    assert(smap_get(smap, "key_3000", NULL) == false);
+
+    for (u32 i=0; i<elems; i+=2) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(smap_remove(smap, key, NULL) == true);
+    }
+    assert(smap_len(smap) == elems / 2);
+
+    for (u32 j=0; j<smap->shard_count; ++j) {
+        struct Shard *shard = &smap->shards[j];
+
+        // resizes published new views, without readers nothing stays retired
+        view = atomic_load(&shard->view);
+        assert(view->slots == shard->map->slots && view->ex_capa == shard->map->ex_capa);
+        assert(shard->retired.len == 0);
+        assert(atomic_load(&shard->seq) % 2 == 0 && atomic_load(&shard->seq) > 0);
+    }
+    smap_free(smap);
+
+    config.long_keys = true;
+    assert(smap_init(&config, 2, MAP_INIT_EXP_CAPACITY) == NULL);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static size_t live_allocs = 0;
+
+static void* counted_alloc(void *ctx, size_t size) {
+    (void)ctx;
+    live_allocs += 1;
+    return malloc(size);
+}
+
+static void counted_free(void *ctx, void *ptr, size_t size) {
+    (void)ctx;
+    (void)size;
+    live_allocs -= 1;
+    free(ptr);
+}
+
+static void test_sharded_lock_free_allocator() {
+    struct HashMapConfig const config = {
+        .item_size=sizeof(i32),
+        .lock_free_reads=true,
+        .allocator={.alloc_func=counted_alloc, .free_func=counted_free},
+    };
+    struct ShardedHashMap *smap = smap_init(&config, 2, MAP_INIT_EXP_CAPACITY);
+    assert(smap != NULL);
+
+    // slots replaced while a reader is active stay retired until the reader exits
+    assert(epoch_enter() == true);
+    for (u32 i=0; i<1000; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(smap_insert(smap, key, &(i32){i}) == true);
+    }
+    assert(smap->shards[0].retired.len > 0);
+    epoch_exit();
+
+    // retired slots go back to the allocator of the shard maps
+    smap_free(smap);
+    assert(live_allocs == 0);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_sharded_lock_free_threads() {
+    // few shards, so that writers resize the shards of the shared keys often
+    struct HashMapConfig config = {.item_size=sizeof(i32), .lock_free_reads=true};
+    check_threads(&config, 2);
+
+    config.incremental_resize = true;
+    config.layout = HASHMAP_LAYOUT_SPLIT;
+    check_threads(&config, 1);
+
+    PRINT_SUCCESS(__func__);
+}
+
+
+test_func sharded_tests[] = {
+    {"sharded_init", test_sharded_init},
+    {"sharded_init_with_size", test_sharded_init_with_size},
+    {"sharded_operations", test_sharded_operations},
+    {"sharded_iter_apply", test_sharded_iter_apply},
+    {"sharded_threads", test_sharded_threads},
+    {"epoch_reclamation", test_epoch_reclamation},
+    {"sharded_lock_free_reads", test_sharded_lock_free_reads},
+    {"sharded_lock_free_threads", test_sharded_lock_free_threads},
+    {"sharded_lock_free_allocator", test_sharded_lock_free_allocator},
+    {NULL, NULL},
+};
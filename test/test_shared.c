@@ -0,0 +1,224 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "common.h"
+#include "shared.h"
+
+#define PROCESS_COUNT 4
+#define PROCESS_KEYS 2000
+
+
+static void* map_region(size_t bytes) {
+    void *region = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert(region != MAP_FAILED);
+
+    return region;
+}
+
+static void test_shared_create_and_attach() {
+    struct HashMapConfig const config = {.item_size=sizeof(i32)};
+    size_t const bytes = shmap_region_bytes(&config, 1000);
+    assert(bytes > 0);
+    void *region = map_region(bytes);
+
+    struct SharedHashMap *shmap = shmap_create(region, bytes, &config);
+    assert(shmap != NULL);
+    // capacity fits exactly the requested element count
+    assert(shmap->header->ex_capa == hmap_init_capa_for(&config, 1000));
+    assert(((size_t)shmap->map->slots & (SHMAP_CACHE_LINE_BYTES - 1)) == 0);
+
+    for (i32 i=0; i<1000; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%d", "key", i);
+        assert(shmap_insert(shmap, key, &i) == true);
+    }
+    assert(shmap_len(shmap) == 1000);
+
+    // second handle sees the same slots and slot count
+    struct SharedHashMap *other = shmap_attach(region, bytes);
+    assert(other != NULL && other->map != shmap->map);
+    assert(memcmp(other->map->rand_key, shmap->map->rand_key, HASH_RAND_KEY_LEN) == 0);
+
+    i32 item = -1;
+    assert(shmap_get(other, "key_123", &item) == true && item == 123);
+    assert(shmap_remove(other, "key_123", &item) == true && item == 123);
+    assert(shmap_get(shmap, "key_123", NULL) == false);
+    assert(shmap_len(shmap) == 999);
+
+    assert(shmap_insert(shmap, "key_123", &(i32){-123}) == true);
+    assert(shmap_get(other, "key_123", &item) == true && item == -123);
+
+    shmap_detach(other);
+    shmap_detach(shmap);
+    munmap(region, bytes);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_shared_fixed_capacity() {
+    struct HashMapConfig const config = {.item_size=sizeof(i32), .layout=HASHMAP_LAYOUT_SPLIT};
+    size_t const bytes = shmap_region_bytes(&config, 100);
+    void *region = map_region(bytes);
+
+    struct SharedHashMap *shmap = shmap_create(region, bytes, &config);
+    assert(shmap != NULL);
+    u32 const ex_capa = shmap->map->ex_capa;
+
+    i32 inserted = 0;
+    for (bool full=false; !full; ) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%d", "key", inserted);
+        full = !shmap_insert(shmap, key, &inserted);
+        inserted += !full;
+    }
+    assert(inserted >= 100 && (size_t)inserted < MAP_CAPACITY(ex_capa));
+    assert(shmap_len(shmap) == (size_t)inserted && shmap->map->ex_capa == ex_capa);
+
+    // removals do not shrink the region slots either
+    for (i32 i=0; i<inserted; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%d", "key", i);
+        assert(shmap_remove(shmap, key, NULL) == true);
+    }
+    assert(shmap_len(shmap) == 0 && shmap->map->ex_capa == ex_capa);
+    assert(shmap_insert(shmap, "key", &(i32){1}) == true);
+
+    shmap_detach(shmap);
+    munmap(region, bytes);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_shared_invalid_regions() {
+    struct HashMapConfig config = {.item_size=sizeof(i32)};
+    size_t const bytes = shmap_region_bytes(&config, 10);
+    void *region = map_region(bytes);
+
+    assert(shmap_attach(region, bytes) == NULL);
+    assert(shmap_create(region, 64, &config) == NULL);
+    assert(shmap_create((char *)region + 8, bytes - 8, &config) == NULL);
+
+    config.long_keys = true;
+    assert(shmap_create(region, bytes, &config) == NULL);
+    assert(shmap_region_bytes(&config, 10) == 0);
+    config.long_keys = false;
+    config.key_type = HASHMAP_KEY_U64;
+    assert(shmap_create(region, bytes, &config) == NULL);
+    config.key_type = HASHMAP_KEY_STRING;
+
+    struct SharedHashMap *shmap = shmap_create(region, bytes, &config);
+    assert(shmap != NULL);
+    assert(shmap_attach(region, bytes / 2) == NULL);
+
+    shmap_detach(shmap);
+    munmap(region, bytes);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_shared_forked_processes() {
+    struct HashMapConfig const config = {.item_size=sizeof(i32)};
+    size_t const bytes = shmap_region_bytes(&config, PROCESS_COUNT * PROCESS_KEYS);
+    void *region = map_region(bytes);
+
+    struct SharedHashMap *shmap = shmap_create(region, bytes, &config);
+    assert(shmap != NULL);
+
+    pid_t pids[PROCESS_COUNT];
+    for (i32 p=0; p<PROCESS_COUNT; ++p) {
+        pids[p] = fork();
+        assert(pids[p] >= 0);
+
+        if (pids[p] == 0) {
+            // Every child attaches on its own and reads the keys of the others meanwhile
+            struct SharedHashMap *child = shmap_attach(region, bytes);
+            bool ok = child != NULL;
+
+            for (i32 i=0; ok && i<PROCESS_KEYS; ++i) {
+                char key[16];
+                snprintf(key, sizeof key, "%d_%d", p, i);
+                i32 const value = p * PROCESS_KEYS + i;
+                i32 item = -1;
+
+                ok = shmap_insert(child, key, &value) && shmap_get(child, key, &item) &&
+                    item == value;
+                snprintf(key, sizeof key, "%d_%d", (p + 1) % PROCESS_COUNT, i);
+                ok = ok && (!shmap_get(child, key, &item) ||
+                    item == (p + 1) % PROCESS_COUNT * PROCESS_KEYS + i);
+            }
+            shmap_detach(child);
+            _exit(ok ? 0 : 1);
+        }
+    }
+    for (i32 p=0; p<PROCESS_COUNT; ++p) {
+        int status;
+        assert(waitpid(pids[p], &status, 0) == pids[p]);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    assert(shmap_len(shmap) == PROCESS_COUNT * PROCESS_KEYS);
+    for (i32 p=0; p<PROCESS_COUNT; ++p) {
+        for (i32 i=0; i<PROCESS_KEYS; ++i) {
+            char key[16];
+            snprintf(key, sizeof key, "%d_%d", p, i);
+            i32 item = -1;
+            assert(shmap_get(shmap, key, &item) == true && item == p * PROCESS_KEYS + i);
+        }
+    }
+
+    shmap_detach(shmap);
+    munmap(region, bytes);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_shared_dead_lock_owner() {
+#ifdef SHMAP_ROBUST_LOCK
+    struct HashMapConfig const config = {.item_size=sizeof(i32)};
+    size_t const bytes = shmap_region_bytes(&config, 100);
+    void *region = map_region(bytes);
+
+    struct SharedHashMap *shmap = shmap_create(region, bytes, &config);
+    assert(shmap != NULL);
+    assert(shmap_insert(shmap, "key", &(i32){1}) == true);
+
+    pid_t const pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        // Die in the middle of a modification
+        pthread_mutex_lock(&shmap->header->lock);
+        atomic_fetch_add(&shmap->header->seq, 1);
+        atomic_store(&shmap->header->occ_slots, 42);
+        _exit(0);
+    }
+    int status;
+    assert(waitpid(pid, &status, 0) == pid);
+
+    // Lock, sequence counter and slot count are recovered by the next writer
+    assert(shmap_insert(shmap, "other", &(i32){2}) == true);
+    assert((atomic_load(&shmap->header->seq) & 1) == 0);
+    assert(shmap_len(shmap) == 2);
+    i32 item = -1;
+    assert(shmap_get(shmap, "key", &item) == true && item == 1);
+
+    shmap_detach(shmap);
+    munmap(region, bytes);
+#endif
+    PRINT_SUCCESS(__func__);
+}
+
+test_func shared_tests[] = {
+    {"shared_create_and_attach", test_shared_create_and_attach},
+    {"shared_fixed_capacity", test_shared_fixed_capacity},
+    {"shared_invalid_regions", test_shared_invalid_regions},
+    {"shared_forked_processes", test_shared_forked_processes},
+    {"shared_dead_lock_owner", test_shared_dead_lock_owner},
+    {NULL, NULL},
+};
@@ -37,6 +37,33 @@ u64 const correct_hashes_test_set[] = {
     0xb0f4d346d72da699ULL, 0xebb5b33bbdbad7a0ULL, 0x73be792ca75eae4dULL, 0x714ddbefc9d4b97cULL,
 };
 
+// Reference vectors of SipHash-2-4: hashes of the byte sequences 0, 1, ..., n-1 for n < 64
+u64 const correct_vectors[] = {
+    0x726fdb47dd0e0e31ULL, 0x74f839c593dc67fdULL, 0x0d6c8009d9a94f5aULL, 0x85676696d7fb7e2dULL,
+    0xcf2794e0277187b7ULL, 0x18765564cd99a68dULL, 0xcbc9466e58fee3ceULL, 0xab0200f58b01d137ULL,
+    0x93f5f5799a932462ULL, 0x9e0082df0ba9e4b0ULL, 0x7a5dbbc594ddb9f3ULL, 0xf4b32f46226bada7ULL,
+    0x751e8fbc860ee5fbULL, 0x14ea5627c0843d90ULL, 0xf723ca908e7af2eeULL, 0xa129ca6149be45e5ULL,
+    0x3f2acc7f57c29bdbULL, 0x699ae9f52cbe4794ULL, 0x4bc1b3f0968dd39cULL, 0xbb6dc91da77961bdULL,
+    0xbed65cf21aa2ee98ULL, 0xd0f2cbb02e3b67c7ULL, 0x93536795e3a33e88ULL, 0xa80c038ccd5ccec8ULL,
+    0xb8ad50c6f649af94ULL, 0xbce192de8a85b8eaULL, 0x17d835b85bbb15f3ULL, 0x2f2e6163076bcfadULL,
+    0xde4daaaca71dc9a5ULL, 0xa6a2506687956571ULL, 0xad87a3535c49ef28ULL, 0x32d892fad841c342ULL,
+    0x7127512f72f27cceULL, 0xa7f32346f95978e3ULL, 0x12e0b01abb051238ULL, 0x15e034d40fa197aeULL,
+    0x314dffbe0815a3b4ULL, 0x027990f029623981ULL, 0xcadcd4e59ef40c4dULL, 0x9abfd8766a33735cULL,
+    0x0e3ea96b5304a7d0ULL, 0xad0c42d6fc585992ULL, 0x187306c89bc215a9ULL, 0xd4a60abcf3792b95ULL,
+    0xf935451de4f21df2ULL, 0xa9538f0419755787ULL, 0xdb9acddff56ca510ULL, 0xd06c98cd5c0975ebULL,
+    0xe612a3cb9ecba951ULL, 0xc766e62cfcadaf96ULL, 0xee64435a9752fe72ULL, 0xa192d576b245165aULL,
+    0x0a8787bf8ecb74b2ULL, 0x81b3e73d20b49b6fULL, 0x7fa8220ba3b2eceaULL, 0x245731c13ca42499ULL,
+    0xb78dbfaf3a8d83bdULL, 0xea1ad565322a1a0bULL, 0x60e61c23a3795013ULL, 0x6606d7e446282b93ULL,
+    0x6ca4ecb15c5f91e1ULL, 0x9f626da15c9625f3ULL, 0xe51b38608ef25f57ULL, 0x958a324ceb064572ULL,
+};
+
+u64 const correct_siphash13_hashes[] = {
+    0xabac0158050fc4dcULL, 0xc9f49bf37d57ca93ULL, 0x82cb9b024dc7d44dULL, 0x8bf80ab8e7ddf7fbULL,
+    0xcf75576088d38328ULL, 0xdef9d52f49533b67ULL, 0xc50d2b50c59f22a7ULL, 0xd3927d989bb11140ULL,
+    0x369095118d299a8eULL, 0x25a48eb36c063de4ULL, 0x79de85ee92ff097fULL, 0x70c118c1f94dc352ULL,
+    0x78a384b157b4d9a2ULL, 0x306f760c1229ffa7ULL, 0x605aa111c0f95d34ULL, 0xd320d86d2a519956ULL,
+};
+
 
 static void test_siphash_ascii_chars() {
     u64 corr_hashes = sizeof(correct_hashes_test_set) / sizeof(correct_hashes_test_set[0]);
@@ -86,11 +113,108 @@ static void test_siphash_equal_data() {
     PRINT_SUCCESS(__func__);
 }
 
+static void test_siphash13_byte_sequences() {
+    u64 const corr_hashes = sizeof(correct_siphash13_hashes) / sizeof(correct_siphash13_hashes[0]);
+    u8 data[16];
+
+    for (u8 i=0; i<corr_hashes; ++i) {
+        data[i] = i;
+        // hash of the first i bytes
+        assert(siphash13(data, i, key) == correct_siphash13_hashes[i]);
+    }
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_siphash13_long_string() {
+    char string[] = "Hello, this is a very very very very very very long data for testing siphash!";
+    size_t s_len = strlen(string);
+
+    u64 hash = siphash13(string, s_len, key);
+    assert(hash == 0xb13c6f393488547aULL);
+    assert(hash != siphash(string, s_len, key));
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_siphash_reference_vectors() {
+    u64 const vectors = sizeof(correct_vectors) / sizeof(correct_vectors[0]);
+    assert(vectors == 64);
+
+    u8 data[64];
+    for (u8 i=0; i<vectors; ++i) {
+        data[i] = i;
+    }
+    for (u8 i=0; i<vectors; ++i) {
+        // every tail length both with and without preceding full blocks
+        assert(siphash(data, i, key) == correct_vectors[i]);
+    }
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_siphash_unaligned_data() {
+    u8 buffer[64 + 8];
+
+    for (u8 offset=0; offset<8; ++offset) {
+        u8 *data = buffer + offset;
+        for (u8 i=0; i<64; ++i) {
+            data[i] = i;
+        }
+        assert(siphash(data, 63, key) == correct_vectors[63]);
+        assert(siphash(data, 19, key) == correct_vectors[19]);
+    }
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_siphash_batch() {
+    u8 data[64];
+    for (u8 i=0; i<sizeof(data); ++i) {
+        data[i] = i;
+    }
+
+    // lengths vary within the batch so that lanes finish at different blocks
+    size_t const count = 37;
+    void const *messages[37];
+    size_t lengths[37];
+    u64 hashes[37];
+
+    for (size_t i=0; i<count; ++i) {
+        lengths[i] = (i * 7) % 64;
+        messages[i] = data;
+    }
+    siphash_batch(messages, lengths, count, key, hashes);
+
+    for (size_t i=0; i<count; ++i) {
+        assert(hashes[i] == correct_vectors[lengths[i]]);
+    }
+
+    // equal lengths, only the lockstep path
+    char const *strings[] = {"key_1", "key_2", "key_3", "key_4", "key_5", "key_6", "key_7", "key_8"};
+    size_t str_lengths[8];
+    for (size_t i=0; i<8; ++i) {
+        str_lengths[i] = strlen(strings[i]);
+    }
+    siphash_batch((void const *const *)strings, str_lengths, 8, key, hashes);
+
+    for (size_t i=0; i<8; ++i) {
+        assert(hashes[i] == siphash(strings[i], str_lengths[i], key));
+    }
+
+    PRINT_SUCCESS(__func__);
+}
+
 
 test_func siphash_tests[] = {
     {"siphash_ascii_chars", test_siphash_ascii_chars},
     {"siphash_string", test_siphash_string},
     {"siphash_long_string", test_siphash_long_string},
     {"siphash_equal_data", test_siphash_equal_data},
+    {"siphash_reference_vectors", test_siphash_reference_vectors},
+    {"siphash_unaligned_data", test_siphash_unaligned_data},
+    {"siphash_batch", test_siphash_batch},
+    {"siphash13_byte_sequences", test_siphash13_byte_sequences},
+    {"siphash13_long_string", test_siphash13_long_string},
     {NULL, NULL},
 };
@@ -0,0 +1,252 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "snapshot.h"
+
+#define SNAPSHOT_TEST_PATH "hashmap_snapshot_test.bin"
+
+
+static void check_snapshot_round_trip(struct HashMapConfig const *config, u32 elems) {
+    struct HashMap *hashmap = hmap_init_ex(config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+
+    for (u32 i=0; i<elems; ++i) {
+        char key[48];
+        snprintf(key, sizeof key, "%s_%u", i % 3 ? "key" : "a key long enough for the arena", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+    assert(snapshot_save(hashmap, SNAPSHOT_TEST_PATH) == true);
+    assert(hashmap->old_slots == NULL);
+
+    struct HashMap *loaded = snapshot_load(SNAPSHOT_TEST_PATH);
+    assert(loaded != NULL);
+    assert(loaded->ex_capa == hashmap->ex_capa && hmap_len(loaded) == elems);
+    assert(loaded->layout == hashmap->layout && loaded->incremental == hashmap->incremental);
+    assert(loaded->packing == hashmap->packing && loaded->sz_slot == hashmap->sz_slot);
+    assert(memcmp(loaded->rand_key, hashmap->rand_key, HASH_RAND_KEY_LEN) == 0);
+    assert(memcmp(loaded->slots, hashmap->slots, hmap_slots_bytes(hashmap, hashmap->ex_capa)) == 0);
+
+    for (u32 i=0; i<elems; ++i) {
+        char key[48];
+        snprintf(key, sizeof key, "%s_%u", i % 3 ? "key" : "a key long enough for the arena", i);
+        assert(*(i32 *)hmap_get(loaded, key) == (i32)i);
+    }
+    // loaded hash map is fully usable
+    assert(hmap_insert(loaded, "new", &(i32){-1}) == true);
+    assert(hmap_remove_into(loaded, "key_1", NULL) == (elems > 1));
+    assert(hmap_len(loaded) == elems + (elems <= 1));
+
+    hmap_free(loaded);
+    hmap_free(hashmap);
+    remove(SNAPSHOT_TEST_PATH);
+}
+
+static void test_snapshot_round_trip() {
+    struct HashMapConfig config = {.item_size=sizeof(i32), .long_keys=true};
+    check_snapshot_round_trip(&config, 3000);
+
+    // saving finishes the migration
+    config.incremental_resize = true;
+    config.layout = HASHMAP_LAYOUT_SPLIT;
+    config.hash = HASHMAP_HASH_WYHASH;
+    config.shrink = HASHMAP_SHRINK_HYSTERESIS;
+    check_snapshot_round_trip(&config, 1000);
+
+    config = (struct HashMapConfig){
+        .item_size=sizeof(i32), .long_keys=true, .packing=HASHMAP_PACKING_ALIGNED
+    };
+    check_snapshot_round_trip(&config, 500);
+
+    config = (struct HashMapConfig){.item_size=sizeof(i32)};
+    check_snapshot_round_trip(&config, 0);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_snapshot_u64_keys() {
+    struct HashMapConfig const config = {.item_size=sizeof(u64), .key_type=HASHMAP_KEY_U64};
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+
+    for (u64 i=0; i<500; ++i) {
+        assert(hmap_insert_u64(hashmap, i * 7919, &i) == true);
+    }
+    assert(snapshot_save(hashmap, SNAPSHOT_TEST_PATH) == true);
+    struct HashMap *loaded = snapshot_load(SNAPSHOT_TEST_PATH);
+    assert(loaded != NULL && loaded->key_type == HASHMAP_KEY_U64 && loaded->hash_func == NULL);
+
+    for (u64 i=0; i<500; ++i) {
+        assert(*(u64 *)hmap_get_u64(loaded, i * 7919) == i);
+    }
+    hmap_free(loaded);
+    hmap_free(hashmap);
+    remove(SNAPSHOT_TEST_PATH);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static u64 custom_hash(void const *data, size_t len, u8 const key[16]) {
+    (void)key;
+    return len > 0 ? ((u8 const *)data)[0] : 0;
+}
+
+static void corrupt_byte_at(long offset) {
+    FILE *file = fopen(SNAPSHOT_TEST_PATH, "r+b");
+    assert(file != NULL);
+    assert(fseek(file, offset, SEEK_SET) == 0);
+    int const byte = fgetc(file);
+    assert(fseek(file, offset, SEEK_SET) == 0);
+    fputc(byte ^ 0x40, file);
+    fclose(file);
+}
+
+static void test_snapshot_invalid_files() {
+    struct HashMapConfig config = {.item_size=sizeof(i32)};
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+
+    for (u32 i=0; i<100; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+    assert(snapshot_load("no_such_snapshot.bin") == NULL);
+
+    // corrupted slots, header and magic
+    long const offsets[] = {sizeof(struct SnapshotHeader) + 40, 40, 0};
+    for (size_t j=0; j<sizeof(offsets)/sizeof(offsets[0]); ++j) {
+        assert(snapshot_save(hashmap, SNAPSHOT_TEST_PATH) == true);
+        corrupt_byte_at(offsets[j]);
+        assert(snapshot_load(SNAPSHOT_TEST_PATH) == NULL);
+    }
+
+    // truncated
+    assert(snapshot_save(hashmap, SNAPSHOT_TEST_PATH) == true);
+    FILE *file = fopen(SNAPSHOT_TEST_PATH, "wb");
+    assert(file != NULL);
+    fputs("HMAPSNAP", file);
+    fclose(file);
+    assert(snapshot_load(SNAPSHOT_TEST_PATH) == NULL);
+    remove(SNAPSHOT_TEST_PATH);
+    hmap_free(hashmap);
+
+    config.hash = HASHMAP_HASH_CUSTOM;
+    config.hash_func = custom_hash;
+    hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    assert(snapshot_save(hashmap, SNAPSHOT_TEST_PATH) == false);
+    hmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static bool accept_key(char const *key, void *data) {
+    (void)data;
+    return strlen(key) < 64;
+}
+
+static void test_snapshot_open_mapped() {
+    struct HashMapConfig const config = {.item_size=sizeof(i32), .long_keys=true};
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+
+    for (u32 i=0; i<2000; ++i) {
+        char key[48];
+        snprintf(key, sizeof key, "%s_%u", i % 2 ? "key" : "a key long enough for the arena", i);
+        assert(hmap_insert(hashmap, key, &(i32){i}) == true);
+    }
+    assert(snapshot_save(hashmap, SNAPSHOT_TEST_PATH) == true);
+
+    struct HashMap *mapped = snapshot_open_mapped(SNAPSHOT_TEST_PATH);
+    assert(mapped != NULL && mapped->mapping != NULL);
+    assert(mapped->ex_capa == hashmap->ex_capa && hmap_len(mapped) == 2000);
+    assert((u8 *)mapped->slots == (u8 *)mapped->mapping + sizeof(struct SnapshotHeader));
+
+    for (u32 i=0; i<2000; ++i) {
+        char key[48];
+        snprintf(key, sizeof key, "%s_%u", i % 2 ? "key" : "a key long enough for the arena", i);
+        assert(*(i32 *)hmap_get(mapped, key) == (i32)i);
+    }
+    assert(hmap_get(mapped, "key_2000") == NULL);
+
+    // modifications are rejected and leave the hash map intact
+    assert(hmap_insert(mapped, "new", &(i32){-1}) == false);
+    assert(hmap_insert(mapped, "key_1", &(i32){-1}) == false);
+    assert(hmap_remove_into(mapped, "key_1", NULL) == false);
+    assert(hmap_remove(mapped, "key_3") == NULL);
+    assert(hmap_reserve(mapped, 10000) == false);
+    assert(hmap_shrink_to_fit(mapped) == false);
+    assert(hmap_len(mapped) == 2000 && *(i32 *)hmap_get(mapped, "key_1") == 1);
+
+    // saving over the mapped file replaces it, the mapping keeps the old contents
+    assert(hmap_insert(hashmap, "key_1", &(i32){-1}) == true);
+    assert(snapshot_save(hashmap, SNAPSHOT_TEST_PATH) == true);
+    assert(*(i32 *)hmap_get(mapped, "key_1") == 1);
+    assert(snapshot_save(hashmap, "no_such_dir/" SNAPSHOT_TEST_PATH) == false);
+
+    hmap_free(mapped);
+    mapped = snapshot_open_mapped(SNAPSHOT_TEST_PATH);
+    assert(mapped != NULL && *(i32 *)hmap_get(mapped, "key_1") == -1);
+
+    hmap_free(mapped);
+    hmap_free(hashmap);
+
+    // long key references outside the key arena are not followed
+    hashmap = snapshot_load(SNAPSHOT_TEST_PATH);
+    assert(hashmap != NULL && hashmap->layout == HASHMAP_LAYOUT_INTERLEAVED);
+    char const *long_key = "a key long enough for the arena_0";
+    size_t const slot = ((u8 *)hmap_get(hashmap, long_key) - (u8 *)hashmap->slots) / hashmap->sz_slot;
+    long const field = sizeof(struct SnapshotHeader) + slot * hashmap->sz_slot + hashmap->sz_bucket;
+    hmap_free(hashmap);
+
+    corrupt_byte_at(field + 7);
+    mapped = snapshot_open_mapped(SNAPSHOT_TEST_PATH);
+    assert(mapped != NULL && hmap_get(mapped, long_key) == NULL);
+    assert(hmap_iter_apply(mapped, accept_key) == true);
+    hmap_free(mapped);
+
+    // header is validated
+    corrupt_byte_at(40);
+    assert(snapshot_open_mapped(SNAPSHOT_TEST_PATH) == NULL);
+    remove(SNAPSHOT_TEST_PATH);
+    assert(snapshot_open_mapped(SNAPSHOT_TEST_PATH) == NULL);
+
+    PRINT_SUCCESS(__func__);
+}
+
+
+static void test_snapshot_file_mode() {
+    struct HashMap *hashmap = hmap_init(sizeof(i32), MAP_INIT_EXP_CAPACITY, NULL);
+    assert(hashmap != NULL);
+    assert(hmap_insert(hashmap, "key_1", &(i32){1}) == true);
+
+    // the file mode follows the umask, also when an existing file is replaced
+    mode_t const old_mask = umask(077);
+    struct stat st;
+    assert(snapshot_save(hashmap, SNAPSHOT_TEST_PATH) == true);
+    assert(stat(SNAPSHOT_TEST_PATH, &st) == 0 && (st.st_mode & 0777) == 0600);
+    assert(snapshot_save(hashmap, SNAPSHOT_TEST_PATH) == true);
+    assert(stat(SNAPSHOT_TEST_PATH, &st) == 0 && (st.st_mode & 0777) == 0600);
+    umask(old_mask);
+
+    hmap_free(hashmap);
+    remove(SNAPSHOT_TEST_PATH);
+
+    PRINT_SUCCESS(__func__);
+}
+
+
+test_func snapshot_tests[] = {
+    {"snapshot_round_trip", test_snapshot_round_trip},
+    {"snapshot_u64_keys", test_snapshot_u64_keys},
+    {"snapshot_invalid_files", test_snapshot_invalid_files},
+    {"snapshot_open_mapped", test_snapshot_open_mapped},
+    {"snapshot_file_mode", test_snapshot_file_mode},
+    {NULL, NULL},
+};
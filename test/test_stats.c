@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "common.h"
+#include "map.h"
+#include "stats.h"
+
+
+static u64 zero_hash(void const *data, size_t len, u8 const key[16]) {
+    (void)data;
+    (void)len;
+    (void)key;
+    return 0;
+}
+
+static u64 last_slot_hash(void const *data, size_t len, u8 const key[16]) {
+    (void)data;
+    (void)len;
+    (void)key;
+    return UINT64_MAX;
+}
+
+static void insert_keys(struct HashMap *hashmap, u32 count) {
+    for (u32 i=0; i<count; ++i) {
+        char key[16];
+        snprintf(key, sizeof key, "%s_%u", "key", i);
+        assert(hmap_insert(hashmap, key, &(i32){1}) == true);
+    }
+}
+
+static void test_layout_stats_bytes() {
+    struct HashMapConfig config = {.item_size=sizeof(i32)};
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    insert_keys(hashmap, 100);
+
+    struct HashMapLayoutStats stats;
+    hmap_get_layout_stats(hashmap, &stats);
+    u64 const capacity = MAP_CAPACITY(hashmap->ex_capa);
+
+    assert(stats.capacity == capacity && stats.len == 100);
+    assert(stats.slot_bytes == hashmap->sz_slot);
+    assert(stats.table_bytes == capacity * hashmap->sz_slot);
+    assert(stats.key_padding_bytes == capacity * (hashmap->sz_key - 20));
+    assert(stats.alignment_bytes ==
+        capacity * (hashmap->sz_slot - hashmap->sz_bucket - hashmap->sz_key - hashmap->sz_item));
+    assert(stats.empty_bytes == (capacity - 100) * hashmap->sz_slot);
+    assert(stats.allocated_bytes > stats.table_bytes && stats.arena_bytes == 0);
+    hmap_free(hashmap);
+
+    // Split layout has no slot padding
+    config.layout = HASHMAP_LAYOUT_SPLIT;
+    config.key_type = HASHMAP_KEY_U64;
+    hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    assert(hmap_insert_u64(hashmap, 42, &(i32){1}) == true);
+
+    hmap_get_layout_stats(hashmap, &stats);
+    assert(stats.slot_bytes == (u64)hashmap->sz_bucket + hashmap->sz_key + hashmap->sz_item);
+    assert(stats.alignment_bytes == 0);
+    assert(stats.key_padding_bytes == stats.capacity * (hashmap->sz_key - sizeof(u64)));
+    hmap_free(hashmap);
+
+    config = (struct HashMapConfig){.item_size=sizeof(i32), .long_keys=true};
+    hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    assert(hmap_insert(hashmap, "a key long enough for the key arena", &(i32){1}) == true);
+
+    hmap_get_layout_stats(hashmap, &stats);
+    assert(stats.arena_bytes == hashmap->arena.capa && stats.arena_bytes > 0);
+    hmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_layout_stats_clusters() {
+    struct HashMapConfig config = {
+        .item_size=sizeof(i32), .hash=HASHMAP_HASH_CUSTOM, .hash_func=zero_hash
+    };
+    struct HashMap *hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+
+    struct HashMapLayoutStats stats;
+    hmap_get_layout_stats(hashmap, &stats);
+    assert(stats.cluster_count == 0 && stats.max_cluster_len == 0);
+    assert(stats.mean_psl == 0 && stats.mean_cluster_len == 0);
+
+    // Every key probes from slot 0, forming one cluster with PSLs 0, 1, 2, ...
+    insert_keys(hashmap, 40);
+    hmap_get_layout_stats(hashmap, &stats);
+    assert(stats.cluster_count == 1 && stats.max_cluster_len == 40);
+    assert(stats.cluster_histogram[5] == 1);
+    assert(stats.max_psl == 39 && stats.mean_psl == 19.5 && stats.mean_cluster_len == 40);
+    hmap_free(hashmap);
+
+    // Cluster wrapping around the end of the table is counted once
+    config.hash_func = last_slot_hash;
+    hashmap = hmap_init_ex(&config, MAP_INIT_EXP_CAPACITY);
+    assert(hashmap != NULL);
+    insert_keys(hashmap, 5);
+
+    hmap_get_layout_stats(hashmap, &stats);
+    assert(stats.capacity == 16);
+    assert(stats.cluster_count == 1 && stats.max_cluster_len == 5);
+    assert(stats.cluster_histogram[2] == 1);
+    hmap_free(hashmap);
+
+    // Scattered keys form clusters whose lengths add up to the length
+    hashmap = hmap_init(sizeof(i32), MAP_INIT_EXP_CAPACITY, NULL);
+    assert(hashmap != NULL);
+    insert_keys(hashmap, 1000);
+
+    hmap_get_layout_stats(hashmap, &stats);
+    u64 clusters = 0;
+    for (size_t b=0; b<HASHMAP_STATS_CLUSTER_BUCKETS; ++b) {
+        clusters += stats.cluster_histogram[b];
+    }
+    assert(clusters == stats.cluster_count && clusters > 1);
+    assert(stats.mean_cluster_len * stats.cluster_count > 999.9 &&
+        stats.mean_cluster_len * stats.cluster_count < 1000.1);
+    hmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_stats_dump() {
+    struct HashMap *hashmap = hmap_init(sizeof(i32), MAP_INIT_EXP_CAPACITY, NULL);
+    assert(hashmap != NULL);
+    insert_keys(hashmap, 100);
+
+    size_t const len = stats_dump_buffer(hashmap, NULL, 0);
+    assert(len > 0);
+    char *json = malloc(len + 1);
+    assert(json != NULL);
+
+    assert(stats_dump_buffer(hashmap, json, len + 1) == len);
+    assert(strlen(json) == len);
+    assert(json[0] == '{' && json[len - 2] == '}' && json[len - 1] == '\n');
+    assert(strstr(json, "\"len\":100,") != NULL);
+    assert(strstr(json, "\"layout\":\"interleaved\"") != NULL);
+    assert(strstr(json, "\"psl\":{\"max\":") != NULL);
+    assert(strstr(json, "\"clusters\":{\"count\":") != NULL);
+#ifdef HASHMAP_STATS
+    assert(strstr(json, "\"counters\":{\"gets\":0,") != NULL);
+#else
+    assert(strstr(json, "\"counters\"") == NULL);
+#endif
+
+    // Truncated output is still null terminated
+    char small[16];
+    assert(stats_dump_buffer(hashmap, small, sizeof small) == len);
+    assert(strlen(small) == sizeof small - 1 && memcmp(small, json, sizeof small - 1) == 0);
+
+    FILE *stream = tmpfile();
+    assert(stream != NULL);
+    assert(stats_dump(hashmap, stream) == true);
+    assert((size_t)ftell(stream) == len);
+    fclose(stream);
+    assert(stats_dump(hashmap, NULL) == false);
+
+    free(json);
+    hmap_free(hashmap);
+
+    PRINT_SUCCESS(__func__);
+}
+
+test_func stats_tests[] = {
+    {"layout_stats_bytes", test_layout_stats_bytes},
+    {"layout_stats_clusters", test_layout_stats_clusters},
+    {"stats_dump", test_stats_dump},
+    {NULL, NULL},
+};
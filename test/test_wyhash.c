@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "common.h"
+#include "wyhash.h"
+
+
+static u8 const key[] = {
+    0x0, 0x1, 0x2, 0x3,
+    0x4, 0x5, 0x6, 0x7,
+    0x8, 0x9, 0xa, 0xb,
+    0xc, 0xd, 0xe, 0xf,
+};
+
+// Hashes of the byte sequences 0, 1, ..., n-1 (little-endian platforms)
+static size_t const test_lengths[] = {0, 1, 3, 4, 8, 15, 16, 17, 48, 49, 100};
+
+static u64 const correct_hashes_test_set[] = {
+    0xc37deea626325bfdULL, 0x34b07017991ee5d4ULL, 0x358632059ea3deedULL, 0x70c454489619483eULL,
+    0xb9ee37cc06ef632eULL, 0xa81cfd8fae5e6574ULL, 0x978c539b08b3f6f6ULL, 0x914b6e7ea1b4be1cULL,
+    0xc307383a500d89eeULL, 0xd5848e0c3d967941ULL, 0x98d879be5956e8a3ULL,
+};
+
+
+static void test_wyhash_byte_sequences() {
+    size_t const count = sizeof(test_lengths) / sizeof(test_lengths[0]);
+    assert(count == sizeof(correct_hashes_test_set) / sizeof(correct_hashes_test_set[0]));
+
+    u16 const endian_probe = 1;
+    if (*(u8 const *)&endian_probe != 1) {
+        // Data is read in native byte order, reference values hold only for little-endian
+        PRINT_SUCCESS(__func__);
+        return;
+    }
+    u8 data[100];
+    for (u8 i=0; i<sizeof(data); ++i) {
+        data[i] = i;
+    }
+    for (size_t i=0; i<count; ++i) {
+        assert(wyhash(data, test_lengths[i], key) == correct_hashes_test_set[i]);
+    }
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_wyhash_every_byte_matters() {
+    u8 data[64] = {0};
+
+    for (size_t len=1; len<=sizeof(data); ++len) {
+        u64 const hash = wyhash(data, len, key);
+        // a length change alone changes the hash
+        assert(hash != wyhash(data, len - 1, key));
+
+        for (size_t i=0; i<len; ++i) {
+            data[i] ^= 0x80;
+            assert(wyhash(data, len, key) != hash);
+            data[i] ^= 0x80;
+        }
+        assert(wyhash(data, len, key) == hash);
+    }
+
+    PRINT_SUCCESS(__func__);
+}
+
+static void test_wyhash_seeded_by_key() {
+    char string[] = "Hello, this is a wyhash test!";
+    size_t const s_len = strlen(string);
+
+    u8 other_key[sizeof(key)];
+    memcpy(other_key, key, sizeof(key));
+    other_key[3] ^= 1;
+
+    assert(wyhash(string, s_len, key) == wyhash(string, s_len, key));
+    assert(wyhash(string, s_len, key) != wyhash(string, s_len, other_key));
+
+    PRINT_SUCCESS(__func__);
+}
+
+
+test_func wyhash_tests[] = {
+    {"wyhash_byte_sequences", test_wyhash_byte_sequences},
+    {"wyhash_every_byte_matters", test_wyhash_every_byte_matters},
+    {"wyhash_seeded_by_key", test_wyhash_seeded_by_key},
+    {NULL, NULL},
+};